@@ -1,9 +1,24 @@
+// Citations
+// https://www.cs.rochester.edu/u/scott/papers/1991_TOCS_synch.pdf (ticket and MCS locks)
+// https://developer.arm.com/documentation/den0024/a/Multi-core-processors/Multi-processing-systems/Synchronization (WFE and the exclusive monitor)
+
 #ifndef ATOMICS_H
 #define ATOMICS_H
 
+#include "definitions.h"
+#include "lock_stats.h"
+#include "preempt.h"
+
 /**
  * @brief Atomic wrapper for GCC builtins
  *
+ * Every operation takes its memory order, one of the __ATOMIC_* constants, as
+ * a template argument defaulting to __ATOMIC_SEQ_CST, e.g.
+ * load<__ATOMIC_ACQUIRE>(). GCC only honours an order it can see as a
+ * constant and treats any other as seq_cst, which a runtime argument would be
+ * whenever the call is not inlined. A weaker order lets AArch64 use plain
+ * ldr/str or exclusives without acquire/release semantics, and avoids the dmb
+ * that a sequentially consistent fence or store-load pair needs.
  *
  * modification reference:
  * https://gcc.gnu.org/onlinedocs/gcc/_005f_005fatomic-Builtins.html
@@ -14,6 +29,13 @@ class Atomic {
  private:
   volatile T obj;
 
+  // Strongest order a failed compare exchange may use, which only loads
+  static constexpr int failure_order(int order) {
+    if (order == __ATOMIC_ACQ_REL) return __ATOMIC_ACQUIRE;
+    if (order == __ATOMIC_RELEASE) return __ATOMIC_RELAXED;
+    return order;
+  }
+
  public:
   Atomic() : obj(T()) {}
   /**
@@ -26,75 +48,244 @@ class Atomic {
   /**
    * @brief atomically loads obj
    *
+   * @tparam Order memory order, not release or acq_rel
    * @return T obj
    */
-  T load() const { return __atomic_load_n(&obj, __ATOMIC_SEQ_CST); }
+  template <int Order = __ATOMIC_SEQ_CST>
+  T load() const {
+    return __atomic_load_n(&obj, Order);
+  }
 
   /**
    * @brief atomically stores desired
    *
    * @param desired desired value to be stored
+   * @tparam Order  memory order, not acquire or acq_rel
    */
-  void store(T desired) { __atomic_store_n(&obj, desired, __ATOMIC_SEQ_CST); }
+  template <int Order = __ATOMIC_SEQ_CST>
+  void store(T desired) {
+    __atomic_store_n(&obj, desired, Order);
+  }
 
   /**
    * @brief atomically exchanges with desired
    *
    * @param desired   desired value to be stored
+   * @tparam Order    memory order
    * @return T        previously stored value
    */
+  template <int Order = __ATOMIC_SEQ_CST>
   T exchange(T desired) {
-    return __atomic_exchange_n(&obj, desired, __ATOMIC_SEQ_CST);
+    return __atomic_exchange_n(&obj, desired, Order);
   }
 
   /**
-   * @brief if obj == expected, store desired in obj. otherwise, store desired
-   * in expected
+   * @brief if obj == expected, store desired in obj. otherwise, store obj in
+   * expected. May fail spuriously, so it belongs in a loop.
    *
    * @param expected      expected value in atomic
    * @param desired       desired value to be stored
+   * @tparam Order        memory order on success. A failure only loads, so
+   *                      it drops the release half of Order.
    * @return true         atomic obj is modified
    * @return false        atomic obj is not modified
    */
+  template <int Order = __ATOMIC_SEQ_CST>
   bool compare_exchange_weak(T* expected, T desired) {
-    return __atomic_compare_exchange_n(&obj, expected, desired, false,
-                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return __atomic_compare_exchange_n(&obj, expected, desired, true, Order,
+                                       failure_order(Order));
   }
   /**
-   * @brief if obj == expected, store desired in obj. otherwise, store desired
-   * in expected
+   * @brief if obj == expected, store desired in obj. otherwise, store obj in
+   * expected. Never fails spuriously.
    *
    * @param expected      expected value in atomic
    * @param desired       desired value to be stored
+   * @tparam Order        memory order on success. A failure only loads, so
+   *                      it drops the release half of Order.
    * @return true         atomic obj is modified
    * @return false        atomic obj is not modified
    */
+  template <int Order = __ATOMIC_SEQ_CST>
   bool compare_exchange_strong(T* expected, T desired) {
-    return __atomic_compare_exchange_n(&obj, expected, desired, true,
-                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return __atomic_compare_exchange_n(&obj, expected, desired, false, Order,
+                                       failure_order(Order));
   }
 
   /**
    * @brief atomically adds val to obj
    *
    * @param val   value to be added
+   * @tparam Order memory order
    * @return T    new value
    */
-  T add_fetch(T val) { return __atomic_add_fetch(&obj, val, __ATOMIC_SEQ_CST); }
+  template <int Order = __ATOMIC_SEQ_CST>
+  T add_fetch(T val) {
+    return __atomic_add_fetch(&obj, val, Order);
+  }
+
+  /**
+   * @brief atomically adds val to obj
+   *
+   * @param val   value to be added
+   * @tparam Order memory order
+   * @return T    previous value
+   */
+  template <int Order = __ATOMIC_SEQ_CST>
+  T fetch_add(T val) {
+    return __atomic_fetch_add(&obj, val, Order);
+  }
+
+  /**
+   * @brief atomically subtracts val from obj
+   *
+   * @param val   value to be subtracted
+   * @tparam Order memory order
+   * @return T    previous value
+   */
+  template <int Order = __ATOMIC_SEQ_CST>
+  T fetch_sub(T val) {
+    return __atomic_fetch_sub(&obj, val, Order);
+  }
+
+  /**
+   * @brief atomically ors bits into obj
+   *
+   * @param bits  bits to be set
+   * @tparam Order memory order
+   * @return T    previous value
+   */
+  template <int Order = __ATOMIC_SEQ_CST>
+  T fetch_or(T bits) {
+    return __atomic_fetch_or(&obj, bits, Order);
+  }
+
+  /**
+   * @brief atomically ands obj with bits
+   *
+   * @param bits  bits to be kept
+   * @tparam Order memory order
+   * @return T    previous value
+   */
+  template <int Order = __ATOMIC_SEQ_CST>
+  T fetch_and(T bits) {
+    return __atomic_fetch_and(&obj, bits, Order);
+  }
 };
 
 class SpinLock {
   bool status = true;
+  [[no_unique_address]] LockStats::Probe probe;
 
  public:
   SpinLock() {}
+  explicit SpinLock(LockStats::Site& site) : probe(site) {}
 
+  // The holder must not be parked, or every other core would spin on the
+  // lock until it is resumed
   void lock() {
-    while (!__atomic_exchange_n(&status, false, __ATOMIC_SEQ_CST)) {
+    Preempt::disable();
+    uint64_t waiting_since = probe.now();
+    bool contended = false;
+    while (!__atomic_exchange_n(&status, false, __ATOMIC_ACQUIRE)) {
+      contended = true;
     };
+    probe.acquired(waiting_since, contended);
+  }
+
+  void unlock() {
+    probe.released();
+    __atomic_store_n(&status, true, __ATOMIC_RELEASE);
+    Preempt::enable();
+  }
+};
+
+namespace Spin {
+/**
+ * @brief Waits until done(*word) holds, sleeping in wfe in between, and
+ * returns the value that satisfied it with acquire ordering
+ *
+ * The exclusive load arms the core's monitor on word, so the store of another
+ * core to it sends the event that ends wfe, without that core having to sev.
+ * Any other event (an interrupt, sev from the event loop) only costs another
+ * check.
+ */
+template <typename T, typename Done>
+inline T wait_until(volatile T* word, Done done) {
+  static_assert(sizeof(T) == 4 || sizeof(T) == 8, "word must be 32 or 64 bits");
+  while (true) {
+    T current = __atomic_load_n(word, __ATOMIC_ACQUIRE);
+    if (done(current)) return current;
+
+    T observed;
+    if constexpr (sizeof(T) == 8) {
+      __asm__ volatile("ldaxr %0, [%1]" : "=r"(observed) : "r"(word) : "memory");
+    } else {
+      __asm__ volatile("ldaxr %w0, [%1]" : "=r"(observed) : "r"(word) : "memory");
+    }
+    if (!done(observed)) __asm__ volatile("wfe" ::: "memory");
+  }
+}
+}  // namespace Spin
+
+/**
+ * @brief FIFO spin lock: every core takes a ticket and waits, in wfe, for its
+ * number to be served. Waiters only read the lock's cache line until it is
+ * handed to them, and get it in the order they arrived.
+ */
+class TicketLock {
+  uint32_t next_ticket = 0;
+  uint32_t now_serving = 0;
+  [[no_unique_address]] LockStats::Probe probe;
+
+ public:
+  TicketLock() {}
+  explicit TicketLock(LockStats::Site& site) : probe(site) {}
+
+  // Same rules as SpinLock::lock
+  void lock() {
+    Preempt::disable();
+    uint64_t waiting_since = probe.now();
+    uint32_t ticket = __atomic_fetch_add(&next_ticket, 1, __ATOMIC_RELAXED);
+    bool contended = LockStats::ENABLED &&
+                     __atomic_load_n(&now_serving, __ATOMIC_RELAXED) != ticket;
+    Spin::wait_until(&now_serving, [ticket](uint32_t serving) { return serving == ticket; });
+    probe.acquired(waiting_since, contended);
   }
 
-  void unlock() { __atomic_store_n(&status, true, __ATOMIC_SEQ_CST); }
+  void unlock() {
+    probe.released();
+    // Only the holder writes now_serving
+    __atomic_store_n(&now_serving, now_serving + 1, __ATOMIC_RELEASE);
+    Preempt::enable();
+  }
+};
+
+// A core's place in the queue of an McsLock
+struct McsNode {
+  McsNode* next;
+  uint32_t locked;  // 1 until the previous holder hands the lock over
+};
+
+/**
+ * @brief FIFO queue lock where every waiter spins, in wfe, on its own node,
+ * so a handoff only touches the cache lines of the two cores involved. Costs
+ * an extra atomic on release compared to TicketLock, and pays off when many
+ * cores wait at once.
+ *
+ * Nodes come from a small per-core pool (see src/atomics.cpp), which bounds
+ * how many McsLocks a core may hold or wait on at once, interrupts included.
+ */
+class McsLock {
+  McsNode* tail = nullptr;
+  McsNode* holder = nullptr;  // Node of the holder, for unlock
+
+ public:
+  McsLock() {}
+
+  // Same rules as SpinLock::lock
+  void lock();
+  void unlock();
 };
 
 template <typename T>
@@ -111,31 +302,44 @@ public:
 };
 
 // AKA shared-exclusive lock
+//
+// Writer preferring: a waiting writer sets WRITER_WAITING, which holds back
+// new readers until it is in. When a writer leaves, the readers waiting on it
+// all get in as one batch before the next writer can hold them back again.
+// Waiters sleep in wfe. Since a waiting writer holds back new readers, a core
+// must not read lock an RWLock it is already reading from (an interrupt
+// handler included).
 class RWLock {
  public:
   RWLock() : state(0) {}
+  explicit RWLock(LockStats::Site& site) : state(0), probe(site) {}
 
   /**
    * @brief Acquires read lock, which is shared among multiple readers.
    *
    * @note This is a blocking call. If the lock is not acquired, the caller will
-   * spin until success.
+   * wait until success.
    */
   void read_lock() {
+    Preempt::disable();
+    uint64_t waiting_since = probe.now();
+    bool contended = LockStats::ENABLED &&
+                     (__atomic_load_n(&state, __ATOMIC_RELAXED) & (WRITER | WRITER_WAITING)) != 0;
     while (true) {
-      int current_state = state.load();
-      if (current_state == -1) {
-        // Exclusive writer currently holds lock
-        continue;
-      }
+      uint32_t current_state = Spin::wait_until(&state, [](uint32_t s) {
+        return (s & (WRITER | WRITER_WAITING)) == 0;
+      });
 
-      if (state.compare_exchange_weak(&current_state, current_state + 1)) {
+      if (__atomic_compare_exchange_n(&state, &current_state, current_state + 1,
+                                      true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
         // Read lock acquired
         break;
       }
 
-      // Read lock not acquired, try again
+      // A writer or another reader got in between, try again
+      contended = true;
     }
+    probe.shared_acquired(waiting_since, contended);
   }
 
   /**
@@ -144,40 +348,101 @@ class RWLock {
    * Decrements the count of active read locks. If the count reaches zero, the
    * lock is released.
    */
-  void read_unlock() { state.add_fetch(-1); }
+  void read_unlock() {
+    __atomic_fetch_sub(&state, 1, __ATOMIC_RELEASE);
+    Preempt::enable();
+  }
 
   /**
    * @brief Acquires exclusive write lock.
    *
    * @note This is a blocking call. If the lock is not acquired, the caller will
-   * spin until success.
+   * wait until success.
    */
   void write_lock() {
+    Preempt::disable();
+    uint64_t waiting_since = probe.now();
+    bool contended = false;
     while (true) {
-      int expected = 0;
-      if (state.compare_exchange_weak(&expected, -1)) {
-        // Write lock acquired
-        break;
+      uint32_t current_state = __atomic_load_n(&state, __ATOMIC_RELAXED);
+      if ((current_state & ~WRITER_WAITING) == 0) {
+        if (__atomic_compare_exchange_n(&state, &current_state, WRITER, true,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+          // Write lock acquired
+          break;
+        }
+        contended = true;
+        continue;
       }
 
-      // Write lock not acquired, try again
+      contended = true;
+
+      // Holds back new readers, then waits for the lock to drain
+      if (!(current_state & WRITER_WAITING)) {
+        __atomic_fetch_or(&state, WRITER_WAITING, __ATOMIC_RELAXED);
+      }
+      Spin::wait_until(&state, [](uint32_t s) {
+        return (s & ~WRITER_WAITING) == 0 || !(s & WRITER_WAITING);
+      });
     }
+    probe.acquired(waiting_since, contended);
   }
 
   /**
    * @brief Releases exclusive write lock.
    *
-   * Sets the state to 0, indicating that no one holds the lock.
+   * Sets the state to 0, indicating that no one holds the lock. Other waiting
+   * writers set WRITER_WAITING again.
    */
-  void write_unlock() { state.store(0); }
+  void write_unlock() {
+    probe.released();
+    __atomic_store_n(&state, 0, __ATOMIC_RELEASE);
+    Preempt::enable();
+  }
 
  private:
+  static constexpr uint32_t WRITER = 1u << 31;
+  static constexpr uint32_t WRITER_WAITING = 1u << 30;
+
   /*
    * Lock state:
-   * state >= 0: number of readers
-   * state == -1: exclusive writer
+   * low 30 bits: number of readers
+   * WRITER: exclusive writer
+   * WRITER_WAITING: a writer waits for the readers to leave
    */
-  Atomic<int> state;
+  uint32_t state;
+  [[no_unique_address]] LockStats::Probe probe;
+};
+
+/**
+ * @brief Reader-writer lock for data that is read on every core all the time
+ * and written rarely, with the same API as RWLock
+ *
+ * Every core counts its readers on its own cache line, so read locking only
+ * writes a line that stays in the reading core's cache. A writer announces
+ * itself, which holds back new readers, and then waits for every core's
+ * count to drain, so writing costs a pass over all cores. Unlike RWLock, a
+ * core may read lock it again while already reading, since its count then
+ * keeps the writer waiting anyway.
+ */
+class BigReaderLock {
+  struct ReaderCount {
+    uint32_t count;
+    char pad[CACHE_LINE_SIZE - sizeof(uint32_t)];
+  };
+
+  ReaderCount readers[NUM_CORES] = {};
+  uint32_t writer = 0;  // 1 while a writer holds or waits for the lock
+  [[no_unique_address]] LockStats::Probe probe;
+
+ public:
+  BigReaderLock() {}
+  explicit BigReaderLock(LockStats::Site& site) : probe(site) {}
+
+  void read_lock();
+  void read_unlock();
+  void write_lock();
+  void write_unlock();
 };
 
 #endif  // ATOMICS_H
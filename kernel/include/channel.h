@@ -1,29 +1,265 @@
+// Citations
+// https://go.dev/ref/spec#Channel_types
+// https://go.dev/ref/spec#Select_statements
+
 #ifndef _CHANNEL_H_
 #define _CHANNEL_H_
 
+#include "atomics.h"
+#include "printf.h"
 #include "semaphore.h"
-#include "thread.h"
+#include "stdint.h"
+#include "utility.h"
+#include "wait_queue.h"
+
+constexpr int SELECT_MAX_CHANNELS = 16;
+
+// A select waiting on a channel, woken by an up() of ready
+struct SelectWatch {
+    SelectWatch* next = nullptr;
+    Semaphore* ready = nullptr;
+};
+
+/**
+ * @brief The part of a Channel that does not depend on the message type: the
+ * lock, the fill level and whoever waits, so select() can wait on channels of
+ * different types
+ *
+ * One spin lock guards the ring and both wait queues. Every message added
+ * wakes one waiting receiver and every message taken wakes one waiting
+ * sender. A woken waiter checks again under the lock and parks again if
+ * another context got there first.
+ */
+class ChannelBase {
+    SelectWatch* watches = nullptr;
+
+    friend int select(ChannelBase* const* channels, int n);
+
+    // Pops up to n waiters off queue, returning them linked through next
+    static Waiter* pop_up_to(WaitQueue& queue, size_t n) {
+        Waiter* popped = nullptr;
+        for (size_t i = 0; i < n; i++) {
+            Waiter* waiter = queue.pop();
+            if (waiter == nullptr) break;
+            waiter->next = popped;
+            popped = waiter;
+        }
+        return popped;
+    }
+
+protected:
+    SpinLock lock;
+    WaitQueue senders{lock};    // Waiting for room in the ring
+    WaitQueue receivers{lock};  // Waiting for a message
+    size_t const capacity;
+    size_t count = 0;
+
+    explicit ChannelBase(size_t capacity) : capacity(capacity) {}
+
+    // Parks on queue until ready() holds. Expects lock to be held, and
+    // returns with it held again.
+    template <typename Ready>
+    void wait_until(WaitQueue& queue, Ready ready) {
+        while (!ready()) {
+            Waiter waiter;
+            queue.park(&waiter);
+            lock.lock();
+        }
+    }
+
+    // Unlocks after n messages were added, waking receivers and selects
+    void added(size_t n) {
+        Waiter* woken = pop_up_to(receivers, n);
+        for (SelectWatch* watch = watches; watch != nullptr; watch = watch->next) {
+            watch->ready->up();
+        }
+        lock.unlock();
+        WaitQueue::wake_all(woken);
+    }
+
+    // Unlocks after n messages were taken, waking senders
+    void taken(size_t n) {
+        Waiter* woken = pop_up_to(senders, n);
+        lock.unlock();
+        WaitQueue::wake_all(woken);
+    }
+
+public:
+    ChannelBase(const ChannelBase&) = delete;
+    ChannelBase& operator=(const ChannelBase&) = delete;
+
+    // Messages in the ring, already stale when it returns
+    size_t size() const { return __atomic_load_n(&count, __ATOMIC_RELAXED); }
+};
+
+/**
+ * @brief Waits until one of channels holds a message and returns its index
+ *
+ * Another receiver may take the message first, so callers try_receive() on
+ * the returned channel and select again if that fails. Like the blocking
+ * Channel calls, a thread parks and a plain event waits in wfe.
+ */
+inline int select(ChannelBase* const* channels, int n) {
+    if (n > SELECT_MAX_CHANNELS) {
+        Debug::panic("select on %d channels, at most %d\n", n, SELECT_MAX_CHANNELS);
+    }
+
+    while (true) {
+        Semaphore ready(0);
+        SelectWatch watches[SELECT_MAX_CHANNELS];
+        int found = -1;
+        int watched = 0;
+        for (; watched < n; watched++) {
+            ChannelBase* channel = channels[watched];
+            channel->lock.lock();
+            if (channel->count > 0) {
+                channel->lock.unlock();
+                found = watched;
+                break;
+            }
+            watches[watched].ready = &ready;
+            watches[watched].next = channel->watches;
+            channel->watches = &watches[watched];
+            channel->lock.unlock();
+        }
 
+        if (found < 0) ready.down();
+
+        // No channel touches ready once its watch is gone, since they only
+        // up() it while holding their lock
+        for (int i = 0; i < watched; i++) {
+            ChannelBase* channel = channels[i];
+            channel->lock.lock();
+            SelectWatch** link = &channel->watches;
+            while (*link != &watches[i]) link = &(*link)->next;
+            *link = watches[i].next;
+            channel->lock.unlock();
+        }
+
+        if (found >= 0) return found;
+    }
+}
+
+/**
+ * @brief Bounded FIFO channel between any threads, coroutines and events
+ *
+ * Messages are moved into a ring allocated once at construction and moved out
+ * again, never copied, so T can be move-only and a large message can be sent
+ * as a type that owns it, whose ownership the receiver then takes over. The
+ * lock is held while a message is moved, so that move should be cheap.
+ *
+ * @tparam T  type of the messages
+ */
 template <typename T>
-class Channel {
-    T message;
-    Semaphore sem;
-    LocklessQueue<TCB*> send_queue;
-    LocklessQueue<TCB*> recv_queue;
+class Channel : public ChannelBase {
+    static_assert(alignof(T) <= 8, "the heap aligns the ring to 8 bytes");
+
+    T* const slots;  // Only the count slots from head hold messages
+    size_t head = 0;
+
+    void push(T&& message) {
+        new (&slots[(head + count) % capacity]) T(std::move(message));
+        count++;
+    }
+
+    T pop() {
+        T message(std::move(slots[head]));
+        slots[head].~T();
+        head = (head + 1) % capacity;
+        count--;
+        return message;
+    }
+
+    bool full() const { return count == capacity; }
+
 public:
-    Channel(T msg) : message(msg), sem(1), send_queue(), recv_queue() {}
+    /**
+     * @brief Construct a new Channel
+     *
+     * @param capacity  messages the channel holds before send() blocks, at
+     *                  least 1
+     */
+    explicit Channel(size_t capacity)
+        : ChannelBase(capacity == 0 ? 1 : capacity),
+          slots(reinterpret_cast<T*>(new char[sizeof(T) * this->capacity])) {}
 
-    Channel(const Channel&) = delete;
-    Channel& operator=(const Channel& rhs) = delete;
-    Channel& operator=(Channel&& rhs) = delete;
+    ~Channel() {
+        while (count > 0) pop();
+        delete[] reinterpret_cast<char*>(slots);
+    }
+
+    // Waits for room, then moves message into the channel
+    void send(T&& message) {
+        lock.lock();
+        wait_until(senders, [this] { return !full(); });
+        push(std::move(message));
+        added(1);
+    }
 
-    void send(const T& msg) {
-        sem.down();
+    void send(const T& message) { send(T(message)); }
+
+    // Moves message into the channel if there is room, else leaves it be
+    bool try_send(T&& message) {
+        lock.lock();
+        if (full()) {
+            lock.unlock();
+            return false;
+        }
+        push(std::move(message));
+        added(1);
+        return true;
     }
 
+    bool try_send(const T& message) { return try_send(T(message)); }
+
+    // Moves all n messages into the channel, as many at a time as fit
+    void send_batch(T* messages, size_t n) {
+        size_t sent = 0;
+        while (sent < n) {
+            lock.lock();
+            wait_until(senders, [this] { return !full(); });
+            size_t batch = 0;
+            while (sent < n && !full()) {
+                push(std::move(messages[sent++]));
+                batch++;
+            }
+            added(batch);
+        }
+    }
+
+    // Waits for a message and moves it out
     T receive() {
-        
+        lock.lock();
+        wait_until(receivers, [this] { return count > 0; });
+        T message = pop();
+        taken(1);
+        return message;
+    }
+
+    // Moves a message into out if there is one
+    bool try_receive(T& out) {
+        lock.lock();
+        if (count == 0) {
+            lock.unlock();
+            return false;
+        }
+        out = pop();
+        taken(1);
+        return true;
+    }
+
+    // Waits for a message, then moves up to max of those waiting into out,
+    // returning how many
+    size_t receive_batch(T* out, size_t max) {
+        lock.lock();
+        wait_until(receivers, [this] { return count > 0; });
+        size_t batch = 0;
+        while (batch < max && count > 0) {
+            out[batch++] = pop();
+        }
+        taken(batch);
+        return batch;
     }
 };
 
-#endif
\ No newline at end of file
+#endif
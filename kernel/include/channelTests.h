@@ -0,0 +1,147 @@
+#ifndef CHANNEL_TESTS_H
+#define CHANNEL_TESTS_H
+
+#include "atomics.h"
+#include "channel.h"
+#include "definitions.h"
+#include "generic_timer.h"
+#include "printf.h"
+#include "testFramework.h"
+#include "thread.h"
+#include "utility.h"
+
+constexpr uint64_t CHANNEL_BENCHMARK_MESSAGES = 20000;  // Per producer
+constexpr size_t CHANNEL_BENCHMARK_CAPACITY = 64;
+constexpr size_t CHANNEL_BENCHMARK_BATCH = 16;
+
+// Move-only owner of a heap buffer, so a send that copied would not compile
+struct OwnedBuffer {
+  uint8_t* data = nullptr;
+
+  OwnedBuffer() {}
+  explicit OwnedBuffer(uint8_t* data) : data(data) {}
+  OwnedBuffer(OwnedBuffer&& other) : data(other.data) { other.data = nullptr; }
+  OwnedBuffer& operator=(OwnedBuffer&& other) {
+    delete[] data;
+    data = other.data;
+    other.data = nullptr;
+    return *this;
+  }
+  OwnedBuffer(const OwnedBuffer&) = delete;
+  OwnedBuffer& operator=(const OwnedBuffer&) = delete;
+  ~OwnedBuffer() { delete[] data; }
+};
+
+struct ChannelBenchmark {
+  Channel<uint64_t> channel{CHANNEL_BENCHMARK_CAPACITY};
+  Atomic<uint64_t> sum;
+};
+
+// Sends CHANNEL_BENCHMARK_MESSAGES numbers from each even index and receives
+// them on the odd ones, in batches if batched. Returns the average
+// nanoseconds per message, or 0 if a message went missing or the run did not
+// finish.
+uint64_t run_channel_benchmark(bool batched) {
+  constexpr int PAIRS = NUM_CORES / 2;
+  ChannelBenchmark* bench = new ChannelBenchmark();
+  uint64_t elapsed = run_on_cores(2 * PAIRS, [bench, batched](int index) {
+    uint64_t batch[CHANNEL_BENCHMARK_BATCH];
+    uint64_t sum = 0;
+    if (index % 2 == 0) {
+      for (uint64_t i = 1; i <= CHANNEL_BENCHMARK_MESSAGES;) {
+        size_t n = 0;
+        while (n < (batched ? CHANNEL_BENCHMARK_BATCH : 1) && i <= CHANNEL_BENCHMARK_MESSAGES) {
+          batch[n++] = i++;
+        }
+        bench->channel.send_batch(batch, n);
+      }
+      return;
+    }
+
+    for (uint64_t received = 0; received < CHANNEL_BENCHMARK_MESSAGES;) {
+      // Never takes more than it still owes, leaving the rest to the others
+      size_t owed = CHANNEL_BENCHMARK_MESSAGES - received;
+      size_t max = batched ? CHANNEL_BENCHMARK_BATCH : 1;
+      size_t n = bench->channel.receive_batch(batch, owed < max ? owed : max);
+      for (size_t i = 0; i < n; i++) sum += batch[i];
+      received += n;
+    }
+    bench->sum.add_fetch(sum);
+  });
+
+  if (elapsed == 0) return 0;
+  constexpr uint64_t expected =
+      PAIRS * CHANNEL_BENCHMARK_MESSAGES * (CHANNEL_BENCHMARK_MESSAGES + 1) / 2;
+  bool exact = bench->sum.load() == expected;
+  delete bench;
+  if (!exact) return 0;
+  return GenericTimer::counter_to_ns(elapsed) / (PAIRS * CHANNEL_BENCHMARK_MESSAGES);
+}
+
+void channelTests() {
+  initTests("Channel Tests");
+
+  // Test 1: Messages come out in order, and the non-blocking calls fail
+  // rather than wait
+  Channel<int>* ints = new Channel<int>(4);
+  bool in_order = true;
+  for (int i = 0; i < 4; i++) in_order = in_order && ints->try_send(i);
+  in_order = in_order && !ints->try_send(4);
+  for (int i = 0; i < 4; i++) {
+    int value = -1;
+    in_order = in_order && ints->try_receive(value) && value == i;
+  }
+  int unused;
+  in_order = in_order && !ints->try_receive(unused);
+  testsResult("Channel FIFO", in_order);
+
+  // Test 2: A move-only message hands its buffer over without a copy
+  Channel<OwnedBuffer>* buffers = new Channel<OwnedBuffer>(2);
+  uint8_t* data = new uint8_t[4096];
+  OwnedBuffer sent(data);
+  buffers->send(std::move(sent));
+  OwnedBuffer received = buffers->receive();
+  testsResult("Channel Moves Messages", sent.data == nullptr && received.data == data);
+
+  // Test 3: A thread blocks on a full channel until another thread drains it
+  constexpr int THREAD_MESSAGES = 1000;
+  Channel<int>* small = new Channel<int>(2);
+  Atomic<int>* total = new Atomic<int>(-1);
+  Thread::spawn([small] {
+    for (int i = 1; i <= THREAD_MESSAGES; i++) small->send(i);
+  });
+  Thread::spawn([small, total] {
+    int sum = 0;
+    for (int i = 0; i < THREAD_MESSAGES; i++) sum += small->receive();
+    total->store(sum);
+  });
+  uint64_t until = GenericTimer::now() + GenericTimer::ns_to_counter(LOCK_BENCHMARK_TIMEOUT_NS);
+  while (total->load() == -1 && GenericTimer::now() < until);
+  testsResult("Channel Blocks Threads",
+              total->load() == THREAD_MESSAGES * (THREAD_MESSAGES + 1) / 2);
+
+  // Test 4: select wakes up for whichever channel gets a message, whatever
+  // its type
+  Channel<int>* quiet = new Channel<int>(1);
+  Atomic<int>* selected = new Atomic<int>(-1);
+  Thread::spawn([quiet, buffers, selected] {
+    ChannelBase* channels[] = {quiet, buffers};
+    int index = select(channels, 2);
+    OwnedBuffer message;
+    selected->store(index == 1 && buffers->try_receive(message) ? index : -2);
+  });
+  buffers->send(OwnedBuffer(new uint8_t[64]));
+  until = GenericTimer::now() + GenericTimer::ns_to_counter(LOCK_BENCHMARK_TIMEOUT_NS);
+  while (selected->load() == -1 && GenericTimer::now() < until);
+  testsResult("Channel Select", selected->load() == 1);
+
+  // Test 5: Producers and consumers on different cores, one message at a
+  // time and in batches
+  uint64_t single_ns = run_channel_benchmark(false);
+  uint64_t batched_ns = run_channel_benchmark(true);
+  printf(" Channel ns per Message on %d Cores: %lu Single, %lu Batched by %lu\n",
+         NUM_CORES, single_ns, batched_ns, CHANNEL_BENCHMARK_BATCH);
+  testsResult("Channel Delivers Across Cores", single_ns != 0 && batched_ns != 0);
+}
+
+#endif  // CHANNEL_TESTS_H
@@ -0,0 +1,55 @@
+#ifndef _CONDVAR_H_
+#define _CONDVAR_H_
+
+#include "mutex.h"
+#include "wait_queue.h"
+
+/**
+ * @brief Condition variable used together with a Mutex
+ *
+ * wait() queues the caller before it unlocks the mutex, all under the lock of
+ * waiters, so a notify after the waiter saw its condition false always finds
+ * it. A woken waiter locks the mutex again before wait() returns, and should
+ * check its condition again, since another context may have got the mutex
+ * first.
+ */
+class CondVar {
+    WaitQueue waiters;
+
+public:
+    CondVar() {}
+
+    CondVar(const CondVar&) = delete;
+
+    // Unlocks mutex, which the caller holds, until notified
+    void wait(Mutex& mutex) {
+        Waiter waiter;
+        waiters.lock();
+        waiters.park(&waiter, [&mutex] { mutex.unlock(); });
+        mutex.lock();
+    }
+
+    // Waits until done() holds, with mutex held whenever it is called
+    template <typename Done>
+    void wait(Mutex& mutex, Done done) {
+        while (!done()) wait(mutex);
+    }
+
+    void notify_one() {
+        waiters.lock();
+        Waiter* next = waiters.pop();
+        waiters.unlock();
+        if (next != nullptr) {
+            WaitQueue::wake(next);
+        }
+    }
+
+    void notify_all() {
+        waiters.lock();
+        Waiter* all = waiters.take_all();
+        waiters.unlock();
+        WaitQueue::wake_all(all);
+    }
+};
+
+#endif
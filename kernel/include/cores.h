@@ -2,11 +2,15 @@
 #define CORES_H
 
 #include "atomics.h"
+#include "spin_barrier.h"
 #include "stdint.h"
 
 namespace SMP {
 extern Atomic<int> startedCores;
 
+// Met by every core once its MMU is up, so they start their timers together
+extern SpinBarrier bootBarrier;
+
 extern "C" void bootCores();
 
 extern uint8_t whichCore();
@@ -0,0 +1,99 @@
+// Citations
+// https://en.cppreference.com/w/cpp/header/coroutine
+// https://gcc.gnu.org/onlinedocs/gcc/Other-Builtins.html
+
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+/**
+ * Freestanding replacement for the parts of <coroutine> the compiler needs.
+ * GCC looks these names up in namespace std when it lowers a coroutine, so
+ * they have to live there even though the rest of the kernel has no standard
+ * library.
+ */
+namespace std {
+template <typename Ret, typename... Args>
+struct coroutine_traits {
+  using promise_type = typename Ret::promise_type;
+};
+
+template <typename Promise = void>
+struct coroutine_handle;
+
+template <>
+struct coroutine_handle<void> {
+  constexpr coroutine_handle() noexcept : frame(nullptr) {}
+  constexpr coroutine_handle(decltype(nullptr)) noexcept : frame(nullptr) {}
+
+  static coroutine_handle from_address(void* address) noexcept {
+    coroutine_handle handle;
+    handle.frame = address;
+    return handle;
+  }
+
+  void* address() const noexcept { return frame; }
+  explicit operator bool() const noexcept { return frame != nullptr; }
+  bool done() const noexcept { return __builtin_coro_done(frame); }
+
+  void operator()() const { resume(); }
+  void resume() const { __builtin_coro_resume(frame); }
+  void destroy() const { __builtin_coro_destroy(frame); }
+
+ protected:
+  void* frame;
+};
+
+template <typename Promise>
+struct coroutine_handle : coroutine_handle<> {
+  constexpr coroutine_handle() noexcept {}
+  constexpr coroutine_handle(decltype(nullptr)) noexcept {}
+
+  static coroutine_handle from_address(void* address) noexcept {
+    coroutine_handle handle;
+    handle.frame = address;
+    return handle;
+  }
+
+  static coroutine_handle from_promise(Promise& promise) noexcept {
+    coroutine_handle handle;
+    handle.frame =
+        __builtin_coro_promise((char*)&promise, __alignof(Promise), true);
+    return handle;
+  }
+
+  Promise& promise() const {
+    return *static_cast<Promise*>(
+        __builtin_coro_promise(frame, __alignof(Promise), false));
+  }
+};
+
+// Frame of a coroutine that does nothing when resumed or destroyed, laid out
+// the way GCC expects a frame to start
+struct noop_coroutine_frame {
+  static void resume_destroy(void*) {}
+
+  void (*resume)(void*) = resume_destroy;
+  void (*destroy)(void*) = resume_destroy;
+};
+
+inline noop_coroutine_frame noop_frame;
+
+// Coroutine that does nothing when resumed, for symmetric transfer
+inline coroutine_handle<> noop_coroutine() noexcept {
+  return coroutine_handle<>::from_address(&noop_frame);
+}
+
+struct suspend_always {
+  constexpr bool await_ready() const noexcept { return false; }
+  constexpr void await_suspend(coroutine_handle<>) const noexcept {}
+  constexpr void await_resume() const noexcept {}
+};
+
+struct suspend_never {
+  constexpr bool await_ready() const noexcept { return true; }
+  constexpr void await_suspend(coroutine_handle<>) const noexcept {}
+  constexpr void await_resume() const noexcept {}
+};
+}  // namespace std
+
+#endif  // COROUTINE_H
@@ -0,0 +1,153 @@
+// Citations
+// https://docs.kernel.org/scheduler/sched-deadline.html
+// https://retis.sssup.it/~lipari/papers/lipariBaruah2000.pdf (constant bandwidth server)
+
+#ifndef DEADLINE_SCHED_H
+#define DEADLINE_SCHED_H
+
+#include "definitions.h"
+#include "stdint.h"
+
+struct Event;
+
+/**
+ * @brief Timing requirements declared by deadline work, in nanoseconds. Every
+ * period, the work needs up to runtime_ns of CPU time, within deadline_ns of
+ * the start of the period.
+ */
+struct DeadlineParams {
+  uint64_t runtime_ns;
+  uint64_t deadline_ns;
+  uint64_t period_ns;
+};
+
+/**
+ * @brief Per-process or per-task state of the deadline scheduling class. All
+ * times are in generic timer ticks.
+ */
+struct DeadlineEntity {
+  static constexpr uint8_t NO_CORE = 0xFF;
+
+  uint64_t runtime = 0;
+  uint64_t deadline = 0;
+  uint64_t period = 0;
+  uint64_t bandwidth = 0;          // runtime / deadline, in BANDWIDTH_ONE units
+
+  uint64_t absolute_deadline = 0;  // Of the current period
+  int64_t remaining = 0;           // Budget left in the current period
+  uint64_t eligible_at = 0;        // Throttled until then
+  uint64_t run_start = 0;          // When the current run began, 0 if not running
+  uint64_t misses = 0;             // Periods that finished late or never ran
+
+  uint8_t core = NO_CORE;          // Core it was admitted on
+  bool budget_enforced = false;    // Throttled when out of budget (processes)
+
+  bool admitted() const { return core != NO_CORE; }
+};
+
+/**
+ * @brief Earliest deadline first scheduling with admission control
+ *
+ * Deadline work is partitioned: admission places it on the first allowed core
+ * whose admitted bandwidth stays within MAX_BANDWIDTH, and rejects it if there
+ * is none. Since every core is then at most MAX_BANDWIDTH loaded by deadlines
+ * that are no later than their period, EDF meets all of them on that core,
+ * and the rest of the time is left to other work.
+ *
+ * The event loop runs a core's earliest deadline ahead of all other events
+ * and processes, and the timer tick preempts processes and preemptible kernel
+ * events for it.
+ *
+ * Processes are budgeted as constant bandwidth servers: once a process has
+ * used its runtime for the period, its deadline moves one period on and it is
+ * throttled until that period starts, so an overrunning process cannot take
+ * more than its admitted bandwidth. A process that yields is done with its
+ * period, and likewise waits for the next one. Kernel deadline tasks (see
+ * deadline_task.h) run to completion without being preempted instead, so
+ * their work must stay within its declared runtime. Each of their jobs waits
+ * as a throttled entity for the start of its period.
+ */
+namespace DeadlineSched {
+constexpr int BANDWIDTH_SHIFT = 20;
+constexpr uint64_t BANDWIDTH_ONE = 1ull << BANDWIDTH_SHIFT;
+
+// Share of each core that deadline work may be admitted for
+constexpr uint64_t MAX_BANDWIDTH = BANDWIDTH_ONE * 95 / 100;
+
+// Shorter periods cannot be met with the 1 ms tick
+constexpr uint64_t MIN_PERIOD_NS = 2'000'000;
+
+// Most deadline entities admitted on a single core, and so queued there at
+// once
+constexpr size_t QUEUE_CAPACITY = 64;
+
+/**
+ * @brief Checks that 0 < runtime <= deadline <= period and that the period
+ * is at least MIN_PERIOD_NS
+ */
+bool valid(const DeadlineParams& params);
+
+/**
+ * @brief Admits entity on one of the cores in core_mask, setting its
+ * parameters. An entity that was already admitted gives up its old
+ * bandwidth first.
+ *
+ * @return false  params are invalid, or no allowed core has the bandwidth
+ * or a queue slot left. The entity keeps its previous admission then.
+ */
+bool admit(DeadlineEntity* entity, const DeadlineParams& params,
+           uint8_t core_mask);
+
+/**
+ * @brief Gives up the bandwidth of an admitted entity. It must not be queued.
+ */
+void release(DeadlineEntity* entity);
+
+/**
+ * @brief Makes an admitted entity runnable on its core, with event running
+ * it. An entity whose deadline has passed starts a new period from now.
+ */
+void enqueue(DeadlineEntity* entity, Event* event);
+
+/**
+ * @brief Removes the eligible entity with the earliest deadline on core
+ *
+ * @return Event*  the event that runs it, or nullptr if none
+ */
+Event* dequeue(uint8_t core);
+
+/**
+ * @brief Number of entities queued on core, throttled ones included
+ */
+size_t load(uint8_t core);
+
+/**
+ * @brief Checks if core has throttled entities waiting for their next period,
+ * in which case the core must keep ticking
+ */
+bool has_throttled(uint8_t core);
+
+/**
+ * @brief Starts timing a run of entity on the current core
+ */
+void start_run(DeadlineEntity* entity);
+
+/**
+ * @brief Charges the run that just ended to the entity's budget, and moves a
+ * finished entity on to its next period
+ *
+ * @param finished  the entity is done with its current period
+ */
+void stop_run(DeadlineEntity* entity, bool finished);
+
+/**
+ * @brief Checks if whatever runs on core must make way for deadline work.
+ * Called from the timer tick with interrupts masked.
+ *
+ * @param current  the deadline entity running on core, nullptr if the core
+ * runs other work
+ */
+bool should_preempt(uint8_t core, DeadlineEntity* current);
+}  // namespace DeadlineSched
+
+#endif  // DEADLINE_SCHED_H
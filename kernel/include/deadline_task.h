@@ -0,0 +1,81 @@
+#ifndef DEADLINE_TASK_H
+#define DEADLINE_TASK_H
+
+#include "atomics.h"
+#include "deadline_sched.h"
+#include "event_loop.h"
+
+/**
+ * @brief Periodic kernel work with a deadline
+ *
+ * A job is released at the start of every period, on the core the task was
+ * admitted on, and must finish within deadline_ns. The core runs it ahead of
+ * all other work, in earliest deadline order, and without preemption. A job
+ * that finishes late counts as a miss, as does every period skipped because
+ * the previous job was still running.
+ *
+ * A started task owns itself: once stopped, it gives up its bandwidth and
+ * deletes itself when its next job would have run.
+ */
+class DeadlineTask : public Event {
+  DeadlineEntity entity;
+  Atomic<bool> stopped;
+  Atomic<uint64_t> completed;
+
+ protected:
+  virtual void work() = 0;
+
+ public:
+  explicit DeadlineTask() : Event() {}
+
+  /**
+   * @brief Admits the task on one of the cores in core_mask and releases its
+   * first job right away
+   *
+   * @return false  params are invalid or no allowed core has the bandwidth
+   */
+  bool start(const DeadlineParams& params, uint8_t core_mask);
+
+  /**
+   * @brief Stops releasing jobs. The task gives up its bandwidth and deletes
+   * itself when its next job would have run, so the caller must not use it
+   * after this.
+   */
+  void stop() { stopped.store(true); }
+
+  uint64_t get_completed() const { return completed.load(); }
+  uint64_t get_misses() const {
+    return __atomic_load_n(&entity.misses, __ATOMIC_RELAXED);
+  }
+
+  virtual void run() override;
+};
+
+template <typename Work>
+class DeadlineTaskWithWork : public DeadlineTask {
+  Work const work_;
+
+ protected:
+  virtual void work() override { work_(); }
+
+ public:
+  explicit DeadlineTaskWithWork(Work const work) : DeadlineTask(), work_(work) {}
+};
+
+/**
+ * @brief Runs work every period as a deadline task
+ *
+ * @return DeadlineTask*  the running task, or nullptr if admission failed
+ */
+template <typename Work>
+DeadlineTask* schedule_deadline_task(const DeadlineParams& params, Work work,
+                                     uint8_t core_mask = ALL_CORES) {
+  DeadlineTask* task = new DeadlineTaskWithWork<Work>(work);
+  if (!task->start(params, core_mask)) {
+    delete task;
+    return nullptr;
+  }
+  return task;
+}
+
+#endif  // DEADLINE_TASK_H
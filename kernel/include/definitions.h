@@ -9,6 +9,10 @@
 // Stack
 #define STACK_SIZE 8192
 
+// SMP
+#define NUM_CORES 4
+#define CACHE_LINE_SIZE 64
+
 // Peripherals
 #define PERIPHERALS_BASE 0xFFFF00003F000000
 #define GPIO_BASE 0xFFFF00003F200000
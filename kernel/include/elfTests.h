@@ -3,7 +3,9 @@
 
 #include "elf.h"
 #include "event_loop.h"
+#include "generic_timer.h"
 #include "testFramework.h"
+#include "vmm.h"
 
 typedef uint32_t (*SampleProcessFunction)();
 constexpr size_t NUM_INSTRUCTIONS = 7;
@@ -77,6 +79,126 @@ char ELF_FILE[] = {
     0x60, 0x0F, 0x80, 0x52, 0xC0, 0x03, 0x5F, 0xD6
 }; */
 
+// Small user programs: a few instructions followed by two data words, loaded
+// above the identity mapped low gigabyte
+constexpr size_t USER_NUM_INSTRUCTIONS = 12;
+constexpr uint64_t USER_PROGRAM_LOAD_LOC = 0x0000'0000'4000'0000;
+
+template <size_t NumInstructions>
+struct UserELFFile {
+  ELFLoader::ELFHeader64 header;
+  ELFLoader::ProgramHeader64 programHeader;
+  uint32_t code[NumInstructions];
+  uint64_t data[2];
+} __attribute__((packed));
+
+// Loads a value (data[0]) into d0, yields 64 times, then stores 2 to the
+// result address (data[1]) if d0 still holds the value, or 1 if it does not
+const uint32_t FP_PROGRAM[USER_NUM_INSTRUCTIONS] = {
+  0x5C000180, // ldr d0, data[0]
+  0xD2800813, // mov x19, #64
+  0xD4000021, // svc 1
+  0xF1000673, // subs x19, x19, #1
+  0x54FFFFC1, // b.ne svc 1
+  0x5C0000E1, // ldr d1, data[0]
+  0x1E612000, // fcmp d0, d1
+  0x9A9F17E2, // cset x2, eq
+  0x91000442, // add x2, x2, #1
+  0x580000A3, // ldr x3, data[1]
+  0xF9000062, // str x2, [x3]
+  0xD4000001  // svc 0
+};
+
+// Pins itself to core 3, yields 64 times, then stores its migration count
+// plus one to the result address (data[0])
+const uint32_t AFFINITY_PROGRAM[USER_NUM_INSTRUCTIONS] = {
+  0xD2800100, // mov x0, #8
+  0xD4000161, // svc 0x0B
+  0xD2800813, // mov x19, #64
+  0xD4000021, // svc 1
+  0xF1000673, // subs x19, x19, #1
+  0x54FFFFC1, // b.ne svc 1
+  0xD4000181, // svc 0x0C
+  0x91000400, // add x0, x0, #1
+  0x58000083, // ldr x3, data[0]
+  0xF9000060, // str x0, [x3]
+  0xD4000001, // svc 0
+  0xD503201F  // nop
+};
+
+// Starts a process running code on the cores in core_mask, returning false
+// if it could not be loaded
+template <size_t NumInstructions>
+bool run_user_program(const uint32_t (&code)[NumInstructions], uint64_t data0,
+                      uint64_t data1, uint64_t core_mask = ALL_CORES) {
+  UserELFFile<NumInstructions> file;
+  file.header = ELF_FILE.header;
+  file.programHeader = ELF_FILE.programHeader;
+  file.header.entry = USER_PROGRAM_LOAD_LOC;
+  file.programHeader.p_vaddr = USER_PROGRAM_LOAD_LOC;
+  file.programHeader.p_filesz = sizeof(file) - file.programHeader.p_offset;
+  file.programHeader.p_memsz = file.programHeader.p_filesz;
+  for (size_t i = 0; i < NumInstructions; i++) file.code[i] = code[i];
+  file.data[0] = data0;
+  file.data[1] = data1;
+
+  Process* process = new Process();
+  if (!ELFLoader::load((const char*) &file, sizeof(file), process).success()) {
+    return false;
+  }
+  process->set_affinity(core_mask);
+  process->schedule();
+  return true;
+}
+
+// The low gigabyte is identity mapped for every process, so user programs
+// report back by storing to the physical address of a kernel variable
+uint64_t user_address(volatile uint64_t* result) {
+  return (uint64_t) VMM::kernel_to_phys_ptr(result);
+}
+
+// Two processes keep different values in d0 across many switches, while the
+// kernel uses the FP/SIMD registers in between
+void fpStateTest() {
+  static volatile uint64_t results[2];
+  const double values[2] = {1.5, -2.25};
+
+  for (int i = 0; i < 2; i++) {
+    results[i] = 0;
+    uint64_t value_bits;
+    __builtin_memcpy(&value_bits, &values[i], sizeof(value_bits));
+    if (!run_user_program(FP_PROGRAM, value_bits, user_address(&results[i]))) {
+      testsResult("FP State Preserved", false);
+      return;
+    }
+  }
+
+  double kernel_value = 0;
+  uint64_t until = GenericTimer::now() + GenericTimer::ns_to_counter(2'000'000'000);
+  while ((results[0] == 0 || results[1] == 0) && GenericTimer::now() < until) {
+    kernel_value = kernel_value * 0.5 + 1.0;
+  }
+
+  testsResult("FP State Preserved", results[0] == 2 && results[1] == 2);
+  testsResult("FP State Kernel Unaffected", kernel_value > 1.0 && kernel_value <= 2.0);
+}
+
+// A process started on core 1 that pins itself to core 3 moves there exactly
+// once, however often it yields
+void affinityTest() {
+  static volatile uint64_t result;
+  result = 0;
+  if (!run_user_program(AFFINITY_PROGRAM, user_address(&result), 0, 1 << 1)) {
+    testsResult("Affinity Pins Process", false);
+    return;
+  }
+
+  uint64_t until = GenericTimer::now() + GenericTimer::ns_to_counter(2'000'000'000);
+  while (result == 0 && GenericTimer::now() < until);
+
+  testsResult("Affinity Pins Process", result == 2);
+}
+
 char READ_BUFFER[sizeof(ELF_FILE)];
 
 bool equal(const char* a, const char* b, size_t size) {
@@ -91,7 +213,7 @@ void elfTests() {
   char* data = (char*) &ELF_FILE;
   constexpr size_t size = sizeof(ELF_FILE);
 
-  Process* process = (Process*) malloc(sizeof(Process));
+  Process* process = new Process();
   ELFLoader::Result result = ELFLoader::load(data, size, process);
   bool success = result.success();
   testsResult("ELF Load 1", success);
@@ -106,6 +228,9 @@ void elfTests() {
 
   printf(" ELF should have printed 'hi' above\n");
   printf(" ELF Run Random Result: %lu\n", value);
+
+  fpStateTest();
+  affinityTest();
 }
 
 #endif // ELF_TESTS_H
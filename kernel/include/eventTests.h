@@ -2,9 +2,15 @@
 #define EVENTTESTS_H
 
 #include "atomics.h"
+#include "cores.h"
+#include "definitions.h"
 #include "event_loop.h"
+#include "generic_timer.h"
+#include "preempt.h"
 #include "printf.h"
+#include "sched_stats.h"
 #include "testFramework.h"
+#include "timer_wheel.h"
 
 void eventLoopTests() {
   initTests("Event Loop Tests");
@@ -20,6 +26,232 @@ void eventLoopTests() {
   }
 
   testsResult("Basic event scheduling", 10 == total.load());
+
+  // Test 2: Every priority level runs
+  total.store(0);
+  schedule_event([&] { total.add_fetch(1); }, Priority::Urgent);
+  schedule_event([&] { total.add_fetch(1); }, Priority::Normal);
+  schedule_event([&] { total.add_fetch(1); }, Priority::Background);
+
+  while (total.load() < 3) {
+  }
+
+  testsResult("Events run at every priority", 3 == total.load());
+
+  // Test 3: Background work still runs under a constant urgent flood
+  Atomic<bool> stop(false);
+  Atomic<bool> background_ran(false);
+  Atomic<int> flooding(0);
+  constexpr int FLOOD_EVENTS = 16;
+
+  struct Flood {
+    static void run(Atomic<bool>* stop, Atomic<int>* flooding) {
+      if (stop->load()) {
+        flooding->add_fetch(-1);
+        return;
+      }
+      schedule_event([stop, flooding] { Flood::run(stop, flooding); },
+                     Priority::Urgent);
+    }
+  };
+
+  for (int i = 0; i < FLOOD_EVENTS; i++) {
+    flooding.add_fetch(1);
+    Flood::run(&stop, &flooding);
+  }
+  schedule_event([&] { background_ran.store(true); }, Priority::Background);
+
+  for (uint64_t spins = 0; !background_ran.load() && spins < 100000000;
+       spins++) {
+  }
+  bool aged = background_ran.load();
+
+  stop.store(true);
+  while (flooding.load() > 0) {
+  }
+
+  testsResult("Background work ages past urgent flood", aged);
+
+  constexpr uint64_t MS = 1000000;
+  auto spin_for = [](uint64_t ns) {
+    uint64_t until = GenericTimer::now() + GenericTimer::ns_to_counter(ns);
+    while (GenericTimer::now() < until) {
+    }
+  };
+
+  // Test 4: Delayed event runs no earlier than its delay
+  Atomic<uint64_t> fired_at(0);
+  uint64_t scheduled_at = GenericTimer::now();
+  schedule_event_after(5 * MS, [&] { fired_at.store(GenericTimer::now()); });
+
+  while (fired_at.load() == 0) {
+  }
+
+  testsResult("Delayed event waits for its delay",
+              fired_at.load() - scheduled_at >=
+                  GenericTimer::ns_to_counter(5 * MS));
+
+  // Test 5: Periodic event keeps firing until cancelled
+  Atomic<int> periodic_count(0);
+  TimerHandle periodic = schedule_event_every(
+      1 * MS, [&] { periodic_count.add_fetch(1); });
+
+  while (periodic_count.load() < 5) {
+  }
+  bool periodic_cancelled = TimerWheel::cancel(periodic);
+  spin_for(5 * MS);  // Let an already queued firing drain
+  int count_after_cancel = periodic_count.load();
+  spin_for(10 * MS);
+
+  testsResult("Periodic event stops after cancel",
+              periodic_cancelled &&
+                  count_after_cancel == periodic_count.load());
+
+  // Test 6: A periodic event slower than its period never overlaps itself
+  Atomic<int> slow_running(0);
+  Atomic<int> slow_count(0);
+  Atomic<bool> overlapped(false);
+  TimerHandle slow = schedule_event_every(1 * MS, [&] {
+    if (slow_running.add_fetch(1) != 1) overlapped.store(true);
+    spin_for(3 * MS);
+    slow_running.add_fetch(-1);
+    slow_count.add_fetch(1);
+  });
+
+  while (slow_count.load() < 5) {
+  }
+  TimerWheel::cancel(slow);
+  spin_for(10 * MS);  // Let a run in flight finish and free the event
+
+  testsResult("Periodic event never overlaps itself",
+              !overlapped.load() && slow_running.load() == 0);
+
+  // Test 7: Cancelled one-shot never runs and its handle goes stale
+  Atomic<bool> cancelled_ran(false);
+  TimerHandle one_shot =
+      schedule_event_after(10 * MS, [&] { cancelled_ran.store(true); });
+  bool first_cancel = TimerWheel::cancel(one_shot);
+  bool second_cancel = TimerWheel::cancel(one_shot);
+  spin_for(20 * MS);
+
+  testsResult("Cancelled one-shot event never runs",
+              first_cancel && !second_cancel && !cancelled_ran.load());
+
+  // Test 8: A long kernel event does not hold up other events on its core
+  // for much longer than a quantum
+  constexpr uint64_t SPIN_NS = 500 * MS;
+  Atomic<int> spinning(0);
+  for (int i = 0; i < NUM_CORES; i++) {
+    spinning.add_fetch(1);
+    schedule_event([&] {
+      spin_for(SPIN_NS);
+      spinning.add_fetch(-1);
+    });
+  }
+
+  Atomic<uint64_t> short_ran_at(0);
+  uint64_t short_scheduled_at = GenericTimer::now();
+  schedule_event([&] { short_ran_at.store(GenericTimer::now()); });
+
+  while (short_ran_at.load() == 0) {
+  }
+  uint64_t latency = short_ran_at.load() - short_scheduled_at;
+  while (spinning.load() > 0) {
+  }
+
+  testsResult("Long kernel events are preempted",
+              latency < GenericTimer::ns_to_counter(
+                            10 * GenericTimer::DEFAULT_QUANTUM_NS));
+
+  // Test 9: Code with preemption disabled stays on its core
+  for (int i = 0; i < NUM_CORES; i++) {
+    spinning.add_fetch(1);
+    schedule_event([&] {
+      spin_for(200 * MS);
+      spinning.add_fetch(-1);
+    });
+  }
+
+  bool stayed = true;
+  {
+    PreemptGuard guard;
+    uint8_t core = SMP::whichCore();
+    uint64_t until = GenericTimer::now() + GenericTimer::ns_to_counter(300 * MS);
+    while (GenericTimer::now() < until) {
+      if (SMP::whichCore() != core) stayed = false;
+    }
+  }
+  while (spinning.load() > 0) {
+  }
+
+  testsResult("Preemption disabled section stays on its core", stayed);
+
+#if SCHED_STATS
+  // Test 10: Every event that runs is counted with its wait
+  static SchedStats::Snapshot before;
+  static SchedStats::Snapshot after;
+  SchedStats::snapshot(&before);
+  total.store(0);
+  for (int i = 0; i < 100; i++) {
+    schedule_event([&] { total.add_fetch(1); });
+  }
+  while (total.load() < 100) {
+  }
+  SchedStats::snapshot(&after);
+
+  uint64_t events_run = 0;
+  uint64_t waits = 0;
+  for (int core = 0; core < NUM_CORES; core++) {
+    events_run += after.cores[core].events_run - before.cores[core].events_run;
+    for (int i = 0; i < SchedStats::HISTOGRAM_BUCKETS; i++) {
+      waits += after.cores[core].latency[i] - before.cores[core].latency[i];
+    }
+  }
+  testsResult("Scheduler statistics count events", events_run >= 100 && waits >= 100);
+#endif
+
+  // Benchmark: a chain of empty events, each queueing the next, against the
+  // statistics recorded for each one. Building with SCHED_STATS_ENABLED=0
+  // gives the chain without statistics.
+  constexpr int EVENT_BENCHMARK_EVENTS = 10000;
+  struct Chain {
+    static void run(Atomic<int>* left) {
+      if (left->add_fetch(-1) == 0) return;
+      schedule_event([left] { Chain::run(left); });
+    }
+  };
+
+  Atomic<int> chain_left(EVENT_BENCHMARK_EVENTS);
+  uint64_t chain_start = GenericTimer::now();
+  schedule_event([&chain_left] { Chain::run(&chain_left); });
+  while (chain_left.load() > 0) {
+  }
+  uint64_t chain_ticks = GenericTimer::now() - chain_start;
+  benchResult("Empty event", EVENT_BENCHMARK_EVENTS, chain_ticks);
+
+#if SCHED_STATS
+  // The same stamp and hooks the loop runs per event, on this core's counters,
+  // which are put back afterwards
+  uint64_t stats_ticks;
+  {
+    PreemptGuard guard;
+    uint8_t core = SMP::whichCore();
+    static SchedStats::CoreState saved;
+    saved = SchedStats::core_state[core];
+    uint64_t start = GenericTimer::now();
+    for (int i = 0; i < EVENT_BENCHMARK_EVENTS; i++) {
+      SchedStats::event_started(core, SchedStats::now());
+      SchedStats::event_finished(core);
+    }
+    stats_ticks = GenericTimer::now() - start;
+    SchedStats::core_state[core] = saved;
+  }
+  benchResult("Statistics per event", EVENT_BENCHMARK_EVENTS, stats_ticks);
+
+  uint64_t basis_points = stats_ticks * 10000 / (chain_ticks == 0 ? 1 : chain_ticks);
+  printf(" %s Bench: Statistics overhead: %lu.%02lu%% of an empty event\n",
+         testsName, basis_points / 100, basis_points % 100);
+#endif
 }
 
 #endif
@@ -4,12 +4,28 @@
 #ifndef EVENT_LOOP_H
 #define EVENT_LOOP_H
 
+#include "deadline_sched.h"
+#include "definitions.h"
+#include "fair_sched.h"
 #include "heap.h"
+#include "preempt.h"
 #include "printf.h"
-#include "queue.h"
+#include "ring_queue.h"
+#include "sched_stats.h"
+
+// Core mask that allows an event to run anywhere
+constexpr uint8_t ALL_CORES = (1 << NUM_CORES) - 1;
 
 struct Event {
-  // General Event data goes here
+  // Cores allowed to steal the event from a local queue
+  uint8_t core_mask = ALL_CORES;
+
+  // Next older event while in an EventQueue's overflow list
+  Event* overflow_next = nullptr;
+
+#if SCHED_STATS
+  uint64_t enqueued_at = 0;
+#endif
 
   explicit inline Event() {}
   virtual void run() = 0;
@@ -36,15 +52,143 @@ struct EventWithWorkAndValue : public EventWithWork<Work> {
   }
 };
 
-extern LocklessQueue<Event*>* ready_queue;
+/**
+ * @brief Scheduling class of an event. The event loop always runs the highest
+ * non-empty level first, except that a lower level passed over
+ * AGING_THRESHOLD times in a row gets to run one event. Deadline work (see
+ * deadline_sched.h) runs ahead of every level.
+ */
+enum class Priority : uint8_t {
+  Urgent = 0,     // Kernel-urgent: interrupt follow-up and I/O completions
+  Normal = 1,     // Default for kernel work, then runnable processes
+  Background = 2  // Deferrable work
+};
+
+constexpr int NUM_PRIORITIES = 3;
+
+// Number of times a non-empty level may be passed over before it runs
+constexpr uint32_t AGING_THRESHOLD = 16;
+
+// Events that can wait to run per level before they spill into the overflow
+// list
+constexpr size_t READY_QUEUE_CAPACITY = 4096;
+
+// Same, for the events queued for one particular core
+constexpr size_t LOCAL_QUEUE_CAPACITY = 256;
+
+// An idle core only steals from another core's local queues once they hold
+// more than this many events. Below that, the event is left to wait for the
+// core whose caches are warm for it.
+constexpr size_t MIGRATION_THRESHOLD = 1;
+
+/**
+ * @brief Queue of events whose enqueue never fails or waits, so interrupt
+ * handlers can queue events however busy the cores are
+ *
+ * Events go into a bounded RingQueue. While it is full they are pushed onto
+ * an overflow list instead, linked through the events themselves, and
+ * dequeues move them back into the ring as room frees up, oldest first.
+ * Events that overflowed may run after some that were queued later, but none
+ * is lost.
+ */
+class EventQueue {
+  struct Queued {
+    Event* event;
+    uint8_t core_mask;  // Copied so a steal can check it before claiming
+  };
+
+  RingQueue<Queued> ring;
+  Event* overflow = nullptr;  // Newest first
+  size_t overflowed = 0;      // Events in overflow
+
+  void push_overflow(Event* newest, Event* oldest, size_t count);
+  Event* take_overflow();
+  void move_to_ring(Event* oldest);
+
+ public:
+  explicit EventQueue(size_t capacity) : ring(capacity) {}
+
+  EventQueue(const EventQueue&) = delete;
+  EventQueue& operator=(const EventQueue&) = delete;
+
+  void enqueue(Event* event);
+  bool try_dequeue(Event*& event);
+
+  // Dequeues the front event only if it may run on core, leaving the queue
+  // as it was otherwise. Overflowed events are left to the queue's owner.
+  bool try_steal(uint8_t core, Event*& event);
+
+  bool is_empty() const {
+    return ring.is_empty() && __atomic_load_n(&overflow, __ATOMIC_RELAXED) == nullptr;
+  }
+
+  // Approximate number of queued events
+  size_t size() const {
+    return ring.size() + __atomic_load_n(&overflowed, __ATOMIC_RELAXED);
+  }
+};
+
+extern EventQueue* ready_queues[NUM_PRIORITIES];
+extern EventQueue* local_queues[NUM_CORES][NUM_PRIORITIES];
 
 void init_event_loop();
 [[noreturn]] void event_loop();
 
+// Queues an already constructed event
+inline void enqueue_event(Event* event, Priority priority) {
+#if SCHED_STATS
+  event->enqueued_at = SchedStats::now();
+#endif
+
+  // A claimed but unpublished slot would hide every event queued behind it
+  PreemptGuard guard;
+  ready_queues[static_cast<int>(priority)]->enqueue(event);
+
+  // Wakes idle cores sleeping in the event loop
+  __asm__ volatile("sev" ::: "memory");
+}
+
+// Queues an already constructed event for a particular core. The core runs
+// it ahead of shared events of the same priority, and other cores only take it
+// if they are idle, the core is overloaded and event->core_mask allows them.
+inline void enqueue_event_on(uint8_t core, Event* event, Priority priority) {
+#if SCHED_STATS
+  event->enqueued_at = SchedStats::now();
+#endif
+
+  PreemptGuard guard;
+  local_queues[core][static_cast<int>(priority)]->enqueue(event);
+
+  __asm__ volatile("sev" ::: "memory");
+}
+
+// Number of events and runnable processes waiting on a core
+inline size_t local_queue_load(uint8_t core) {
+  size_t load = FairSched::load(core);
+  for (int level = 0; level < NUM_PRIORITIES; level++) {
+    load += local_queues[core][level]->size();
+  }
+  return load;
+}
+
+// Checks if any level has a kernel event waiting that the given core may run,
+// leaving out runnable processes
+inline bool has_ready_kernel_events(uint8_t core) {
+  for (int level = 0; level < NUM_PRIORITIES; level++) {
+    if (!ready_queues[level]->is_empty()) return true;
+    if (!local_queues[core][level]->is_empty()) return true;
+  }
+  return false;
+}
+
+// Checks if the given core has anything waiting to run
+inline bool has_ready_events(uint8_t core) {
+  return has_ready_kernel_events(core) || FairSched::load(core) > 0;
+}
+
 template <typename Work>
-void schedule_event(Work work) {
-  Event* event = new EventWithWork<Work>(work);
-  ready_queue->enqueue(event);
+void schedule_event(Work work, Priority priority = Priority::Normal) {
+  enqueue_event(new EventWithWork<Work>(work), priority);
 }
 
 #endif  // EVENT_LOOP_H
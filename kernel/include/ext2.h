@@ -5,6 +5,7 @@
 #include "physmem.h"
 #include "printf.h"
 #include "sd.h"
+#include "seqlock.h"
 
 /*
  * EXT2 Filesystem Implementation
@@ -87,6 +88,27 @@ extern BGDT* bgdt;                 // Pointer to the first block group descripto
 extern uint32_t SB_offset;         // Offset to the superblock (1024 bytes)
 extern uint32_t BGDT_index;        // Block index of the BGDT
 
+// Layout of the mounted filesystem, read on every inode and block lookup.
+// supa and bgdt hold the on-disk images, which only mounting and the
+// allocators touch, and those publish this copy after every change, so
+// lookups read it without locking and never see a half-updated one.
+struct Ext2Layout {
+    uint32_t block_size;           // In bytes
+    uint32_t inode_size;
+    uint32_t inodes_per_group;
+    uint32_t num_blocks;
+    uint32_t inode_table_block;    // First block of group 0's inode table
+    uint32_t block_bitmap_block;
+    uint32_t inode_bitmap_block;
+    uint32_t free_blocks;
+    uint32_t free_inodes;
+};
+
+extern SeqLock<Ext2Layout> ext2_layout;
+
+// Copies supa and bgdt into ext2_layout
+void publish_ext2_layout();
+
 // Forward declarations
 class Node;
 
@@ -235,21 +257,23 @@ public:
         // Allocate and initialize the inode
         node = new iNode();
         
+        const Ext2Layout layout = ext2_layout.read();
+
         // Calculate which block group contains this inode
-        block_group = (number - 1) / supa->num_iNode_pergroup;
+        block_group = (number - 1) / layout.inodes_per_group;
         // Calculate index within the block group
-        index = (number - 1) % supa->num_iNode_pergroup;
+        index = (number - 1) % layout.inodes_per_group;
         
         // Set BGDT index based on block size
-        if ((1024 << supa->block_size) == 1024) {
+        if (layout.block_size == 1024) {
             BGDT_index = 2;
         } else {
             BGDT_index = 1;
         }
         
         // Read the inode data from disk
-        uint32_t inode_offset = bgdt->startingBlockAddress * (1024 << supa->block_size) + 
-                               index * supa->iNode_size;
+        uint32_t inode_offset = layout.inode_table_block * layout.block_size + 
+                               index * layout.inode_size;
         
         debug_printf("DEBUG: Node constructor: Reading inode data from offset 0x%x\n", inode_offset);
         sd_adapter->read_all(inode_offset, sizeof(iNode), (char*)node);
@@ -283,7 +307,10 @@ public:
         debug_printf("DEBUG: Node::read_block: inode %u, block %u\n", number, block_number);
         
         // Calculate how many pointers fit in one block
-        uint32_t N = (1024 << supa->block_size) / 4;
+        uint32_t fs_block_size = ext2_layout.read([](const Ext2Layout& layout) {
+            return layout.block_size;
+        });
+        uint32_t N = fs_block_size / 4;
         
         if (block_number < 12) {
             // Direct block - directly referenced by the inode
@@ -295,8 +322,8 @@ public:
             
             debug_printf("DEBUG: Node::read_block: Reading direct block at physical block %u\n", 
                   node->directLinked[block_number]);
-            sd_adapter->read_all(node->directLinked[block_number] * (1024 << supa->block_size), 
-                            (1024 << supa->block_size), buffer);
+            sd_adapter->read_all(node->directLinked[block_number] * fs_block_size, 
+                            fs_block_size, buffer);
         } else if (block_number < (12 + N)) {
             // Single indirect block - referenced through a single indirection
             debug_printf("DEBUG: Node::read_block: Single indirect blocks not implemented\n");
@@ -424,6 +451,8 @@ public:
         bgdt = new BGDT();
         adapter->read_all(BGDT_index * (1024 << supa->block_size), sizeof(BGDT), (char*)bgdt);
         
+        publish_ext2_layout();
+
         // Create the root node (inode 2 in ext2)
         root = new Node(1024 << supa->block_size, 2, adapter);
         
@@ -453,12 +482,12 @@ public:
     
     // Returns the block size of the filesystem
     uint32_t get_block_size() {
-        return 1024 << supa->block_size;
+        return ext2_layout.read([](const Ext2Layout& layout) { return layout.block_size; });
     }
     
     // Returns the inode size of the filesystem
     uint32_t get_inode_size() {
-        return supa->iNode_size;
+        return ext2_layout.read([](const Ext2Layout& layout) { return layout.inode_size; });
     }
 };
 
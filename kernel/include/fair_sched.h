@@ -0,0 +1,118 @@
+// Citations
+// https://docs.kernel.org/scheduler/sched-design-CFS.html
+// https://elixir.bootlin.com/linux/v6.6/source/kernel/sched/core.c (sched_prio_to_weight)
+
+#ifndef FAIR_SCHED_H
+#define FAIR_SCHED_H
+
+#include "definitions.h"
+#include "stdint.h"
+
+struct Event;
+class Process;
+
+/**
+ * @brief Per-process state of the fair scheduling class
+ */
+struct FairEntity {
+  static constexpr uint8_t NO_CORE = 0xFF;
+
+  uint64_t vruntime = 0;      // Weighted generic timer ticks run so far
+  uint64_t weight = 1024;     // From the nice value
+  uint64_t slice_start = 0;   // When the current slice began, 0 if not running
+  int8_t nice = 0;
+  uint8_t home_core = NO_CORE;  // Core whose min_vruntime vruntime is relative to
+};
+
+/**
+ * @brief CFS-like fair scheduling of user processes
+ *
+ * Every process accumulates virtual runtime: the time it ran, scaled by
+ * NICE_0_WEIGHT / weight, so a process with twice the weight accumulates it
+ * half as fast. Each core keeps its runnable processes in a min-heap ordered
+ * by virtual runtime, and always runs the one that has had the least.
+ *
+ * Runnable processes take part in event loop scheduling at Priority::Normal,
+ * after the Normal kernel events of the core. The timer tick preempts a
+ * process once it has run for its share of SCHED_LATENCY_NS, or once it is
+ * that far ahead of the leftmost waiting process, but never before
+ * MIN_GRANULARITY_NS.
+ *
+ * A process that was not runnable for a while (for example because it
+ * yielded, or it is new) is placed at most WAKEUP_CREDIT_NS behind the
+ * core's minimum virtual runtime. It then runs soon, but it cannot have
+ * saved up enough credit to starve the others. A process moving to another
+ * core keeps its lag relative to that core's minimum.
+ */
+namespace FairSched {
+constexpr uint64_t NICE_0_WEIGHT = 1024;
+constexpr int MIN_NICE = -20;
+constexpr int MAX_NICE = 19;
+
+constexpr uint64_t SCHED_LATENCY_NS = 20'000'000;
+constexpr uint64_t MIN_GRANULARITY_NS = 2'000'000;
+constexpr uint64_t WAKEUP_CREDIT_NS = SCHED_LATENCY_NS / 2;
+
+// Room every core's runqueue starts with once a process exists
+constexpr size_t MIN_QUEUE_CAPACITY = 16;
+
+/**
+ * @brief Weight of a nice value, each step being roughly 25% of CPU share
+ */
+uint64_t weight_for_nice(int nice);
+
+/**
+ * @brief Counts a new process, growing every core's runqueue so that it can
+ * hold all processes at once. Called when a process is created, where
+ * allocating is safe, so that enqueue() never has to.
+ */
+void add_process();
+
+/**
+ * @brief Stops counting a destroyed process. Runqueues keep their room.
+ */
+void remove_process();
+
+/**
+ * @brief Makes process runnable on core
+ */
+void enqueue(uint8_t core, Process* process);
+
+/**
+ * @brief Removes the runnable process with the least virtual runtime on core
+ *
+ * @return Event*  the event that runs the process, or nullptr if none
+ */
+Event* dequeue(uint8_t core);
+
+/**
+ * @brief Removes the leftmost process of victim if it may run on thief
+ *
+ * @return Event*  the event that runs the process, or nullptr if none
+ */
+Event* steal(uint8_t victim, uint8_t thief);
+
+/**
+ * @brief Number of runnable processes queued on core
+ */
+size_t load(uint8_t core);
+
+/**
+ * @brief Starts timing the slice of a process that is about to run
+ */
+void start_slice(Process* process, uint8_t core);
+
+/**
+ * @brief Charges the slice that just ended to the process's virtual runtime.
+ * Does nothing if the process is not in a slice.
+ */
+void stop_slice(Process* process);
+
+/**
+ * @brief Checks if the process running at EL0 on core has used up its share.
+ * Called from the timer tick with interrupts masked.
+ */
+bool should_preempt(uint8_t core, Process* current);
+}  // namespace FairSched
+
+#endif  // FAIR_SCHED_H
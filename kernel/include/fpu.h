@@ -0,0 +1,79 @@
+// Citations
+// https://developer.arm.com/documentation/ddi0601/2025-03/AArch64-Registers/CPACR-EL1--Architectural-Feature-Access-Control-Register
+
+#ifndef FPU_H
+#define FPU_H
+
+#include "machine.h"
+#include "stdint.h"
+
+/**
+ * @brief FP/SIMD state of a user process, plus the core whose registers last
+ * held it
+ */
+struct FPContext {
+  static constexpr uint8_t NO_CORE = 0xFF;
+
+  FPState state{};
+  uint8_t core = NO_CORE;
+};
+
+/**
+ * @brief Lazy switching of the FP/SIMD registers between user processes
+ *
+ * Each core remembers which process owns its FP/SIMD registers. CPACR_EL1
+ * traps FP/SIMD instructions whenever the registers do not belong to whoever
+ * is running:
+ *
+ * - A process that touches FP/SIMD without owning the registers traps once,
+ *   the previous owner is saved if its registers were modified, and the
+ *   process's own state is loaded.
+ * - Exception entry from EL0 turns the trap back on for EL1 (see
+ *   interrupt_handler.s), so the owner's registers survive system calls and
+ *   interrupts untouched unless kernel code uses FP/SIMD, in which case the
+ *   kernel traps once and saves the owner first.
+ * - A process returning to the core that still holds its registers runs with
+ *   FP/SIMD enabled straight away, without any save or restore.
+ *
+ * A process leaving the core (yield, preemption) has its registers saved if
+ * it modified them, since it may be picked up by another core next. The core
+ * still remembers it as the owner, so coming back to the same core restores
+ * nothing.
+ *
+ * All functions act on the current core and must run with interrupts masked.
+ */
+namespace FPU {
+/**
+ * @brief Sets up the FP/SIMD trap for returning to context at EL0. Must be
+ * the last thing before the eret, since kernel code that follows may not
+ * touch FP/SIMD.
+ */
+void enter_user(FPContext* context);
+
+/**
+ * @brief Saves context if its registers were modified on this core. Called
+ * when its process stops running on this core.
+ */
+void release(FPContext* context);
+
+/**
+ * @brief Drops context from this core without saving it. Called when its
+ * process is destroyed.
+ */
+void forget(FPContext* context);
+
+/**
+ * @brief Saves the owner's registers if they were modified and leaves them to
+ * kernel code, for kernel code that is about to use them and must not trap
+ */
+void take_for_kernel();
+
+/**
+ * @brief Handles a trapped FP/SIMD access (ESR_EL1 class 0b000111)
+ *
+ * @param from_user  the access came from EL0 rather than from kernel code
+ */
+void handle_trap(bool from_user);
+}  // namespace FPU
+
+#endif  // FPU_H
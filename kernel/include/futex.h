@@ -0,0 +1,75 @@
+// Citations
+// https://man7.org/linux/man-pages/man2/futex.2.html
+// https://www.akkadia.org/drepper/futex.pdf
+
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include "stdint.h"
+#include "system_call.h"
+#include "timer_wheel.h"
+
+class Process;
+struct FutexQueue;
+
+/**
+ * @brief A process's place in a futex wait queue. Every process owns one,
+ * since it waits on at most one futex at a time.
+ */
+struct FutexWaiter {
+  Process* const process;
+  FutexWaiter* next = nullptr;
+  FutexWaiter* prev = nullptr;
+  FutexQueue* queue = nullptr;  // Queue it waits in, nullptr when not waiting
+  TimerHandle timeout{};        // Of the current wait, if it has one
+
+  explicit FutexWaiter(Process* process) : process(process) {}
+};
+
+/**
+ * @brief Wait queues for user-space synchronization
+ *
+ * A futex is any aligned 32-bit word in user memory. Waiters are queued by
+ * the physical address of the word, so processes that map the same memory at
+ * different addresses still meet. The queues live in a HashMap and are kept
+ * once created, so a queue pointer read from the map stays valid.
+ *
+ * The check of the word and the queueing happen under the queue's lock, which
+ * wake also takes, so a wake that follows a change of the word cannot be
+ * missed.
+ *
+ * Whoever takes a waiter off its queue schedules the process, except when a
+ * wake finds that the waiter's timeout has already fired: the timeout event
+ * then schedules it instead, so the process cannot run (and exit) while that
+ * event still refers to it.
+ */
+namespace Futex {
+constexpr int INITIAL_BUCKETS = 64;
+
+/**
+ * @brief Creates the queue table. Called once at boot, after the heap.
+ */
+void init();
+
+/**
+ * @brief Blocks the running process on the word at addr if it still holds
+ * expected, until a wake or until timeout_ns pass (0 waits forever). Does not
+ * return if the process blocks, in which case the system call returns 0 on a
+ * wake and TIMED_OUT on a timeout.
+ *
+ * @return the error to return instead: INVALID_POINTER for an unaligned or
+ * unmapped address, WOULD_BLOCK if the word did not hold expected
+ */
+Syscall::ErrorCode wait(uint32_t* addr, uint32_t expected, uint64_t timeout_ns,
+                        uint64_t* saved_state);
+
+/**
+ * @brief Wakes up to count processes waiting on the word at addr, oldest
+ * first
+ *
+ * @return the number woken, or -1 if addr is unaligned or unmapped
+ */
+long wake(uint32_t* addr, uint64_t count);
+}  // namespace Futex
+
+#endif  // FUTEX_H
@@ -0,0 +1,132 @@
+#ifndef FUTEX_TESTS_H
+#define FUTEX_TESTS_H
+
+#include "elfTests.h"
+#include "generic_timer.h"
+#include "printf.h"
+#include "system_call.h"
+#include "testFramework.h"
+
+constexpr uint64_t FUTEX_TEST_ITERATIONS = 20000;
+constexpr uint64_t FUTEX_TEST_TIMEOUT_NS = 5'000'000'000;
+
+// Shared with MUTEX_PROGRAM, which finds its address in data[0]
+struct MutexControl {
+  uint64_t lock;        // The low 32 bits are the futex word
+  uint64_t counter;     // Only changed while holding the lock
+  uint64_t iterations;
+  uint64_t done;        // Programs that finished
+};
+
+// Increments control->counter control->iterations times under a futex mutex
+// (0 unlocked, 1 locked, 2 locked with waiters), then adds one to
+// control->done
+const uint32_t MUTEX_PROGRAM[40] = {
+  0x58000513, // ldr x19, data[0]
+  0xF9400A74, // ldr x20, [x19, #16]
+  0x885FFE61, // ldaxr w1, [x19]
+  0x350000A1, // cbnz w1, clrex
+  0x52800022, // mov w2, #1
+  0x88037E62, // stxr w3, w2, [x19]
+  0x35FFFF83, // cbnz w3, ldaxr w1
+  0x1400000C, // b ldr x4
+  0xD5033F5F, // clrex
+  0x52800042, // mov w2, #2
+  0x885FFE61, // ldaxr w1, [x19]
+  0x88037E62, // stxr w3, w2, [x19]
+  0x35FFFFA3, // cbnz w3, mov w2
+  0x340000C1, // cbz w1, ldr x4
+  0xAA1303E0, // mov x0, x19
+  0x52800041, // mov w1, #2
+  0xD2800002, // mov x2, #0
+  0xD4000201, // svc 0x10
+  0x17FFFFF7, // b mov w2
+  0xF9400664, // ldr x4, [x19, #8]
+  0x91000484, // add x4, x4, #1
+  0xF9000664, // str x4, [x19, #8]
+  0x885F7E61, // ldxr w1, [x19]
+  0x51000422, // sub w2, w1, #1
+  0x8803FE62, // stlxr w3, w2, [x19]
+  0x35FFFFA3, // cbnz w3, ldxr w1
+  0x7100043F, // cmp w1, #1
+  0x540000A0, // b.eq subs x20
+  0x889FFE7F, // stlr wzr, [x19]
+  0xAA1303E0, // mov x0, x19
+  0xD2800021, // mov x1, #1
+  0xD4000221, // svc 0x11
+  0xF1000694, // subs x20, x20, #1
+  0x54FFFC21, // b.ne ldaxr w1
+  0x91006265, // add x5, x19, #24
+  0xC85F7CA6, // ldxr x6, [x5]
+  0x910004C6, // add x6, x6, #1
+  0xC807FCA6, // stlxr w7, x6, [x5]
+  0x35FFFFA7, // cbnz w7, ldxr x6
+  0xD4000001  // svc 0
+};
+
+// Shared with FUTEX_ERRORS_PROGRAM, which finds its address in data[0]
+struct FutexErrorsControl {
+  uint64_t word;           // The low 32 bits are the futex word, kept at 0
+  uint64_t would_block;    // x1 of a wait expecting 1
+  uint64_t timed_out;      // x1 of a wait expecting 0 with a 5 ms timeout
+};
+
+// Waits on control->word expecting 1, then expecting 0 for at most 5 ms,
+// storing the error code of each wait in control
+const uint32_t FUTEX_ERRORS_PROGRAM[14] = {
+  0x580001D3, // ldr x19, data[0]
+  0xAA1303E0, // mov x0, x19
+  0x52800021, // mov w1, #1
+  0xD2800002, // mov x2, #0
+  0xD4000201, // svc 0x10
+  0xF9000661, // str x1, [x19, #8]
+  0xAA1303E0, // mov x0, x19
+  0x52800001, // mov w1, #0
+  0xD2896802, // mov x2, #0x4B40
+  0xF2A00982, // movk x2, #0x4C, lsl #16
+  0xD4000201, // svc 0x10
+  0xF9000A61, // str x1, [x19, #16]
+  0xD4000001, // svc 0
+  0xD503201F  // nop
+};
+
+// Waits until *value reaches target or FUTEX_TEST_TIMEOUT_NS pass
+bool wait_for_value(volatile uint64_t* value, uint64_t target) {
+  uint64_t until = GenericTimer::now() + GenericTimer::ns_to_counter(FUTEX_TEST_TIMEOUT_NS);
+  while (*value != target && GenericTimer::now() < until);
+  return *value == target;
+}
+
+void futexTests() {
+  initTests("Futex Tests");
+
+  // Test 1: Two processes on any cores keep a counter exact through a
+  // futex mutex
+  static volatile MutexControl mutex;
+  mutex.lock = 0;
+  mutex.counter = 0;
+  mutex.iterations = FUTEX_TEST_ITERATIONS;
+  mutex.done = 0;
+  bool started = run_user_program(MUTEX_PROGRAM, user_address(&mutex.lock), 0) &&
+                 run_user_program(MUTEX_PROGRAM, user_address(&mutex.lock), 0);
+  bool finished = started && wait_for_value(&mutex.done, 2);
+  printf(" Futex Mutex Counter: %lu of %lu\n", mutex.counter,
+         2 * FUTEX_TEST_ITERATIONS);
+  testsResult("Futex Mutex Excludes",
+              finished && mutex.counter == 2 * FUTEX_TEST_ITERATIONS && mutex.lock == 0);
+
+  // Test 2: A wait on a changed word returns at once, and a wait nobody wakes
+  // times out
+  constexpr uint64_t UNSET = ~0ull;
+  static volatile FutexErrorsControl errors;
+  errors.word = 0;
+  errors.would_block = UNSET;
+  errors.timed_out = UNSET;
+  started = run_user_program(FUTEX_ERRORS_PROGRAM, user_address(&errors.word), 0);
+  uint64_t until = GenericTimer::now() + GenericTimer::ns_to_counter(FUTEX_TEST_TIMEOUT_NS);
+  while (started && errors.timed_out == UNSET && GenericTimer::now() < until);
+  testsResult("Futex Wait Would Block", errors.would_block == Syscall::WOULD_BLOCK);
+  testsResult("Futex Wait Times Out", errors.timed_out == Syscall::TIMED_OUT);
+}
+
+#endif  // FUTEX_TESTS_H
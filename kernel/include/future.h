@@ -1,36 +1,251 @@
 #ifndef _FUTURE_H_
 #define _FUTURE_H_
 
-#include "semaphore.h"
+#include "atomics.h"
+#include "event_loop.h"
 #include "stdint.h"
+#include "task.h"
+#include "utility.h"
+#include "wait_queue.h"
 
+/**
+ * @brief A value set once and then read by any number of contexts
+ *
+ * get() blocks until the value is set, and set() wakes every blocked getter
+ * at once. A continuation added with then() or on_set() does not block
+ * anything: it is scheduled as an event with a copy of the value once the
+ * value is set, so asynchronous steps chain without a waiting context in
+ * between.
+ *
+ * Continuations get their own copy of the value, so the future may be deleted
+ * once nothing calls get() on it any more, even with continuations pending.
+ */
 template <typename T>
 class Future {
-    Semaphore sem;
-    bool volatile is_ready;
-    T volatile t;
+    // Queued until the value is set, then run once as an event and deleted
+    struct Continuation : public Event {
+        Continuation* next = nullptr;
+        T value;
+    };
+
+    template <typename Work>
+    struct ContinuationWith : public Continuation {
+        Work const work;
+
+        explicit ContinuationWith(Work const work) : Continuation(), work(work) {}
+
+        virtual void run() override {
+            work(this->value);
+            delete this;
+        }
+    };
+
+    WaitQueue waiters;  // Its lock also guards the fields below
+    bool is_ready;
+    T t;
+    Continuation* continuations = nullptr;
+
+    static void schedule(Continuation* continuation, const T& value) {
+        continuation->value = value;
+        enqueue_event(continuation, Priority::Normal);
+    }
+
+    bool ready() const { return __atomic_load_n(&is_ready, __ATOMIC_ACQUIRE); }
+
 public:
-    Future() : sem(0), is_ready(false), t() {}
+    Future() : is_ready(false), t() {}
+
+    // Continuations still waiting are dropped without running
+    ~Future() {
+        while (continuations != nullptr) {
+            Continuation* next = continuations->next;
+            delete continuations;
+            continuations = next;
+        }
+    }
 
     Future(const Future&) = delete;
     Future& operator=(const Future& rhs) = delete;
     Future& operator=(Future&& rhs) = delete;
 
+    // Sets the value unless it was set before
     void set(T val) {
-        if (!is_ready) {
-            t = val;
-            is_ready = true;
-            sem.up();
+        waiters.lock();
+        if (is_ready) {
+            waiters.unlock();
+            return;
+        }
+        t = val;
+        __atomic_store_n(&is_ready, true, __ATOMIC_RELEASE);
+        Waiter* blocked = waiters.take_all();
+        Continuation* pending = continuations;
+        continuations = nullptr;
+        waiters.unlock();
+
+        // The future may be gone once a getter is woken, so only val and the
+        // detached lists are used from here on
+        WaitQueue::wake_all(blocked);
+        while (pending != nullptr) {
+            Continuation* next = pending->next;
+            schedule(pending, val);
+            pending = next;
         }
     }
 
+    // Whether the value is set, which may change right after
+    bool is_set() const { return ready(); }
+
     T get() {
-        if (!is_ready) {
-            sem.down();
-            sem.up();
+        if (!ready()) {
+            waiters.lock();
+            if (is_ready) {
+                waiters.unlock();
+            } else {
+                Waiter waiter;
+                waiters.park(&waiter);
+            }
         }
         return t;
     }
+
+    // co_await form of waiting for the value, for coroutines
+    struct ReadyAwaiter {
+        Future* future;
+        Waiter waiter;
+
+        bool await_ready() { return future->ready(); }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            // Once queued the frame holding this awaiter may be resumed by
+            // another core, so nothing in it is touched after
+            Future* f = future;
+            f->waiters.lock();
+            if (f->is_ready) {
+                f->waiters.unlock();
+                return false;
+            }
+            waiter.continuation = resume_event(handle);
+            f->waiters.append(&waiter);
+            f->waiters.unlock();
+            return true;
+        }
+
+        void await_resume() {}
+    };
+
+    // co_await form of get() for coroutines
+    Task<T> get_async() {
+        co_await ReadyAwaiter{this, {}};
+        co_return t;
+    }
+
+    /**
+     * @brief Runs fn(value) as an event once the value is set, right away if
+     * it already is
+     */
+    template <typename Fn>
+    void on_set(Fn fn) {
+        Continuation* continuation = new ContinuationWith<Fn>(fn);
+        waiters.lock();
+        if (is_ready) {
+            waiters.unlock();
+            schedule(continuation, t);
+            return;
+        }
+        continuation->next = continuations;
+        continuations = continuation;
+        waiters.unlock();
+    }
+
+    /**
+     * @brief Chains fn after this future
+     *
+     * @return  a new future, owned by the caller, that is set to fn(value)
+     *          by the event that runs fn
+     */
+    template <typename Fn>
+    auto then(Fn fn) {
+        using R = decltype(fn(std::declval<const T&>()));
+        Future<R>* next = new Future<R>();
+        on_set([fn, next](const T& value) { next->set(fn(value)); });
+        return next;
+    }
 };
 
-#endif
\ No newline at end of file
+/**
+ * @brief Returns a new future, owned by the caller, that is set to true once
+ * all n futures are set. Their values are read from them after that.
+ */
+template <typename T>
+Future<bool>* when_all(Future<T>* const* futures, size_t n) {
+    struct State {
+        Atomic<size_t> left;
+        Future<bool>* all;
+
+        State(size_t left, Future<bool>* all) : left(left), all(all) {}
+    };
+
+    Future<bool>* all = new Future<bool>();
+    if (n == 0) {
+        all->set(true);
+        return all;
+    }
+    State* state = new State(n, all);
+    for (size_t i = 0; i < n; i++) {
+        futures[i]->on_set([state](const T&) {
+            if (state->left.add_fetch(-1) == 0) {
+                state->all->set(true);
+                delete state;
+            }
+        });
+    }
+    return all;
+}
+
+/**
+ * @brief Returns a new future, owned by the caller, that is set to the index
+ * of the first of the n futures to be set, or to 0 right away when n is 0.
+ * Futures that are never set only hold on to a little shared state, which is
+ * freed once every one of them is either set or deleted.
+ */
+template <typename T>
+Future<size_t>* when_any(Future<T>* const* futures, size_t n) {
+    struct State {
+        Atomic<size_t> fired;  // Continuations that have run
+        Atomic<size_t> refs;   // Refs to this state, run or not
+        Future<size_t>* first;
+
+        explicit State(Future<size_t>* first) : fired(0), refs(0), first(first) {}
+    };
+
+    // Held by every continuation, so the state goes with the last of them
+    // whether it ran or was deleted with a future that was never set
+    struct Ref {
+        State* state;
+
+        explicit Ref(State* state) : state(state) { state->refs.add_fetch(1); }
+        Ref(const Ref& other) : state(other.state) { state->refs.add_fetch(1); }
+        Ref& operator=(const Ref&) = delete;
+        ~Ref() {
+            if (state->refs.add_fetch(-1) == 0) delete state;
+        }
+    };
+
+    Future<size_t>* first = new Future<size_t>();
+    if (n == 0) {
+        first->set(0);
+        return first;
+    }
+
+    Ref ref(new State(first));
+    for (size_t i = 0; i < n; i++) {
+        futures[i]->on_set([ref, i](const T&) {
+            // Only the first continuation touches first, which the caller may
+            // have deleted by the time the others run
+            if (ref.state->fired.add_fetch(1) == 1) ref.state->first->set(i);
+        });
+    }
+    return first;
+}
+
+#endif
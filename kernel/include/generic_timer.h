@@ -0,0 +1,78 @@
+// Citations
+// https://developer.arm.com/documentation/102379/0104/The-processor-timers
+// https://datasheets.raspberrypi.com/bcm2836/bcm2836-peripherals.pdf (QA7)
+
+#ifndef GENERIC_TIMER_H
+#define GENERIC_TIMER_H
+
+#include "stdint.h"
+
+/**
+ * @brief Per-core ARM generic timer (CNTP_*) driving the kernel tick
+ */
+namespace GenericTimer {
+// Kernel tick rate
+constexpr uint64_t TICK_HZ = 1000;
+constexpr uint64_t NS_PER_TICK = 1000000000 / TICK_HZ;
+
+// Time an event or process may run before it can be preempted
+constexpr uint64_t DEFAULT_QUANTUM_NS = 10000000;
+
+/**
+ * @brief Routes this core's physical timer interrupt to it and starts the
+ * periodic tick. Must be called once on every core.
+ */
+void init_core();
+
+/**
+ * @brief Checks whether this core's timer fired and, if so, arms the next
+ * tick
+ *
+ * @return true   the timer interrupt was pending and has been handled
+ */
+bool check_interrupt();
+
+/**
+ * @brief Sets the scheduling quantum for every core, rounded up to whole
+ * ticks
+ */
+void set_quantum(uint64_t ns);
+
+/**
+ * @brief Starts a new quantum on this core. Called whenever the event loop
+ * hands the core to something new.
+ */
+void start_quantum();
+
+/**
+ * @brief Charges one tick to the running quantum. Called on every tick.
+ *
+ * @return true   the quantum is used up and the running work should be
+ *                preempted
+ */
+bool quantum_expired();
+
+/**
+ * @brief Stops this core's tick so an idle core takes no timer interrupts.
+ * Must only be called while the core's timer wheel is empty.
+ */
+void stop_tick();
+
+/**
+ * @brief Restarts this core's tick if it was stopped
+ */
+void start_tick();
+
+/**
+ * @brief Current value of the system counter
+ */
+uint64_t now();
+
+/**
+ * @brief Converts between nanoseconds and system counter ticks
+ */
+uint64_t ns_to_counter(uint64_t ns);
+uint64_t counter_to_ns(uint64_t counter);
+}  // namespace GenericTimer
+
+#endif  // GENERIC_TIMER_H
@@ -4,6 +4,10 @@
 #include "atomics.h"
 #include "stdint.h"
 
+// Shared by the locks of every HashMap, whatever its types
+inline LockStats::Site hashmap_bucket_lock_site{"hashmap bucket"};
+inline LockStats::Site hashmap_resize_lock_site{"hashmap resize"};
+
 // Reference: https://stackoverflow.com/a/12996028
 struct DefaultIntegerHash {
   uint64_t operator()(uint64_t x) const {
@@ -24,7 +28,8 @@ struct DefaultIntegerHash {
  *  - Bucket array
  *  - Singly linked list per bucket
  *  - RWLock per bucket to allow multiple readers or single writer, per bucket
- *  - Global RWLock for resizing
+ *  - Global BigReaderLock for resizing, so that the read lock every operation
+ *    takes stays in the core's own cache line
  */
 template <typename K, typename V, typename Hash = DefaultIntegerHash>
 class HashMap {
@@ -89,7 +94,7 @@ class HashMap {
     RWLock mutable lock;
     Node* head;
 
-    Bucket() : head(nullptr) {}
+    Bucket() : lock(hashmap_bucket_lock_site), head(nullptr) {}
 
     ~Bucket() {
       Node* cur = head;
@@ -117,7 +122,7 @@ class HashMap {
   Atomic<size_t> num_entries;    // Number of key-value pairs
   double const max_load_factor;  // Max load factor
   Hash hash;                     // Hash functor
-  RWLock mutable global_lock;    // Global lock for resizing
+  BigReaderLock mutable global_lock;  // Global lock for resizing
 };
 
 ////////////////////
@@ -129,7 +134,8 @@ HashMap<K, V, Hash>::HashMap(int num_buckets, double max_load_factor,
     : num_buckets(num_buckets),
       num_entries(0),
       max_load_factor(max_load_factor),
-      hash(hash) {
+      hash(hash),
+      global_lock(hashmap_resize_lock_site) {
   buckets = new Bucket[num_buckets];
 }
 
@@ -145,7 +151,7 @@ void HashMap<K, V, Hash>::resize() {
 
   size_t new_num_buckets;
   double const load_factor =
-      static_cast<double>(num_entries.load()) / num_buckets;
+      static_cast<double>(num_entries.load<__ATOMIC_RELAXED>()) / num_buckets;
 
   // Expand or shrink as necessary
   if (load_factor > max_load_factor) {
@@ -231,14 +237,15 @@ bool HashMap<K, V, Hash>::insert_or_assign(K const& key, V const& value) {
 
   // Atomically increment num_entries
   // Done before exiting global shared section, to ensure resize() always sees
-  // the latest num_entries value
-  num_entries.add_fetch(1);
+  // the latest num_entries value. The release of read_unlock() and the acquire
+  // of write_lock() order it, so the count itself can be relaxed.
+  num_entries.add_fetch<__ATOMIC_RELAXED>(1);
 
   // Exit global shared section
   global_lock.read_unlock();
 
   // Resize if load factor exceeds max_load_factor
-  if (static_cast<double>(num_entries.load()) / num_buckets > max_load_factor) {
+  if (static_cast<double>(num_entries.load<__ATOMIC_RELAXED>()) / num_buckets > max_load_factor) {
     resize();
   }
 
@@ -306,13 +313,13 @@ bool HashMap<K, V, Hash>::erase(K const& key) {
 
       // Remove key-value pair
       delete cur;
-      num_entries.add_fetch(-1);
+      num_entries.add_fetch<__ATOMIC_RELAXED>(-1);
 
       // Exit global shared section
       global_lock.read_unlock();
 
       // Resize if load factor falls below max_load_factor / 4
-      if (static_cast<double>(num_entries.load()) / num_buckets <
+      if (static_cast<double>(num_entries.load<__ATOMIC_RELAXED>()) / num_buckets <
           max_load_factor / 4) {
         resize();
       }
@@ -333,7 +340,7 @@ bool HashMap<K, V, Hash>::erase(K const& key) {
 
 template <typename K, typename V, typename Hash>
 size_t HashMap<K, V, Hash>::size() const {
-  return num_entries.load();
+  return num_entries.load<__ATOMIC_RELAXED>();
 }
 
 #endif  // HASHMAP_H
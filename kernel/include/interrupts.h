@@ -4,6 +4,7 @@
 #ifndef INTERRUPTS_H
 #define INTERRUPTS_H
 
+#include "machine.h"
 #include "stdint.h"
 
 class Interrupts {
@@ -33,4 +34,28 @@ class Interrupts {
   static void Disable_All_Base(uint8_t Offset);
 };
 
+// Word offsets into the frame the exception vectors save on entry (see
+// interrupt_handler.s): x0-x30 come first, then where the exception returns
+// to. Later exceptions overwrite ELR_EL1 and SPSR_EL1, so handlers read them
+// from here.
+namespace ExceptionFrame {
+constexpr int ELR = 31;
+constexpr int SPSR = 32;
+}  // namespace ExceptionFrame
+
+/**
+ * @brief Masks interrupts on the current core for the lifetime of the guard
+ * and restores the previous mask when it goes out of scope
+ */
+class InterruptGuard {
+  uint64_t saved_daif;
+
+ public:
+  InterruptGuard() : saved_daif(get_DAIF()) { set_DAIFSet_all(); }
+
+  InterruptGuard(const InterruptGuard&) = delete;
+
+  ~InterruptGuard() { set_DAIF(saved_daif); }
+};
+
 #endif // INTERRUPTS_H
\ No newline at end of file
@@ -4,8 +4,8 @@
 #include "message_queue.h"
 
 namespace IPC_MSG {
-    void send(int sender, int receiver, MessageType type, void* payload) {
-        sendMessage(sender, receiver, type, payload);
+    bool send(int sender, int receiver, MessageType type, void* payload) {
+        return sendMessage(sender, receiver, type, payload);
     }
     bool recv(int receiver, Message& msg) {
         return receiveMessage(receiver, msg);
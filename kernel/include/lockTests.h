@@ -0,0 +1,282 @@
+#ifndef LOCK_TESTS_H
+#define LOCK_TESTS_H
+
+#include "atomics.h"
+#include "cores.h"
+#include "event_loop.h"
+#include "generic_timer.h"
+#include "lock_stats.h"
+#include "printf.h"
+#include "seqlock.h"
+#include "testFramework.h"
+
+constexpr uint64_t LOCK_BENCHMARK_ITERATIONS = 10000;
+
+template <typename Lock>
+struct LockBenchmark {
+  Lock lock;
+  volatile uint64_t counter = 0;  // Only changed while holding lock
+};
+
+// Increments a counter under the lock LOCK_BENCHMARK_ITERATIONS times on each
+// of cores cores, returning the average nanoseconds per acquisition, or 0 if
+// the counter came out wrong or the run did not finish
+template <typename Lock>
+uint64_t run_lock_benchmark(int cores) {
+  LockBenchmark<Lock>* bench = new LockBenchmark<Lock>();
+  uint64_t elapsed = run_on_cores(cores, [bench](int) {
+    for (uint64_t i = 0; i < LOCK_BENCHMARK_ITERATIONS; i++) {
+      LockGuard<Lock> guard(bench->lock);
+      bench->counter = bench->counter + 1;
+    }
+  });
+
+  // Left allocated if a worker may still be using it
+  if (elapsed == 0) return 0;
+  bool exact = bench->counter == cores * LOCK_BENCHMARK_ITERATIONS;
+  delete bench;
+  if (!exact) return 0;
+  return GenericTimer::counter_to_ns(elapsed) / (cores * LOCK_BENCHMARK_ITERATIONS);
+}
+
+struct NestingBenchmark {
+  McsLock outer;
+  McsLock inner;
+  volatile uint64_t counter = 0;  // Only changed while holding inner
+};
+
+// Takes two McsLocks nested on every core, releasing them both out of order
+// and in order, and increments a counter under inner each time. Returns
+// false if the counter came out wrong or the run did not finish. The per-core
+// node pool is far smaller than the number of acquisitions, so a node that
+// is not given back fails the pool's ASSERT.
+bool run_nesting_benchmark() {
+  NestingBenchmark* bench = new NestingBenchmark();
+  uint64_t elapsed = run_on_cores(NUM_CORES, [bench](int) {
+    for (uint64_t i = 0; i < LOCK_BENCHMARK_ITERATIONS; i++) {
+      // Released out of order
+      bench->outer.lock();
+      bench->inner.lock();
+      bench->outer.unlock();
+      bench->counter = bench->counter + 1;
+      bench->inner.unlock();
+
+      // Released in order
+      bench->outer.lock();
+      bench->inner.lock();
+      bench->counter = bench->counter + 1;
+      bench->inner.unlock();
+      bench->outer.unlock();
+    }
+  });
+
+  if (elapsed == 0) return false;
+  bool exact = bench->counter == 2 * NUM_CORES * LOCK_BENCHMARK_ITERATIONS;
+  delete bench;
+  return exact;
+}
+
+// Prints the cost of an acquisition with 1 to NUM_CORES cores contending,
+// returning false if any run failed
+template <typename Lock>
+bool lock_contention_benchmark(const char* name) {
+  bool exact = true;
+  printf(" %s ns per Acquisition (1-%d Cores):", name, NUM_CORES);
+  for (int cores = 1; cores <= NUM_CORES; cores++) {
+    uint64_t ns = run_lock_benchmark<Lock>(cores);
+    printf(" %lu", ns);
+    exact = exact && ns != 0;
+  }
+  printf("\n");
+  return exact;
+}
+
+// Every field holds the same number, so a torn read shows
+struct ReadSample {
+  uint64_t fields[4];
+
+  bool consistent() const {
+    return fields[0] == fields[1] && fields[1] == fields[2] && fields[2] == fields[3];
+  }
+};
+
+struct SeqLockSample {
+  SeqLock<ReadSample> lock;
+
+  ReadSample read() { return lock.read(); }
+  void write(const ReadSample& sample) { lock.write(sample); }
+};
+
+struct RWLockSample {
+  RWLock lock;
+  ReadSample value{};
+
+  ReadSample read() {
+    lock.read_lock();
+    ReadSample copy = value;
+    lock.read_unlock();
+    return copy;
+  }
+
+  void write(const ReadSample& sample) {
+    lock.write_lock();
+    value = sample;
+    lock.write_unlock();
+  }
+};
+
+constexpr uint64_t READ_BENCHMARK_READS = 20000;
+constexpr uint64_t READ_BENCHMARK_WRITE_EVERY = 100;
+
+template <typename Sample>
+struct ReadBenchmark {
+  Sample sample;
+  Atomic<uint64_t> torn;
+};
+
+// Reads the sample READ_BENCHMARK_READS times on every core, while core 0
+// replaces it every READ_BENCHMARK_WRITE_EVERY reads. Returns the average
+// nanoseconds per read, or 0 if a read came out torn or the run did not
+// finish.
+template <typename Sample>
+uint64_t run_read_benchmark() {
+  ReadBenchmark<Sample>* bench = new ReadBenchmark<Sample>();
+  uint64_t elapsed = run_on_cores(NUM_CORES, [bench](int index) {
+    uint64_t torn = 0;
+    for (uint64_t i = 1; i <= READ_BENCHMARK_READS; i++) {
+      if (index == 0 && i % READ_BENCHMARK_WRITE_EVERY == 0) {
+        bench->sample.write(ReadSample{{i, i, i, i}});
+      } else if (!bench->sample.read().consistent()) {
+        torn++;
+      }
+    }
+    bench->torn.add_fetch(torn);
+  });
+
+  if (elapsed == 0) return 0;
+  bool consistent = bench->torn.load() == 0;
+  delete bench;
+  if (!consistent) return 0;
+  return GenericTimer::counter_to_ns(elapsed) / READ_BENCHMARK_READS;
+}
+
+template <typename Lock>
+struct WriterBenchmark {
+  Lock lock;
+  volatile uint64_t stop = 0;
+  uint64_t wait = 0;  // Counter ticks the writer waited for the lock
+};
+
+// Keeps every other core read locking the lock back to back while core 0
+// takes the write lock, returning how many nanoseconds that took, or 0 if the
+// run did not finish
+template <typename Lock>
+uint64_t run_writer_benchmark() {
+  WriterBenchmark<Lock>* bench = new WriterBenchmark<Lock>();
+  uint64_t elapsed = run_on_cores(NUM_CORES, [bench](int index) {
+    if (index != 0) {
+      while (!bench->stop) {
+        bench->lock.read_lock();
+        bench->lock.read_unlock();
+      }
+      return;
+    }
+
+    uint64_t start = GenericTimer::now();
+    bench->lock.write_lock();
+    bench->wait = GenericTimer::now() - start;
+    bench->lock.write_unlock();
+    bench->stop = 1;
+  });
+
+  if (elapsed == 0) return 0;
+  uint64_t wait_ns = GenericTimer::counter_to_ns(bench->wait);
+  delete bench;
+  return wait_ns == 0 ? 1 : wait_ns;
+}
+
+// One counter per core, each on its own cache line, and one they share
+struct OrderBenchmark {
+  struct alignas(CACHE_LINE_SIZE) Slot {
+    Atomic<uint64_t> count;
+    char pad[CACHE_LINE_SIZE - sizeof(Atomic<uint64_t>)];
+  };
+  Slot own[NUM_CORES];
+  Atomic<uint64_t> shared;
+};
+
+// Adds to a counter with the given memory order LOCK_BENCHMARK_ITERATIONS
+// times on every core, each its own counter unless shared, returning the
+// average nanoseconds per add, or 0 if a count came out wrong
+template <int Order>
+uint64_t run_order_benchmark(bool shared) {
+  OrderBenchmark* bench = new OrderBenchmark();
+  uint64_t elapsed = run_on_cores(NUM_CORES, [bench, shared](int index) {
+    Atomic<uint64_t>& counter = shared ? bench->shared : bench->own[index].count;
+    for (uint64_t i = 0; i < LOCK_BENCHMARK_ITERATIONS; i++) {
+      counter.fetch_add<Order>(1);
+    }
+  });
+
+  if (elapsed == 0) return 0;
+  bool exact = true;
+  if (shared) {
+    exact = bench->shared.load() == NUM_CORES * LOCK_BENCHMARK_ITERATIONS;
+  } else {
+    for (int core = 0; core < NUM_CORES; core++) {
+      exact = exact && bench->own[core].count.load() == LOCK_BENCHMARK_ITERATIONS;
+    }
+  }
+  delete bench;
+  if (!exact) return 0;
+  return GenericTimer::counter_to_ns(elapsed) / (NUM_CORES * LOCK_BENCHMARK_ITERATIONS);
+}
+
+void lockTests() {
+  initTests("Lock Tests");
+
+  // Test 1: The test-and-set SpinLock, for comparison
+  testsResult("SpinLock Excludes", lock_contention_benchmark<SpinLock>("SpinLock"));
+
+  // Test 2: Ticket lock under contention
+  testsResult("TicketLock Excludes", lock_contention_benchmark<TicketLock>("TicketLock"));
+
+  // Test 3: MCS lock under contention
+  testsResult("McsLock Excludes", lock_contention_benchmark<McsLock>("McsLock"));
+
+  // Test 4: McsLocks nest, and may be released out of order
+  testsResult("McsLock Nesting", run_nesting_benchmark());
+
+  // Test 5: Readers on every core against an occasional writer
+  uint64_t seqlock_ns = run_read_benchmark<SeqLockSample>();
+  uint64_t rwlock_ns = run_read_benchmark<RWLockSample>();
+  printf(" Read-Mostly ns per Read on %d Cores: SeqLock %lu, RWLock %lu\n",
+         NUM_CORES, seqlock_ns, rwlock_ns);
+  testsResult("SeqLock Reads Consistent", seqlock_ns != 0);
+  testsResult("RWLock Reads Consistent", rwlock_ns != 0);
+
+  // Test 6: A writer gets in while readers keep coming on every other core
+  uint64_t rwlock_wait_ns = run_writer_benchmark<RWLock>();
+  uint64_t big_reader_wait_ns = run_writer_benchmark<BigReaderLock>();
+  printf(" Writer Wait Under Readers: RWLock %lu ns, BigReaderLock %lu ns\n",
+         rwlock_wait_ns, big_reader_wait_ns);
+  testsResult("RWLock Writer Not Starved", rwlock_wait_ns != 0);
+  testsResult("BigReaderLock Writer Not Starved", big_reader_wait_ns != 0);
+
+  // Test 7: What a memory order costs an atomic add, alone and on one line
+  uint64_t own_seq_cst_ns = run_order_benchmark<__ATOMIC_SEQ_CST>(false);
+  uint64_t own_relaxed_ns = run_order_benchmark<__ATOMIC_RELAXED>(false);
+  uint64_t shared_seq_cst_ns = run_order_benchmark<__ATOMIC_SEQ_CST>(true);
+  uint64_t shared_relaxed_ns = run_order_benchmark<__ATOMIC_RELAXED>(true);
+  printf(" fetch_add ns on %d Cores: Own Counter seq_cst %lu, relaxed %lu;"
+         " Shared Counter seq_cst %lu, relaxed %lu\n",
+         NUM_CORES, own_seq_cst_ns, own_relaxed_ns, shared_seq_cst_ns, shared_relaxed_ns);
+  testsResult("Atomic Adds Exact Under Any Order",
+              own_seq_cst_ns != 0 && own_relaxed_ns != 0 && shared_seq_cst_ns != 0 &&
+                  shared_relaxed_ns != 0);
+
+  // The named kernel locks, after everything above took them
+  LockStats::dump();
+}
+
+#endif  // LOCK_TESTS_H
@@ -0,0 +1,123 @@
+// Citations
+// https://www.kernel.org/doc/html/latest/locking/lockstat.html
+
+#ifndef LOCK_STATS_H
+#define LOCK_STATS_H
+
+#include "machine.h"
+#include "stdint.h"
+
+#if defined(LOCK_STATS_ENABLED) && (LOCK_STATS_ENABLED + 0)
+#define LOCK_STATS 1
+#else
+#define LOCK_STATS 0
+#endif
+
+/**
+ * @brief Contention counters for the kernel's spin locks
+ *
+ * Compiled in with LOCK_STATS_ENABLED=1. A lock constructed with a Site
+ * counts its acquisitions into it, every lock of a kind sharing one site
+ * (every HashMap bucket, say). Locks constructed without one, and every lock
+ * when statistics are compiled out, carry an empty Probe that costs nothing.
+ *
+ * A site joins the list that dump() walks the first time one of its locks is
+ * taken, so sites need no constructor to run and can name locks used before
+ * the heap is up. Counters are updated with relaxed atomics from every core
+ * and may be a few acquisitions out of date when read.
+ *
+ * All durations are in generic timer ticks.
+ */
+namespace LockStats {
+constexpr bool ENABLED = LOCK_STATS;
+
+#if LOCK_STATS
+struct Site {
+  const char* const name;
+  uint64_t acquisitions = 0;
+  uint64_t contended = 0;       // Acquisitions that found the lock taken
+  uint64_t wait_ticks = 0;      // Spent waiting by contended acquisitions
+  uint64_t max_hold_ticks = 0;  // Longest exclusive hold
+  Site* next = nullptr;         // In the list of sites, once registered
+  uint32_t registered = 0;
+
+  constexpr explicit Site(const char* name) : name(name) {}
+};
+
+// Adds site to the list dump() walks, unless another core got there first
+void register_site(Site* site);
+
+inline uint64_t now() { return get_CNTPCT_EL0(); }
+
+/**
+ * @brief Records the acquisitions of one lock into its site
+ *
+ * Locks call now() before they start trying, then acquired() or
+ * shared_acquired() once they hold the lock, and released() while they still
+ * hold it exclusively.
+ */
+class Probe {
+  Site* site = nullptr;
+  uint64_t held_since = 0;  // Only meaningful while held exclusively
+
+  void count(uint64_t waiting_since, bool contended) {
+    if (!__atomic_load_n(&site->registered, __ATOMIC_ACQUIRE)) register_site(site);
+    __atomic_fetch_add(&site->acquisitions, 1, __ATOMIC_RELAXED);
+    if (contended) {
+      __atomic_fetch_add(&site->contended, 1, __ATOMIC_RELAXED);
+      __atomic_fetch_add(&site->wait_ticks, LockStats::now() - waiting_since, __ATOMIC_RELAXED);
+    }
+  }
+
+ public:
+  constexpr Probe() {}
+  constexpr explicit Probe(Site& site) : site(&site) {}
+
+  uint64_t now() const { return site != nullptr ? LockStats::now() : 0; }
+
+  void acquired(uint64_t waiting_since, bool contended) {
+    if (site == nullptr) return;
+    count(waiting_since, contended);
+    held_since = LockStats::now();
+  }
+
+  // Hold times are not tracked for shared holds, which overlap
+  void shared_acquired(uint64_t waiting_since, bool contended) {
+    if (site == nullptr) return;
+    count(waiting_since, contended);
+  }
+
+  void released() {
+    if (site == nullptr) return;
+    uint64_t held = LockStats::now() - held_since;
+    uint64_t max = __atomic_load_n(&site->max_hold_ticks, __ATOMIC_RELAXED);
+    while (held > max &&
+           !__atomic_compare_exchange_n(&site->max_hold_ticks, &max, held, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+  }
+};
+#else
+struct Site {
+  constexpr explicit Site(const char*) {}
+};
+
+class Probe {
+ public:
+  constexpr Probe() {}
+  constexpr explicit Probe(Site&) {}
+
+  uint64_t now() const { return 0; }
+  void acquired(uint64_t, bool) {}
+  void shared_acquired(uint64_t, bool) {}
+  void released() {}
+};
+#endif
+
+/**
+ * @brief Prints every site that was used, most contended first
+ */
+void dump();
+}  // namespace LockStats
+
+#endif  // LOCK_STATS_H
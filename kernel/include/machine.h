@@ -1,3 +1,6 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
 #include "stdint.h"
 
 extern "C" uint64_t get_CurrentEL();
@@ -13,6 +16,8 @@ extern "C" uint64_t get_FAR_EL1();
 extern "C" uint64_t get_CNTP_CTL_EL0();
 extern "C" uint64_t get_CNTP_CVAL_EL0();
 extern "C" uint64_t get_CNTP_TVAL_EL0();
+extern "C" uint64_t get_CNTPCT_EL0();
+extern "C" uint64_t get_CNTFRQ_EL0();
 
 extern "C" uint64_t get_SPSR_EL1();
 extern "C" uint64_t get_ELR_EL1();
@@ -20,6 +25,18 @@ extern "C" uint64_t get_SP_EL0();
 
 extern "C" void set_DAIFClr_all();  // clears (un‑masks) A,I,F
 extern "C" void set_DAIFSet_all();  // sets   (masks)  A,I,F
+extern "C" uint64_t get_DAIF();
+extern "C" void set_DAIF(uint64_t val);
+
+// FP/SIMD register file, laid out as save_fp_state expects
+struct FPState {
+  uint64_t fpcr;
+  uint64_t fpsr;
+  uint64_t q[64];
+};
+
+extern "C" void save_fp_state(FPState* state);
+extern "C" void restore_fp_state(FPState* state);
 
 extern "C" void set_TTBR0_EL1(uint64_t val);
 extern "C" void set_TTBR1_EL1(uint64_t val);
@@ -27,8 +44,10 @@ extern "C" void set_MAIR_EL1(uint64_t val);
 extern "C" void set_SCTLR_EL1(uint64_t val);
 extern "C" void set_TCR_EL1(uint64_t val);
 extern "C" void set_VBAR_EL1(void* val);
+extern "C" void set_CPACR_EL1(uint64_t val);
 
 extern "C" void tlb_invalidate_all();
+extern "C" uint64_t translate_user_read(uint64_t va);
 
 extern "C" void set_SPSR_EL1(uint64_t val);
 extern "C" void set_ELR_EL1(uint64_t val);
@@ -43,4 +62,6 @@ extern "C" void set_stack_pointer(uint8_t* val);
 
 extern "C" void exception_return();
 
-extern "C" void* el1_vector_table;
\ No newline at end of file
+extern "C" void* el1_vector_table;
+
+#endif  // MACHINE_H
@@ -2,14 +2,18 @@
 #define MESSAGE_QUEUE_H
 
 #include "message.h"
-#include "queue.h"
+#include "ring_queue.h"
 #include "atomics.h"
 
-extern LocklessQueue<Message>* messageQueue; // Pointer instead of object
+// Maximum number of undelivered messages
+constexpr size_t MESSAGE_QUEUE_CAPACITY = 256;
+
+extern RingQueue<Message>* messageQueue; // Pointer instead of object
 extern SpinLock lock;
 
 void init_message_queue(); // New initialization function
-void sendMessage(int sender, int receiver, MessageType type, void* payload);
+// Returns false, leaving the message unsent, if the queue is full
+bool sendMessage(int sender, int receiver, MessageType type, void* payload);
 bool receiveMessage(int receiver, Message& msg);
 
 #endif // MESSAGE_QUEUE_H
\ No newline at end of file
@@ -0,0 +1,136 @@
+// Citations
+// https://www.akkadia.org/drepper/futex.pdf (three state mutex)
+// https://sourceware.org/glibc/wiki/Mutex (adaptive spinning)
+
+#ifndef _MUTEX_H_
+#define _MUTEX_H_
+
+#include "atomics.h"
+#include "stdint.h"
+#include "task.h"
+#include "wait_queue.h"
+
+constexpr uint32_t MUTEX_MAX_SPINS = 1000;
+
+/**
+ * @brief Blocking mutex for critical sections too long to hold a spin lock
+ * across, such as device transfers
+ *
+ * state is 0 when unlocked, 1 when locked and 2 when locked with waiters
+ * queued, so lock() and unlock() are a single compare and swap unless some
+ * core has to wait. A contended lock() first spins for a while, as the holder
+ * is often about to let go, and adapts how long to the spins that recently
+ * paid off. Then it queues itself and parks, and unlock() hands the mutex
+ * straight to the first waiter.
+ *
+ * Threads park, coroutines use lock_async(), and plain events wait in wfe.
+ * The mutex has no owner, so it may be unlocked from another context than the
+ * one that locked it.
+ */
+class Mutex {
+    uint32_t state = 0;
+    uint32_t spins = 10;  // Average spins that won the lock, only a hint
+    WaitQueue waiters;
+
+    bool try_acquire(uint32_t from) {
+        return __atomic_compare_exchange_n(&state, &from, 1, false,
+                                           __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+    }
+
+    // Spins for up to twice the recent average, returning whether it won
+    bool spin() {
+        uint32_t average = __atomic_load_n(&spins, __ATOMIC_RELAXED);
+        uint32_t limit = average * 2 + 10;
+        if (limit > MUTEX_MAX_SPINS) limit = MUTEX_MAX_SPINS;
+
+        for (uint32_t i = 1; i <= limit; i++) {
+            asm volatile("yield");
+            if (__atomic_load_n(&state, __ATOMIC_RELAXED) == 0 && try_acquire(0)) {
+                __atomic_store_n(&spins, average + ((int32_t)(i - average)) / 8, __ATOMIC_RELAXED);
+                return true;
+            }
+        }
+        __atomic_store_n(&spins, average + ((int32_t)(limit - average)) / 8, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    // Marks the mutex contended, returning true if it was free after all, in
+    // which case the caller holds it. Expects waiters to be locked.
+    bool mark_contended() {
+        if (__atomic_exchange_n(&state, 2, __ATOMIC_ACQUIRE) != 0) return false;
+        __atomic_store_n(&state, waiters.empty() ? 1 : 2, __ATOMIC_RELAXED);
+        return true;
+    }
+
+public:
+    Mutex() {}
+
+    Mutex(const Mutex&) = delete;
+
+    bool try_lock() { return try_acquire(0); }
+
+    void lock() {
+        if (try_acquire(0) || spin()) return;
+
+        Waiter waiter;
+        waiters.lock();
+        if (mark_contended()) {
+            waiters.unlock();
+            return;
+        }
+        // unlock() handed the mutex over by the time this returns
+        waiters.park(&waiter);
+    }
+
+    // co_await form of lock() for coroutines, which skips spinning
+    struct LockAwaiter {
+        Mutex* mutex;
+        Waiter waiter;
+
+        bool await_ready() { return mutex->try_lock(); }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            // Once queued the frame holding this awaiter may be resumed and
+            // destroyed by another core, so nothing in it is touched after
+            Mutex* m = mutex;
+            m->waiters.lock();
+            if (m->mark_contended()) {
+                m->waiters.unlock();
+                return false;
+            }
+            waiter.continuation = resume_event(handle);
+            m->waiters.append(&waiter);
+            m->waiters.unlock();
+            return true;
+        }
+
+        void await_resume() {}
+    };
+
+    LockAwaiter lock_async() {
+        return LockAwaiter{this, {}};
+    }
+
+    void unlock() {
+        uint32_t locked = 1;
+        if (__atomic_compare_exchange_n(&state, &locked, 0, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return;
+        }
+
+        // Contended, so hand the mutex to the first waiter if there is one
+        waiters.lock();
+        Waiter* next = waiters.pop();
+        if (next == nullptr) {
+            __atomic_store_n(&state, 0, __ATOMIC_RELEASE);
+        } else {
+            __atomic_store_n(&state, waiters.empty() ? 1 : 2, __ATOMIC_RELAXED);
+        }
+        waiters.unlock();
+        if (next != nullptr) {
+            WaitQueue::wake(next);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,163 @@
+// Citations
+// https://www.intel.com/content/www/us/en/docs/onetbb/developer-guide-api-reference/2021-6/parallel-for.html
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "atomics.h"
+#include "definitions.h"
+#include "event_loop.h"
+#include "future.h"
+#include "queue.h"
+#include "stdint.h"
+
+namespace ParallelDetail {
+template <typename Fn>
+struct ForState {
+  Atomic<size_t> next;
+  size_t const end;
+  size_t const grain;
+  Fn const fn;
+  Atomic<size_t> chunks_left;  // Chunks not finished yet
+  Atomic<int> refs;            // Caller plus helper events
+  Future<bool> done;
+
+  ForState(size_t begin, size_t end, size_t grain, Fn fn, size_t chunks,
+           int refs)
+      : next(begin),
+        end(end),
+        grain(grain),
+        fn(fn),
+        chunks_left(chunks),
+        refs(refs),
+        done() {}
+
+  // Claims and runs chunks until none are left
+  void work() {
+    while (true) {
+      size_t lo = next.add_fetch(grain) - grain;
+      if (lo >= end) return;
+      size_t hi = end - lo > grain ? lo + grain : end;
+      fn(lo, hi);
+      if (chunks_left.add_fetch(-1) == 0) done.set(true);
+    }
+  }
+
+  void release() {
+    if (refs.add_fetch(-1) == 0) delete this;
+  }
+};
+}  // namespace ParallelDetail
+
+/**
+ * @brief Runs fn(lo, hi) over [begin, end) in chunks of grain indices, on up
+ * to max_cores cores at once
+ *
+ * Chunks start at begin + k * grain, so a grain that is a multiple of some
+ * alignment keeps chunks aligned to it. The calling core works through chunks
+ * alongside the helper events and only waits for chunks other cores are still
+ * running. Helpers that start after the work is gone return right away.
+ */
+template <typename Fn>
+void parallel_for(size_t begin, size_t end, size_t grain, Fn fn,
+                  int max_cores = NUM_CORES) {
+  if (begin >= end) return;
+  if (grain == 0) grain = 1;
+
+  size_t chunks = (end - begin + grain - 1) / grain;
+  int helpers = max_cores - 1;
+  if ((size_t)helpers > chunks - 1) helpers = chunks - 1;
+  if (helpers < 0) helpers = 0;
+
+  auto* state = new ParallelDetail::ForState<Fn>(begin, end, grain, fn,
+                                                 chunks, helpers + 1);
+  for (int i = 0; i < helpers; i++) {
+    schedule_event([state] {
+      state->work();
+      state->release();
+    });
+  }
+
+  state->work();
+  state->done.get();
+  state->release();
+}
+
+/**
+ * @brief Fork-join group of kernel tasks
+ *
+ * run() forks a task, wait() joins all of them. Each forked task is also
+ * offered to the event loop, but wait() runs any task no core has picked up
+ * yet on the calling core before waiting for the rest.
+ *
+ * All run() calls must happen before wait(), and wait() is called once.
+ */
+class TaskGroup {
+  struct State {
+    LocklessQueue<Event*> tasks;
+    Atomic<int> pending;  // Forked but not finished, plus 1 until wait()
+    Atomic<int> refs;     // Group plus helper events
+    Future<bool> done;
+
+    State() : tasks(), pending(1), refs(1), done() {}
+
+    // Drops one from pending, setting done once the group is closed and
+    // every task has finished
+    void finish_one() {
+      if (pending.add_fetch(-1) == 0) done.set(true);
+    }
+
+    // Runs one forked task if any is left
+    bool run_one() {
+      Event* task = tasks.dequeue();
+      if (task == nullptr) return false;
+      task->run();
+      delete task;
+      finish_one();
+      return true;
+    }
+
+    void release() {
+      if (refs.add_fetch(-1) == 0) delete this;
+    }
+  };
+
+  State* state;
+  bool joined;
+
+ public:
+  TaskGroup() : state(new State()), joined(false) {}
+
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  ~TaskGroup() {
+    if (!joined) wait();
+    state->release();
+  }
+
+  template <typename Work>
+  void run(Work work) {
+    state->pending.add_fetch(1);
+    state->refs.add_fetch(1);
+    state->tasks.enqueue(new EventWithWork<Work>(work));
+
+    State* shared = state;
+    schedule_event([shared] {
+      shared->run_one();
+      shared->release();
+    });
+  }
+
+  void wait() {
+    joined = true;
+    // No task can finish the group before it is closed here, however early
+    // the ones forked so far are done
+    state->finish_one();
+    while (state->run_one()) {
+    }
+    state->done.get();
+  }
+};
+
+#endif  // PARALLEL_H
@@ -0,0 +1,102 @@
+#ifndef PARALLEL_TESTS_H
+#define PARALLEL_TESTS_H
+
+#include "atomics.h"
+#include "machine.h"
+#include "parallel.h"
+#include "physmem.h"
+#include "printf.h"
+#include "testFramework.h"
+#include "vmm.h"
+
+constexpr size_t PARALLEL_BENCH_FRAMES = 256;  // 1 MiB
+
+void parallelTests() {
+  initTests("Parallel Tests");
+
+  // Test 1: Every index is visited exactly once
+  constexpr size_t N = 1000;
+  uint8_t* visits = new uint8_t[N];
+  for (size_t i = 0; i < N; i++) visits[i] = 0;
+
+  parallel_for(0, N, 7, [visits](size_t lo, size_t hi) {
+    for (size_t i = lo; i < hi; i++) visits[i]++;
+  });
+
+  bool once = true;
+  for (size_t i = 0; i < N; i++) once = once && visits[i] == 1;
+  testsResult("parallel_for visits every index once", once);
+  delete[] visits;
+
+  // Test 2: Chunks start at multiples of the grain
+  Atomic<int> misaligned(0);
+  parallel_for(0x1000, 0x9000, 0x1000, [&misaligned](size_t lo, size_t hi) {
+    if (lo % 0x1000 != 0 || hi - lo != 0x1000) misaligned.add_fetch(1);
+  });
+  testsResult("parallel_for chunks follow the grain", misaligned.load() == 0);
+
+  // Test 3: Fork-join runs every forked task before wait returns
+  Atomic<int> ran(0);
+  {
+    TaskGroup group;
+    for (int i = 0; i < 20; i++) {
+      group.run([&ran] { ran.add_fetch(1); });
+    }
+    group.wait();
+    testsResult("TaskGroup joins all tasks", ran.load() == 20);
+  }
+
+  // Test 4: A task finishing before the next run() does not end the group
+  {
+    Atomic<int> first(0);
+    Atomic<int> second(0);
+    TaskGroup group;
+    group.run([&first] { first.store(1); });
+    uint64_t until = get_CNTPCT_EL0() + get_CNTFRQ_EL0() / 10;
+    while (first.load() == 0 && get_CNTPCT_EL0() < until) {
+    }
+    group.run([&second] {
+      uint64_t busy_until = get_CNTPCT_EL0() + get_CNTFRQ_EL0() / 1000;
+      while (get_CNTPCT_EL0() < busy_until) {
+      }
+      second.store(1);
+    });
+    group.wait();
+    testsResult("TaskGroup waits for tasks forked late", second.load() == 1);
+  }
+
+  // Test 5: Forked tasks can fan out again
+  Atomic<uint64_t> sum(0);
+  {
+    TaskGroup group;
+    for (int t = 0; t < 4; t++) {
+      group.run([&sum, t] {
+        parallel_for(t * 100, (t + 1) * 100, 10, [&sum](size_t lo, size_t hi) {
+          uint64_t local = 0;
+          for (size_t i = lo; i < hi; i++) local += i;
+          sum.add_fetch(local);
+        });
+      });
+    }
+  }
+  testsResult("Nested parallel_for inside TaskGroup", sum.load() == 399 * 400 / 2);
+
+  // Benchmark: zeroing 1 MiB on 1-4 cores
+  uint64_t* region = (uint64_t*)VMM::phys_to_kernel_ptr(
+      PhysMem::allocate_frames(PARALLEL_BENCH_FRAMES));
+  size_t words = PARALLEL_BENCH_FRAMES * PAGE_SIZE / sizeof(uint64_t);
+  for (int cores = 1; cores <= 4; cores++) {
+    uint64_t start = get_CNTPCT_EL0();
+    parallel_for(0, words, PAGE_SIZE / sizeof(uint64_t),
+                 [region](size_t lo, size_t hi) {
+                   for (size_t i = lo; i < hi; i++) region[i] = 0;
+                 },
+                 cores);
+    uint64_t ticks = get_CNTPCT_EL0() - start;
+    printf(" %d cores:", cores);
+    benchResult("parallel_for zero 1 MiB", words * sizeof(uint64_t), ticks);
+  }
+  PhysMem::free_frames(VMM::kernel_to_phys_ptr(region), PARALLEL_BENCH_FRAMES);
+}
+
+#endif  // PARALLEL_TESTS_H
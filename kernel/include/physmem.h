@@ -8,6 +8,10 @@
 namespace PhysMem {
     void* allocate_frame();
     void free_frame(void* page); 
+
+    // Physically contiguous run of count frames
+    void* allocate_frames(size_t count);
+    void free_frames(void* first_page, size_t count);
     void page_init();
 }
 void run_page_tests();
@@ -0,0 +1,72 @@
+// Citations
+// https://www.kernel.org/doc/html/latest/locking/preempt-locking.html
+
+#ifndef PREEMPT_H
+#define PREEMPT_H
+
+#include "stdint.h"
+
+/**
+ * @brief Preemption of kernel events running at EL1
+ *
+ * Every core keeps a preempt count. Code outside of an event (boot, the event
+ * loop itself) runs with a count of 1, and the event loop drops it to 0 while
+ * an event runs. A timer interrupt that lands in an event with a count of 0
+ * parks the event: its register state stays on its kernel stack, the core
+ * switches to a spare stack and goes back to the event loop, and a resume
+ * event is queued that picks the parked event up again, possibly on another
+ * core.
+ *
+ * Anything that must not be split across cores or interleaved with other
+ * events on the same core (spin locks, per-core data, lock-free sections
+ * protected by Reclaim) has to run with preemption disabled.
+ */
+namespace Preempt {
+/**
+ * @brief Increments the current core's preempt count
+ */
+void disable();
+
+/**
+ * @brief Decrements the current core's preempt count
+ */
+void enable();
+
+/**
+ * @brief Sets the current core's preempt count back to 1. Called by the event
+ * loop, which can be entered from the middle of an event.
+ */
+void reset();
+
+/**
+ * @brief Top of the kernel stack the given core is running on
+ */
+uint8_t* stack_top(uint8_t core);
+
+/**
+ * @brief Parks the interrupted kernel event if the current core allows it.
+ * Must be called from the IRQ handler with the saved register frame. Does not
+ * return if the event was parked.
+ */
+void preempt_kernel(uint64_t* saved_state);
+
+/**
+ * @brief Queues the resume event for a context parked on this core. Called by
+ * the event loop once it no longer runs on the parked stack.
+ */
+void publish_parked();
+}  // namespace Preempt
+
+/**
+ * @brief Disables preemption for the lifetime of the guard
+ */
+class PreemptGuard {
+ public:
+  PreemptGuard() { Preempt::disable(); }
+
+  PreemptGuard(const PreemptGuard&) = delete;
+
+  ~PreemptGuard() { Preempt::enable(); }
+};
+
+#endif  // PREEMPT_H
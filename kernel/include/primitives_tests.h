@@ -1,9 +1,68 @@
 #include "semaphore.h"
+#include "mutex.h"
+#include "condvar.h"
 #include "barrier.h"
+#include "spin_barrier.h"
 #include "future.h"
 #include "testFramework.h"
 #include "atomics.h"
 #include "event_loop.h"
+#include "thread.h"
+#include "generic_timer.h"
+#include "printf.h"
+
+constexpr uint64_t SEMAPHORE_TEST_ITERATIONS = 10000;
+constexpr int SEMAPHORE_TEST_THREADS = 8;
+constexpr int SEMAPHORE_KEPT_UNITS = 3;
+constexpr uint64_t SPIN_BARRIER_ROUNDS = 10000;
+constexpr uint64_t CONDVAR_TEST_ITEMS = 1000;  // Taken by each consumer
+constexpr int CONDVAR_TEST_CONSUMERS = 4;
+
+struct SemaphoreMutex {
+    Semaphore sem{1};
+    volatile uint64_t counter = 0;  // Only changed between down() and up()
+    Atomic<int> done;
+};
+
+// Uses the semaphore as a mutex around one increment of the counter
+void semaphore_increments(SemaphoreMutex* mutex, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        mutex->sem.down();
+        mutex->counter = mutex->counter + 1;
+        mutex->sem.up();
+    }
+}
+
+struct MutexCounter {
+    Mutex mutex;
+    volatile uint64_t counter = 0;  // Only changed while holding mutex
+    Atomic<int> done;
+};
+
+// Increments the counter under the mutex, with a few reads in between so the
+// mutex is held long enough for others to queue up behind it
+void mutex_increments(MutexCounter* shared, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        LockGuard<Mutex> guard(shared->mutex);
+        uint64_t value = shared->counter;
+        for (int j = 0; j < 10; j++) value = value + (shared->counter - value);
+        shared->counter = value + 1;
+    }
+}
+
+struct ItemQueue {
+    Mutex mutex;
+    CondVar nonempty;
+    uint64_t items = 0;  // Produced and not yet taken, guarded by mutex
+    Atomic<int> done;
+};
+
+// Waits for the timeout or for *done to reach target
+bool wait_done(Atomic<int>* done, int target) {
+    uint64_t until = GenericTimer::now() + GenericTimer::ns_to_counter(LOCK_BENCHMARK_TIMEOUT_NS);
+    while (done->load() < target && GenericTimer::now() < until);
+    return done->load() == target;
+}
 
 void primitives_tests() {
     initTests("Synchronization Primitive Tests");
@@ -12,7 +71,7 @@ void primitives_tests() {
 
     Atomic<int>* total = new Atomic<int>(0);
     for (int i = 0; i < 10; i++) {
-        schedule_event([&f, &total] { 
+        Thread::spawn([&f, &total] { 
             int x = f->get(); 
             total->add_fetch(x);
         });
@@ -31,7 +90,7 @@ void primitives_tests() {
     Barrier* b = new Barrier(11);
 
     for (int i = 0; i < 10; i++) {
-        schedule_event([b, total] { 
+        Thread::spawn([b, total] { 
             total->add_fetch(-1);
             b->sync();
         });
@@ -54,4 +113,168 @@ void primitives_tests() {
     b->sync();
 
     testsResult("Barrier Testing", true);
+
+    // Semaphore: units given with nobody waiting are kept for later downs
+    Semaphore* sem = new Semaphore(0);
+    for (int i = 0; i < SEMAPHORE_KEPT_UNITS; i++) sem->up();
+    Atomic<int>* downs = new Atomic<int>(0);
+    Thread::spawn([sem, downs] {
+        for (int i = 0; i < SEMAPHORE_KEPT_UNITS; i++) {
+            sem->down();
+            downs->add_fetch(1);
+        }
+    });
+    testsResult("Semaphore Keeps Units", wait_done(downs, SEMAPHORE_KEPT_UNITS));
+
+    // Semaphore: blocked threads on any cores keep a counter exact
+    SemaphoreMutex* threads = new SemaphoreMutex();
+    for (int i = 0; i < SEMAPHORE_TEST_THREADS; i++) {
+        Thread::spawn([threads] {
+            semaphore_increments(threads, SEMAPHORE_TEST_ITERATIONS);
+            threads->done.add_fetch(1);
+        });
+    }
+    uint64_t until = GenericTimer::now() + GenericTimer::ns_to_counter(LOCK_BENCHMARK_TIMEOUT_NS);
+    while (threads->done.load() < SEMAPHORE_TEST_THREADS && GenericTimer::now() < until);
+    testsResult("Semaphore Excludes Threads",
+                threads->done.load() == SEMAPHORE_TEST_THREADS &&
+                threads->counter == SEMAPHORE_TEST_THREADS * SEMAPHORE_TEST_ITERATIONS);
+
+    // Semaphore: the cost of an uncontended down() and up(), which never
+    // take the lock
+    SemaphoreMutex* alone = new SemaphoreMutex();
+    uint64_t start = GenericTimer::now();
+    semaphore_increments(alone, SEMAPHORE_TEST_ITERATIONS);
+    uint64_t uncontended_ns = GenericTimer::counter_to_ns(GenericTimer::now() - start) /
+                              SEMAPHORE_TEST_ITERATIONS;
+
+    // Semaphore: polling events on every core keep a counter exact
+    SemaphoreMutex* cores = new SemaphoreMutex();
+    uint64_t elapsed = run_on_cores(NUM_CORES, [cores](int) {
+        semaphore_increments(cores, SEMAPHORE_TEST_ITERATIONS);
+    });
+    uint64_t contended_ns = elapsed == 0 ? 0 :
+        GenericTimer::counter_to_ns(elapsed) / (NUM_CORES * SEMAPHORE_TEST_ITERATIONS);
+    printf(" Semaphore ns per down/up: %lu Alone, %lu on %d Cores\n",
+           uncontended_ns, contended_ns, NUM_CORES);
+    testsResult("Semaphore Excludes Cores",
+                elapsed != 0 && cores->counter == NUM_CORES * SEMAPHORE_TEST_ITERATIONS);
+
+    // SpinBarrier: no core leaves a round before every core has arrived, and
+    // the cost of one round trip with every core taking part
+    SpinBarrier* spin_barrier = new SpinBarrier(NUM_CORES);
+    Atomic<uint64_t>* arrivals = new Atomic<uint64_t>(0);
+    Atomic<uint64_t>* early = new Atomic<uint64_t>(0);
+    elapsed = run_on_cores(NUM_CORES, [spin_barrier, arrivals, early](int) {
+        for (uint64_t round = 1; round <= SPIN_BARRIER_ROUNDS; round++) {
+            arrivals->add_fetch(1);
+            spin_barrier->sync();
+            if (arrivals->load() < round * NUM_CORES) early->add_fetch(1);
+        }
+    });
+    uint64_t round_ns = elapsed == 0 ? 0 :
+        GenericTimer::counter_to_ns(elapsed) / SPIN_BARRIER_ROUNDS;
+    printf(" SpinBarrier ns per Round on %d Cores: %lu\n", NUM_CORES, round_ns);
+    testsResult("SpinBarrier Waits For All", elapsed != 0 && early->load() == 0);
+
+    // Mutex: threads that spin and then park keep a counter exact
+    MutexCounter* mutex_threads = new MutexCounter();
+    for (int i = 0; i < SEMAPHORE_TEST_THREADS; i++) {
+        Thread::spawn([mutex_threads] {
+            mutex_increments(mutex_threads, SEMAPHORE_TEST_ITERATIONS);
+            mutex_threads->done.add_fetch(1);
+        });
+    }
+    bool finished = wait_done(&mutex_threads->done, SEMAPHORE_TEST_THREADS);
+    testsResult("Mutex Excludes Threads",
+                finished &&
+                mutex_threads->counter == SEMAPHORE_TEST_THREADS * SEMAPHORE_TEST_ITERATIONS);
+
+    // Mutex: polling events on every core keep a counter exact
+    MutexCounter* mutex_cores = new MutexCounter();
+    elapsed = run_on_cores(NUM_CORES, [mutex_cores](int) {
+        mutex_increments(mutex_cores, SEMAPHORE_TEST_ITERATIONS);
+    });
+    uint64_t mutex_ns = elapsed == 0 ? 0 :
+        GenericTimer::counter_to_ns(elapsed) / (NUM_CORES * SEMAPHORE_TEST_ITERATIONS);
+    printf(" Mutex ns per Critical Section on %d Cores: %lu\n", NUM_CORES, mutex_ns);
+    testsResult("Mutex Excludes Cores",
+                elapsed != 0 && mutex_cores->counter == NUM_CORES * SEMAPHORE_TEST_ITERATIONS);
+
+    // CondVar: consumer threads take every item this event produces, woken
+    // one at a time
+    ItemQueue* queue = new ItemQueue();
+    for (int i = 0; i < CONDVAR_TEST_CONSUMERS; i++) {
+        Thread::spawn([queue] {
+            for (uint64_t taken = 0; taken < CONDVAR_TEST_ITEMS; taken++) {
+                LockGuard<Mutex> guard(queue->mutex);
+                queue->nonempty.wait(queue->mutex, [queue] { return queue->items > 0; });
+                queue->items--;
+            }
+            queue->done.add_fetch(1);
+        });
+    }
+    for (uint64_t i = 0; i < CONDVAR_TEST_CONSUMERS * CONDVAR_TEST_ITEMS; i++) {
+        LockGuard<Mutex> guard(queue->mutex);
+        queue->items++;
+        queue->nonempty.notify_one();
+    }
+    finished = wait_done(&queue->done, CONDVAR_TEST_CONSUMERS);
+    testsResult("CondVar Notify One", finished && queue->items == 0);
+
+    // CondVar: notify_all releases every waiting thread
+    ItemQueue* gate = new ItemQueue();
+    Atomic<int>* waiting = new Atomic<int>(0);
+    for (int i = 0; i < CONDVAR_TEST_CONSUMERS; i++) {
+        Thread::spawn([gate, waiting] {
+            LockGuard<Mutex> guard(gate->mutex);
+            waiting->add_fetch(1);
+            gate->nonempty.wait(gate->mutex, [gate] { return gate->items > 0; });
+            gate->done.add_fetch(1);
+        });
+    }
+    wait_done(waiting, CONDVAR_TEST_CONSUMERS);
+    {
+        LockGuard<Mutex> guard(gate->mutex);
+        gate->items = 1;
+        gate->nonempty.notify_all();
+    }
+    finished = wait_done(&gate->done, CONDVAR_TEST_CONSUMERS);
+    testsResult("CondVar Notify All", finished);
+
+    // Future: continuations chain as events, without a context blocking in
+    // between
+    Future<int>* source = new Future<int>();
+    Future<int>* doubled = source->then([](int x) { return x * 2; })
+                                 ->then([](int x) { return x + 1; });
+    source->set(20);
+    testsResult("Future Then Chains", doubled->get() == 41);
+
+    // Future: a continuation added after the value was set still runs
+    Future<int>* late = source->then([](int x) { return x - 20; });
+    testsResult("Future Then After Set", late->get() == 0);
+
+    // Future: when_all waits for every future, when_any for the first
+    constexpr int COMBINED = 4;
+    Future<int>* parts[COMBINED];
+    for (int i = 0; i < COMBINED; i++) parts[i] = new Future<int>();
+    Future<bool>* all = when_all(parts, COMBINED);
+    Future<size_t>* any = when_any(parts, COMBINED);
+    parts[2]->set(2);
+    size_t first = any->get();
+    bool all_early = all->is_set();
+    for (int i = 0; i < COMBINED; i++) parts[i]->set(i);
+    testsResult("Future When Any", first == 2);
+    testsResult("Future When All", !all_early && all->get());
+
+    // Future: when_any of nothing is set at once, and futures that are never
+    // set may be deleted while it waits on them
+    Future<size_t>* none = when_any(parts, 0);
+    Future<int>* unset = new Future<int>();
+    Future<int>* racing[2] = {unset, parts[0]};
+    Future<size_t>* any_set = when_any(racing, 2);
+    size_t first_set = any_set->get();
+    delete unset;
+    testsResult("Future When Any Edge Cases",
+                none->is_set() && none->get() == 0 && first_set == 1);
 }
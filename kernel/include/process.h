@@ -1,4 +1,9 @@
 #include "vmm.h"
+#include "deadline_sched.h"
+#include "event_loop.h"
+#include "fair_sched.h"
+#include "fpu.h"
+#include "futex.h"
 #include "ioresource.h"
 
 #ifndef PROCESS_H
@@ -46,17 +51,39 @@ struct ProcessContext
   ProcessContext(uint64_t entry_point, uint64_t initial_sp) : pc(entry_point), sp(initial_sp) {}
 };
 
+class Process;
+
+// Runs a process picked by its scheduling class. Every process owns exactly
+// one, since it is queued at most once at a time.
+struct DispatchEvent : public Event {
+  Process* const process;
+
+  explicit DispatchEvent(Process* process) : Event(), process(process) {}
+  virtual void run() override;
+};
+
 // See src/process.cpp for details on functions
 class Process
 {
   static constexpr int NUM_IO_RESOURCES = 16;
   static constexpr uint64_t STACK_LOW_INCLUSIVE = 0x0000'FFFF'FFF0'0000;
   static constexpr uint64_t STACK_HIGH_EXCLUSIVE = 0x0001'0000'0000'0000;
+  static constexpr uint8_t NO_CORE = 0xFF;
   ProcessContext context;
+  FPContext fp_context;
   VMM::TranslationTable translation_table;
   IOResource* resources[NUM_IO_RESOURCES];
+  uint8_t last_core;
+  uint8_t affinity;
+  uint64_t migrations;
+  FairEntity fair_entity;
+  DeadlineEntity deadline_entity;
+  DispatchEvent dispatch_event;
+  FutexWaiter futex_waiter;
 
   int find_unused_fd();
+  uint8_t pick_core() const;
+  void leave_core(uint64_t* saved_state);
 
 public:
 
@@ -64,7 +91,17 @@ public:
   ~Process();
 
   void run();
+  void dispatch();
+  void schedule(bool yielded = false);
   void save_state(uint64_t* register_frame);
+  void release_fp_state();
+  void block(uint64_t* saved_state);
+  [[noreturn]] void requeue(uint64_t* saved_state, bool yielded = false);
+  template <typename T>
+  void set_result(Syscall::Result<T> result) {
+    context.x0 = Converter::bits_to_u64<T>(result.data);
+    context.x1 = result.code;
+  }
   void map_range(uint64_t start, uint64_t end);
   void vm_load(uint64_t vaddr, uint64_t filesz, uint64_t memsz,
                const char* data);
@@ -72,6 +109,15 @@ public:
   IOResource* get_io_resource(int fd);
   Syscall::Result<int> file_open(const char* name);
   Syscall::Result<int> close_io_resource(int fd);
+  bool set_affinity(uint64_t core_mask);
+  bool may_run_on(uint8_t core) const { return affinity & (1 << core); }
+  uint64_t get_migrations() const { return migrations; }
+  bool set_nice(int nice);
+  FairEntity& fair() { return fair_entity; }
+  bool set_deadline(const DeadlineParams* params);
+  DeadlineEntity* deadline() { return deadline_entity.admitted() ? &deadline_entity : nullptr; }
+  Event* get_dispatch_event() { return &dispatch_event; }
+  FutexWaiter* get_futex_waiter() { return &futex_waiter; }
 };
 
 extern Process* activeProcess[4];
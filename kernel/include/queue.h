@@ -2,8 +2,26 @@
 #define QUEUE_H
 
 #include "atomics.h"
+#include "preempt.h"
 #include "printf.h"
-
+#include "reclaim.h"
+
+/**
+ * @brief Unbounded Michael-Scott queue
+ *
+ * Dequeued nodes are handed to Reclaim instead of being deleted right away,
+ * since another core may still be reading the node it loaded as head. This
+ * also keeps a node's address from being reused while a stale pointer to it
+ * can still win a compare-and-swap. Every operation runs with preemption
+ * disabled, since a parked event would otherwise keep a node pointer across
+ * its core's quiescent states.
+ *
+ * Linking a node into next is a release that every load of a next or tail
+ * pointer acquires, so whoever reaches a node also sees its item. Swinging
+ * tail or head only needs to release what the swinging core saw before, and
+ * a failed compare-and-swap publishes nothing, so none of them is
+ * sequentially consistent.
+ */
 template <typename T>
 class LocklessQueue {
   struct Node {
@@ -25,12 +43,13 @@ class LocklessQueue {
   }
 
   ~LocklessQueue() {
-    // Node* current = head;
-    // while (current != nullptr) {
-    //     Node* next = current->next;
-    //     delete current;
-    //     current = next;
-    // }
+    // No other core may use the queue once it is being destroyed
+    Node* current = head;
+    while (current != nullptr) {
+      Node* next = current->next;
+      delete current;
+      current = next;
+    }
   }
 
   void enqueue(T item) {
@@ -38,51 +57,57 @@ class LocklessQueue {
     tmp->item = item;
     tmp->next = nullptr;
 
+    PreemptGuard guard;
     Node* tmp_tail;
     bool successful_exchange;
     do {
-      tmp_tail = __atomic_load_n(&tail, __ATOMIC_SEQ_CST);
-      Node* tail_next = tmp_tail->next;
+      tmp_tail = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+      Node* tail_next = __atomic_load_n(&tmp_tail->next, __ATOMIC_ACQUIRE);
       if (tail_next != 0) {
         __atomic_compare_exchange_n(&tail, &tmp_tail, tail_next, true,
-                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED);
         successful_exchange = false;
       } else {
         successful_exchange = __atomic_compare_exchange_n(
-            &tail->next, &tmp->next /*nullptr*/, tmp, true, __ATOMIC_SEQ_CST,
-            __ATOMIC_SEQ_CST);
+            &tmp_tail->next, &tail_next /*nullptr*/, tmp, true,
+            __ATOMIC_RELEASE, __ATOMIC_RELAXED);
       }
     } while (!successful_exchange);
 
-    __atomic_compare_exchange_n(&tail, &tmp_tail, tmp, false, __ATOMIC_SEQ_CST,
-                                __ATOMIC_SEQ_CST);
-    
-}
+    __atomic_compare_exchange_n(&tail, &tmp_tail, tmp, false, __ATOMIC_RELEASE,
+                                __ATOMIC_RELAXED);
+  }
 
   T dequeue() {
     Node* prev_head;
+    Node* next;
     T item;
+    PreemptGuard guard;
 
     do {
-      prev_head = __atomic_load_n(&head, __ATOMIC_SEQ_CST);
+      prev_head = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+      next = __atomic_load_n(&prev_head->next, __ATOMIC_ACQUIRE);
 
       // Empty Queue
-      if (prev_head->next == 0) return {};
+      if (next == 0) return {};
 
-      // TODO: A race condition exists here
-      item = prev_head->next->item;
-    } while (!__atomic_compare_exchange_n(&head, &prev_head, prev_head->next,
-                                          true, __ATOMIC_SEQ_CST,
-                                          __ATOMIC_SEQ_CST));
+      // Safe even if another core dequeues next first, since next cannot be
+      // reclaimed until this core passes through a quiescent state
+      item = next->item;
+      // Release keeps the read of item before the swing, after which
+      // another core may dequeue and retire next
+    } while (!__atomic_compare_exchange_n(&head, &prev_head, next, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
 
-    delete prev_head;
+    Reclaim::retire(prev_head);
 
     return item;
   }
 
   bool is_empty() {
-    return __atomic_load_n(&head, __ATOMIC_SEQ_CST) ==
-           __atomic_load_n(&tail, __ATOMIC_SEQ_CST);
+    PreemptGuard guard;
+    Node* current_head = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+    return __atomic_load_n(&current_head->next, __ATOMIC_ACQUIRE) == nullptr;
   }
 };
 
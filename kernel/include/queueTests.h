@@ -0,0 +1,142 @@
+#ifndef QUEUE_TESTS_H
+#define QUEUE_TESTS_H
+
+#include "atomics.h"
+#include "event_loop.h"
+#include "printf.h"
+#include "queue.h"
+#include "ring_queue.h"
+#include "testFramework.h"
+
+constexpr int QUEUE_BENCH_OPS = 20000;
+
+void queueTests() {
+  initTests("Queue Tests");
+
+  // Test 1: FIFO order on a single core
+  RingQueue<int> fifo(16);
+  for (int i = 1; i <= 10; i++) fifo.try_enqueue(i);
+  bool in_order = true;
+  for (int i = 1; i <= 10; i++) {
+    int item = 0;
+    in_order &= fifo.try_dequeue(item) && item == i;
+  }
+  testsResult("Ring queue FIFO order", in_order && fifo.is_empty());
+
+  // Test 2: Full and empty detection
+  RingQueue<int> small(8);
+  bool filled = true;
+  for (int i = 0; i < 8; i++) filled &= small.try_enqueue(i);
+  int item = 0;
+  bool overflow_rejected = !small.try_enqueue(8);
+  while (small.try_dequeue(item)) {
+  }
+  testsResult("Ring queue full and empty",
+              filled && overflow_rejected && small.is_empty() &&
+                  !small.try_dequeue(item));
+
+  // Test 3: Batch operations stop at capacity
+  RingQueue<int> batch(4);
+  int in[6] = {1, 2, 3, 4, 5, 6};
+  int out[6] = {};
+  size_t enqueued = batch.try_enqueue_batch(in, 6);
+  size_t dequeued = batch.try_dequeue_batch(out, 6);
+  testsResult("Ring queue batch",
+              enqueued == 4 && dequeued == 4 && out[0] == 1 && out[3] == 4);
+
+  // Test 4: An event queue spills past its ring instead of failing, and
+  // hands the spilled events back in order
+  EventQueue events(4);
+  int ran_in_order = 0;
+  for (int i = 0; i < 10; i++) {
+    events.enqueue(new EventWithWork([&ran_in_order, i] {
+      if (ran_in_order == i) ran_in_order++;
+    }));
+  }
+  size_t queued = events.size();
+  Event* event;
+  while (events.try_dequeue(event)) {
+    event->run();
+    delete event;
+  }
+  testsResult("Event queue overflow",
+              queued == 10 && ran_in_order == 10 && events.is_empty());
+
+  // Test 5: No items lost or duplicated with four cores. Whatever the
+  // workers use is left allocated if they do not finish in time.
+  RingQueue<uint64_t>* shared = new RingQueue<uint64_t>(1024);
+  Atomic<uint64_t>* sum = new Atomic<uint64_t>(0);
+  uint64_t elapsed = run_on_cores(4, [shared, sum](int worker) {
+    uint64_t local = 0;
+    for (int i = 0; i < QUEUE_BENCH_OPS; i++) {
+      shared->enqueue(worker * QUEUE_BENCH_OPS + i + 1);
+      local += shared->dequeue();
+    }
+    sum->add_fetch(local);
+  });
+  uint64_t n = 4 * QUEUE_BENCH_OPS;
+  testsResult("Ring queue MPMC conservation",
+              elapsed != 0 && sum->load() == n * (n + 1) / 2 && shared->is_empty());
+  if (elapsed != 0) {
+    delete shared;
+    delete sum;
+  }
+
+  // Test 6: Linked queue survives the same workload now that dequeued nodes
+  // are reclaimed by epoch
+  sum = new Atomic<uint64_t>(0);
+  LocklessQueue<uint64_t>* linked = new LocklessQueue<uint64_t>();
+  elapsed = run_on_cores(4, [linked, sum](int worker) {
+    uint64_t local = 0;
+    for (int i = 0; i < QUEUE_BENCH_OPS; i++) {
+      linked->enqueue(worker * QUEUE_BENCH_OPS + i + 1);
+      uint64_t item;
+      while ((item = linked->dequeue()) == 0) {
+      }
+      local += item;
+    }
+    sum->add_fetch(local);
+  });
+  testsResult("Lockless queue MPMC conservation",
+              elapsed != 0 && sum->load() == n * (n + 1) / 2 && linked->is_empty());
+  if (elapsed != 0) {
+    delete linked;
+    delete sum;
+  }
+
+  // Benchmark: enqueue/dequeue pairs with 1-4 producer/consumer cores
+  for (int cores = 1; cores <= 4; cores++) {
+    RingQueue<uint64_t>* ring = new RingQueue<uint64_t>(1024);
+    uint64_t ticks = run_on_cores(cores, [ring](int) {
+      for (int i = 0; i < QUEUE_BENCH_OPS; i++) {
+        ring->enqueue(i + 1);
+        ring->dequeue();
+      }
+    });
+    printf(" %d cores:", cores);
+    if (ticks == 0) {
+      printf(" RingQueue did not finish\n");
+      return;
+    }
+    benchResult("RingQueue", 2 * cores * QUEUE_BENCH_OPS, ticks);
+    delete ring;
+
+    LocklessQueue<uint64_t>* list = new LocklessQueue<uint64_t>();
+    ticks = run_on_cores(cores, [list](int) {
+      for (int i = 0; i < QUEUE_BENCH_OPS; i++) {
+        list->enqueue(i + 1);
+        while (list->dequeue() == 0) {
+        }
+      }
+    });
+    printf(" %d cores:", cores);
+    if (ticks == 0) {
+      printf(" LocklessQueue did not finish\n");
+      return;
+    }
+    benchResult("LocklessQueue", 2 * cores * QUEUE_BENCH_OPS, ticks);
+    delete list;
+  }
+}
+
+#endif  // QUEUE_TESTS_H
@@ -0,0 +1,53 @@
+// Citations
+// https://www.cl.cam.ac.uk/techreports/UCAM-CL-TR-579.pdf (Fraser, Section 5.2.3)
+
+#ifndef RECLAIM_H
+#define RECLAIM_H
+
+#include "stdint.h"
+
+/**
+ * @brief Epoch-based safe memory reclamation for lock-free structures
+ *
+ * A core passes through a quiescent state every time the event loop goes
+ * back to pick another event. Only the stretches of an event that run with
+ * preemption disabled are critical sections: an event can be parked in
+ * between and its core go on to run others, so references to lock-free
+ * memory must not be held across a point where preemption is enabled.
+ * Memory handed to retire() is only freed once every online core has passed
+ * through two epoch changes, so no core can still be holding a pointer it
+ * read before the memory was retired.
+ *
+ * Cores come online the first time they reach the event loop. Lock-free
+ * structures must not be read by a core before that point.
+ */
+namespace Reclaim {
+/**
+ * @brief Defers deleter(ptr) until no core can still reference ptr
+ */
+void retire(void* ptr, void (*deleter)(void*));
+
+/**
+ * @brief Defers delete ptr until no core can still reference ptr
+ */
+template <typename T>
+void retire(T* ptr) {
+  retire(ptr, [](void* p) { delete static_cast<T*>(p); });
+}
+
+/**
+ * @brief Announces that the current core holds no references to lock-free
+ * memory, frees whatever that makes safe and tries to advance the epoch.
+ * Called by the event loop between events.
+ */
+void quiescent_state();
+
+/**
+ * @brief Takes the current core out of epoch agreement until its next
+ * quiescent state, so that an idle core does not hold up reclamation while it
+ * sleeps
+ */
+void go_offline();
+}  // namespace Reclaim
+
+#endif  // RECLAIM_H
@@ -0,0 +1,241 @@
+// Citations
+// https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+
+#ifndef RING_QUEUE_H
+#define RING_QUEUE_H
+
+#include "definitions.h"
+#include "stdint.h"
+
+/**
+ * @brief Bounded multi-producer multi-consumer queue (Vyukov)
+ *
+ * Every cell carries a sequence number that tells producers and consumers
+ * which lap of the ring the cell belongs to, so a single CAS on the enqueue or
+ * dequeue position is enough to claim a cell. Unlike LocklessQueue, nothing is
+ * allocated after construction and no cell is ever freed while another core
+ * may still read it.
+ *
+ * The producer and consumer positions live on separate cache lines so that
+ * enqueuing cores and dequeuing cores do not invalidate each other's lines.
+ *
+ * Being bounded, it suits queues whose producers can handle a full queue,
+ * like EventQueue (event_loop.h) with its overflow list. Wait queues, whose
+ * producers cannot, stay intrusive lists (wait_queue.h).
+ *
+ * @tparam T type of the queued items (should be cheap to copy)
+ */
+template <typename T>
+class RingQueue {
+  struct Cell {
+    size_t sequence;
+    T item;
+  };
+
+  Cell* const cells;
+  size_t const mask;
+
+  char pad0[CACHE_LINE_SIZE];
+  size_t enqueue_pos;
+  char pad1[CACHE_LINE_SIZE - sizeof(size_t)];
+  size_t dequeue_pos;
+  char pad2[CACHE_LINE_SIZE - sizeof(size_t)];
+
+  static size_t round_up_pow2(size_t n) {
+    size_t result = 2;
+    while (result < n) result <<= 1;
+    return result;
+  }
+
+ public:
+  /**
+   * @brief Construct a new RingQueue
+   *
+   * @param min_capacity  minimum number of items the queue must hold, rounded
+   *                      up to the next power of two
+   */
+  explicit RingQueue(size_t min_capacity)
+      : cells(new Cell[round_up_pow2(min_capacity)]),
+        mask(round_up_pow2(min_capacity) - 1),
+        enqueue_pos(0),
+        dequeue_pos(0) {
+    for (size_t i = 0; i <= mask; i++) {
+      __atomic_store_n(&cells[i].sequence, i, __ATOMIC_RELAXED);
+    }
+  }
+
+  ~RingQueue() { delete[] cells; }
+
+  RingQueue(const RingQueue&) = delete;
+  RingQueue& operator=(const RingQueue&) = delete;
+
+  /**
+   * @brief Enqueues item if there is room
+   *
+   * @return true   item was enqueued
+   * @return false  queue is full
+   */
+  bool try_enqueue(T const& item) {
+    Cell* cell;
+    size_t pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+    while (true) {
+      cell = &cells[pos & mask];
+      size_t seq = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+      int64_t diff = (int64_t)seq - (int64_t)pos;
+      if (diff == 0) {
+        // Cell is free for this lap, try to claim it
+        if (__atomic_compare_exchange_n(&enqueue_pos, &pos, pos + 1, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // Cell still holds an item from the previous lap
+        return false;
+      } else {
+        // Another producer claimed this cell
+        pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+      }
+    }
+
+    cell->item = item;
+    __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  /**
+   * @brief Dequeues into item if the queue is not empty
+   *
+   * @return true   item holds the dequeued value
+   * @return false  queue is empty, item is unchanged
+   */
+  bool try_dequeue(T& item) {
+    Cell* cell;
+    size_t pos = __atomic_load_n(&dequeue_pos, __ATOMIC_RELAXED);
+    while (true) {
+      cell = &cells[pos & mask];
+      size_t seq = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+      int64_t diff = (int64_t)seq - (int64_t)(pos + 1);
+      if (diff == 0) {
+        // Cell holds an item for this lap, try to claim it
+        if (__atomic_compare_exchange_n(&dequeue_pos, &pos, pos + 1, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // Producer has not filled this cell yet
+        return false;
+      } else {
+        // Another consumer claimed this cell
+        pos = __atomic_load_n(&dequeue_pos, __ATOMIC_RELAXED);
+      }
+    }
+
+    item = cell->item;
+    __atomic_store_n(&cell->sequence, pos + mask + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  /**
+   * @brief Dequeues into item if the queue is not empty and take(front) holds
+   * for the item at its front, leaving the queue untouched otherwise
+   *
+   * The front item is copied before it is claimed, and another consumer may
+   * claim it first. take then sees a copy that is thrown away, so it must only
+   * look at the copy it is given, not at anything the item points to.
+   */
+  template <typename Take>
+  bool try_dequeue_if(T& item, Take take) {
+    Cell* cell;
+    size_t pos = __atomic_load_n(&dequeue_pos, __ATOMIC_RELAXED);
+    while (true) {
+      cell = &cells[pos & mask];
+      size_t seq = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+      int64_t diff = (int64_t)seq - (int64_t)(pos + 1);
+      if (diff == 0) {
+        // Nobody can refill the cell before pos is claimed, so the copy is
+        // the claimed item whenever the claim below succeeds
+        T front = cell->item;
+        if (!take(front)) return false;
+        if (__atomic_compare_exchange_n(&dequeue_pos, &pos, pos + 1, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+          item = front;
+          break;
+        }
+      } else if (diff < 0) {
+        // Producer has not filled this cell yet
+        return false;
+      } else {
+        // Another consumer claimed this cell
+        pos = __atomic_load_n(&dequeue_pos, __ATOMIC_RELAXED);
+      }
+    }
+
+    __atomic_store_n(&cell->sequence, pos + mask + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  /**
+   * @brief Enqueues item, spinning while the queue is full. Only for callers
+   * that know a consumer keeps running; interrupt handlers and code that
+   * holds a lock consumers need use try_enqueue().
+   */
+  void enqueue(T const& item) {
+    while (!try_enqueue(item)) {
+    }
+  }
+
+  /**
+   * @brief Dequeues an item, spinning while the queue is empty
+   */
+  T dequeue() {
+    T item;
+    while (!try_dequeue(item)) {
+    }
+    return item;
+  }
+
+  /**
+   * @brief Enqueues up to count items, stopping at the first full slot
+   *
+   * @return size_t  number of items enqueued (a prefix of items)
+   */
+  size_t try_enqueue_batch(T const* items, size_t count) {
+    size_t done = 0;
+    while (done < count && try_enqueue(items[done])) done++;
+    return done;
+  }
+
+  /**
+   * @brief Dequeues up to count items into items
+   *
+   * @return size_t  number of items dequeued
+   */
+  size_t try_dequeue_batch(T* items, size_t count) {
+    size_t done = 0;
+    while (done < count && try_dequeue(items[done])) done++;
+    return done;
+  }
+
+  /**
+   * @brief Checks if the queue is empty using a single cell load. The answer
+   * may be stale by the time the caller acts on it.
+   */
+  bool is_empty() const {
+    size_t pos = __atomic_load_n(&dequeue_pos, __ATOMIC_RELAXED);
+    size_t seq = __atomic_load_n(&cells[pos & mask].sequence, __ATOMIC_ACQUIRE);
+    return (int64_t)seq - (int64_t)(pos + 1) < 0;
+  }
+
+  /**
+   * @brief Approximate number of queued items
+   */
+  size_t size() const {
+    size_t tail = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+    size_t head = __atomic_load_n(&dequeue_pos, __ATOMIC_RELAXED);
+    return tail > head ? tail - head : 0;
+  }
+
+  size_t capacity() const { return mask + 1; }
+};
+
+#endif  // RING_QUEUE_H
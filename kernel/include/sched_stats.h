@@ -0,0 +1,162 @@
+#ifndef SCHED_STATS_H
+#define SCHED_STATS_H
+
+#include "definitions.h"
+#include "generic_timer.h"
+#include "stdint.h"
+
+#if defined(SCHED_STATS_ENABLED) && (SCHED_STATS_ENABLED + 0)
+#define SCHED_STATS 1
+#else
+#define SCHED_STATS 0
+#endif
+
+#if SCHED_STATS && defined(SCHED_STATS_DEBUG_KEY) && (SCHED_STATS_DEBUG_KEY + 0)
+#define SCHED_STATS_KEY 1
+#else
+#define SCHED_STATS_KEY 0
+#endif
+
+/**
+ * @brief Per-core scheduler counters and histograms
+ *
+ * Compiled in with SCHED_STATS_ENABLED=1. Every core only ever writes its own
+ * cache line of counters, so recording costs a couple of generic timer reads
+ * and increments per event, with no atomics. Readers on other cores may see a
+ * snapshot that is a few events out of date.
+ *
+ * A kernel event that is preempted and later resumed counts as one event,
+ * with its time parked left out of its run time.
+ *
+ * All durations are in generic timer ticks. Histogram bucket i counts samples
+ * in [2^i, 2^(i+1)) ticks, with 0 ticks counted in bucket 0.
+ */
+namespace SchedStats {
+constexpr int HISTOGRAM_BUCKETS = 32;
+
+// ASCII code of Ctrl-T, the key that dumps the statistics over the UART
+constexpr int DEBUG_KEY = 0x14;
+
+// How often the UART is checked for the debug key. The poll keeps a timer
+// pending on one core, which stops that core from going tickless, so it is
+// only built in with SCHED_STATS_DEBUG_KEY=1.
+constexpr uint64_t DEBUG_KEY_POLL_NS = 50'000'000;
+
+struct CoreStats {
+  uint64_t events_run;
+  uint64_t busy_ticks;        // Running events that returned to the loop
+  uint64_t idle_ticks;        // Asleep in the event loop
+  uint64_t preemptions;       // Processes and kernel events preempted
+  uint64_t yields;            // Yield system calls
+  uint64_t context_switches;  // Entries into a different process
+  uint64_t latency[HISTOGRAM_BUCKETS];   // From enqueue to start of run
+  uint64_t run_time[HISTOGRAM_BUCKETS];  // From start to end of run
+};
+
+// What the sched_stats system call copies out
+struct Snapshot {
+  uint64_t counter_frequency;  // Generic timer ticks per second
+  CoreStats cores[NUM_CORES];
+};
+
+#if SCHED_STATS
+struct alignas(CACHE_LINE_SIZE) CoreState {
+  CoreStats stats;
+  const void* last_process;
+  uint64_t run_started;  // Start of the running event's current stretch
+  uint64_t run_before;   // Run time of the running event before it was parked
+};
+
+extern CoreState core_state[NUM_CORES];
+
+inline int bucket(uint64_t ticks) {
+  if (ticks == 0) return 0;
+  int log2 = 63 - __builtin_clzll(ticks);
+  return log2 < HISTOGRAM_BUCKETS ? log2 : HISTOGRAM_BUCKETS - 1;
+}
+
+inline uint64_t now() { return GenericTimer::now(); }
+
+// Records the wait of an event that enqueued_at stamped and starts timing its
+// run
+inline void event_started(uint8_t core, uint64_t enqueued_at) {
+  CoreState& state = core_state[core];
+  state.run_started = now();
+  state.run_before = 0;
+  state.stats.events_run++;
+  state.stats.latency[bucket(state.run_started - enqueued_at)]++;
+}
+
+inline void event_finished(uint8_t core) {
+  CoreState& state = core_state[core];
+  uint64_t ticks = now() - state.run_started;
+  state.stats.busy_ticks += ticks;
+  state.stats.run_time[bucket(state.run_before + ticks)]++;
+}
+
+// Stops timing a kernel event that is being parked, returning how long it
+// has run so far
+inline uint64_t event_parked(uint8_t core) {
+  CoreState& state = core_state[core];
+  uint64_t ticks = now() - state.run_started;
+  state.stats.busy_ticks += ticks;
+  return state.run_before + ticks;
+}
+
+// Carries on timing a parked event that ran for run_before, from inside the
+// event that resumes it. That event is not counted, as the parked event was
+// already counted when it first started.
+inline void event_resumed(uint8_t core, uint64_t run_before) {
+  CoreState& state = core_state[core];
+  state.stats.events_run--;
+  state.run_started = now();
+  state.run_before = run_before;
+}
+
+inline void idle_finished(uint8_t core, uint64_t start) {
+  core_state[core].stats.idle_ticks += now() - start;
+}
+
+inline void preempted(uint8_t core) { core_state[core].stats.preemptions++; }
+
+inline void yielded(uint8_t core) { core_state[core].stats.yields++; }
+
+inline void process_entered(uint8_t core, const void* process) {
+  CoreState& state = core_state[core];
+  if (state.last_process != process) {
+    state.last_process = process;
+    state.stats.context_switches++;
+  }
+}
+#else
+inline uint64_t now() { return 0; }
+inline void event_started(uint8_t, uint64_t) {}
+inline void event_finished(uint8_t) {}
+inline uint64_t event_parked(uint8_t) { return 0; }
+inline void event_resumed(uint8_t, uint64_t) {}
+inline void idle_finished(uint8_t, uint64_t) {}
+inline void preempted(uint8_t) {}
+inline void yielded(uint8_t) {}
+inline void process_entered(uint8_t, const void*) {}
+#endif
+
+/**
+ * @brief Copies the statistics of every core into snapshot
+ *
+ * @return false  statistics are not compiled in
+ */
+bool snapshot(Snapshot* snapshot);
+
+/**
+ * @brief Prints a summary of every core's statistics
+ */
+void dump();
+
+/**
+ * @brief Starts polling the UART for DEBUG_KEY, which calls dump(). Does
+ * nothing unless built with SCHED_STATS_DEBUG_KEY=1.
+ */
+void start_debug_key();
+}  // namespace SchedStats
+
+#endif  // SCHED_STATS_H
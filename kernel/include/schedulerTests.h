@@ -0,0 +1,197 @@
+#ifndef SCHEDULER_TESTS_H
+#define SCHEDULER_TESTS_H
+
+#include "deadline_task.h"
+#include "elfTests.h"
+#include "fair_sched.h"
+#include "generic_timer.h"
+#include "printf.h"
+#include "testFramework.h"
+
+// Every process of these tests is pinned here, so they compete for one core
+constexpr uint64_t FAIR_TEST_CORE_MASK = 1 << 3;
+constexpr uint64_t FAIR_TEST_RUN_NS = 500'000'000;
+
+// Shared with a user program, which finds its address in data[0]
+struct ProgramControl {
+  uint64_t core_mask;
+  int64_t nice;
+  uint64_t stop;    // Set by the kernel to make the program exit
+  uint64_t result;  // Loop iterations, or the longest yield in counter ticks
+};
+
+// Pins itself with control->core_mask, sets control->nice, then counts loop
+// iterations in control->result until control->stop is set
+const uint32_t CPU_HOG_PROGRAM[12] = {
+  0x58000193, // ldr x19, data[0]
+  0xF9400260, // ldr x0, [x19]
+  0xD4000161, // svc 0x0B
+  0xF9400660, // ldr x0, [x19, #8]
+  0xD40001C1, // svc 0x0E
+  0xF9400E61, // ldr x1, [x19, #24]
+  0x91000421, // add x1, x1, #1
+  0xF9000E61, // str x1, [x19, #24]
+  0xF9400A62, // ldr x2, [x19, #16]
+  0xB4FFFF82, // cbz x2, ldr x1
+  0xD4000001, // svc 0
+  0xD503201F  // nop
+};
+
+// Pins itself with control->core_mask, then yields in a loop, keeping the
+// longest time a yield took in control->result until control->stop is set
+const uint32_t INTERACTIVE_PROGRAM[16] = {
+  0x58000213, // ldr x19, data[0]
+  0xF9400260, // ldr x0, [x19]
+  0xD4000161, // svc 0x0B
+  0xD53BE034, // mrs x20, cntpct_el0
+  0xD4000021, // svc 1
+  0xD53BE035, // mrs x21, cntpct_el0
+  0xCB1402B5, // sub x21, x21, x20
+  0xF9400E61, // ldr x1, [x19, #24]
+  0xEB0102BF, // cmp x21, x1
+  0x9A8182A1, // csel x1, x21, x1, hi
+  0xF9000E61, // str x1, [x19, #24]
+  0xF9400A62, // ldr x2, [x19, #16]
+  0xB4FFFEE2, // cbz x2, mrs x20
+  0xD4000001, // svc 0
+  0xD503201F, // nop
+  0xD503201F  // nop
+};
+
+template <size_t NumInstructions>
+bool start_controlled_program(const uint32_t (&code)[NumInstructions],
+                              volatile ProgramControl* control, int nice,
+                              uint64_t core_mask = FAIR_TEST_CORE_MASK) {
+  control->core_mask = core_mask;
+  control->nice = nice;
+  control->stop = 0;
+  control->result = 0;
+  return run_user_program(code, user_address(&control->core_mask), 0);
+}
+
+void wait_ns(uint64_t ns) {
+  uint64_t until = GenericTimer::now() + GenericTimer::ns_to_counter(ns);
+  while (GenericTimer::now() < until);
+}
+
+// Runs two CPU hogs with the given nice values side by side, returning how
+// many iterations each managed in the same stretch of time
+bool run_hogs(int nice_a, int nice_b, uint64_t* iterations_a,
+              uint64_t* iterations_b) {
+  static volatile ProgramControl controls[2];
+  if (!start_controlled_program(CPU_HOG_PROGRAM, &controls[0], nice_a) ||
+      !start_controlled_program(CPU_HOG_PROGRAM, &controls[1], nice_b)) {
+    return false;
+  }
+
+  // Both have pinned themselves and set their nice value once they count
+  uint64_t until = GenericTimer::now() + GenericTimer::ns_to_counter(2'000'000'000);
+  while ((controls[0].result == 0 || controls[1].result == 0) &&
+         GenericTimer::now() < until);
+
+  uint64_t start_a = controls[0].result;
+  uint64_t start_b = controls[1].result;
+  wait_ns(FAIR_TEST_RUN_NS);
+  *iterations_a = controls[0].result - start_a;
+  *iterations_b = controls[1].result - start_b;
+
+  controls[0].stop = 1;
+  controls[1].stop = 1;
+  return start_a != 0 && start_b != 0;
+}
+
+void schedulerTests() {
+  initTests("Scheduler Tests");
+
+  // Test 1: Equal nice values share the core about equally
+  uint64_t a, b;
+  bool ran = run_hogs(0, 0, &a, &b);
+  printf(" Fair Share Iterations: %lu vs %lu\n", a, b);
+  testsResult("Equal Nice Shares Equally", ran && a * 4 >= b * 3 && b * 4 >= a * 3);
+
+  // Test 2: Nice 0 against nice 5 is 1024 against 335 in weight, about 3:1
+  ran = run_hogs(0, 5, &a, &b);
+  printf(" Nice 0 vs 5 Iterations: %lu vs %lu\n", a, b);
+  testsResult("Nice Weights Share", ran && a >= b * 2 && a <= b * 5);
+
+  // Test 3: A process yielding in a loop is not kept waiting long behind a hog
+  static volatile ProgramControl hog, interactive;
+  if (!start_controlled_program(CPU_HOG_PROGRAM, &hog, 0) ||
+      !start_controlled_program(INTERACTIVE_PROGRAM, &interactive, 0)) {
+    testsResult("Interactive Latency Bounded", false);
+    return;
+  }
+  wait_ns(FAIR_TEST_RUN_NS);
+  hog.stop = 1;
+  interactive.stop = 1;
+
+  uint64_t longest_ns = GenericTimer::counter_to_ns(interactive.result);
+  printf(" Interactive Longest Yield: %lu us, Hog Iterations: %lu\n",
+         longest_ns / 1000, hog.result);
+  testsResult("Interactive Latency Bounded",
+              interactive.result != 0 && hog.result != 0 &&
+                  longest_ns < 4 * FairSched::SCHED_LATENCY_NS);
+
+  // Test 4: Admission control rejects deadlines that would overcommit a core
+  constexpr uint64_t MS = 1000000;
+  constexpr uint8_t ADMISSION_TEST_CORE_MASK = 1 << 2;
+  const DeadlineParams sixty_percent{6 * MS, 10 * MS, 10 * MS};
+  const DeadlineParams thirty_percent{3 * MS, 10 * MS, 10 * MS};
+  auto nothing = [] {};
+  DeadlineTask* first =
+      schedule_deadline_task(sixty_percent, nothing, ADMISSION_TEST_CORE_MASK);
+  DeadlineTask* second =
+      schedule_deadline_task(sixty_percent, nothing, ADMISSION_TEST_CORE_MASK);
+  DeadlineTask* third =
+      schedule_deadline_task(thirty_percent, nothing, ADMISSION_TEST_CORE_MASK);
+  testsResult("Deadline Admission Control",
+              first != nullptr && second == nullptr && third != nullptr);
+  if (first != nullptr) first->stop();
+  if (third != nullptr) third->stop();
+
+  // Test 5: Admission stops at a full queue, whatever bandwidth is left
+  constexpr uint8_t QUEUE_TEST_CORE_MASK = 1 << 3;
+  const DeadlineParams sliver{1000, 1000 * MS, 1000 * MS};
+  DeadlineTask* slivers[DeadlineSched::QUEUE_CAPACITY];
+  size_t admitted = 0;
+  while (admitted < DeadlineSched::QUEUE_CAPACITY) {
+    slivers[admitted] = schedule_deadline_task(sliver, nothing, QUEUE_TEST_CORE_MASK);
+    if (slivers[admitted] == nullptr) break;
+    admitted++;
+  }
+  DeadlineTask* overflow = schedule_deadline_task(sliver, nothing, QUEUE_TEST_CORE_MASK);
+  testsResult("Deadline Admission Bounded By Queue",
+              admitted == DeadlineSched::QUEUE_CAPACITY && overflow == nullptr);
+  if (overflow != nullptr) overflow->stop();
+  for (size_t i = 0; i < admitted; i++) slivers[i]->stop();
+
+  // Test 6: A periodic deadline task meets its deadlines while every core
+  // also runs a CPU hog
+  static volatile ProgramControl hogs[NUM_CORES];
+  for (int core = 0; core < NUM_CORES; core++) {
+    start_controlled_program(CPU_HOG_PROGRAM, &hogs[core], -5, 1 << core);
+  }
+
+  constexpr uint64_t WORK_NS = MS / 2;
+  const DeadlineParams sampling{2 * MS, 5 * MS, 10 * MS};
+  DeadlineTask* sampler = schedule_deadline_task(sampling, [] {
+    uint64_t until = GenericTimer::now() + GenericTimer::ns_to_counter(WORK_NS);
+    while (GenericTimer::now() < until);
+  }, 1 << 1);
+  if (sampler == nullptr) {
+    testsResult("Deadlines Met Under Load", false);
+    return;
+  }
+
+  wait_ns(FAIR_TEST_RUN_NS);
+  uint64_t completed = sampler->get_completed();
+  uint64_t misses = sampler->get_misses();
+  sampler->stop();
+  for (int core = 0; core < NUM_CORES; core++) hogs[core].stop = 1;
+
+  printf(" Deadline Jobs: %lu, Misses: %lu\n", completed, misses);
+  testsResult("Deadlines Met Under Load",
+              completed >= FAIR_TEST_RUN_NS / (10 * MS) - 5 && misses == 0);
+}
+
+#endif  // SCHEDULER_TESTS_H
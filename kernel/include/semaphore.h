@@ -3,70 +3,100 @@
 
 #include "atomics.h"
 #include "stdint.h"
-#include "queue.h"
-#include "process.h"
+#include "task.h"
 #include "event_loop.h"
-#include "cores.h"
+#include "thread.h"
+#include "wait_queue.h"
 
+/**
+ * @brief Counting semaphore for threads, coroutines and plain events
+ *
+ * count holds the free units, or minus the number of waiters when it is
+ * negative, so an uncontended down() or up() is a single atomic on it. Only
+ * when down() takes count below zero or up() finds it below zero do they take
+ * the lock of waiters, an intrusive list whose nodes live with the waiters,
+ * so the semaphore allocates nothing.
+ *
+ * A waiter has taken its unit off count before it queues itself, so up() may
+ * find the list empty. It then leaves a wakeup that the waiter picks up
+ * instead of queueing.
+ */
 class Semaphore {
-    uint64_t volatile count;
-    SpinLock* lock;
-    LocklessQueue<Process*>* waiting_queue;
-public: 
-    Semaphore(const uint32_t count) : count(count) {
-        lock = new SpinLock();
-        waiting_queue = new LocklessQueue<Process*>();
+    int64_t count;
+    WaitQueue waiters;
+    uint64_t wakeups = 0;  // Units handed to waiters that were not queued yet
+
+    // Checks for a unit handed over before the waiter could queue itself.
+    // Expects waiters to be locked.
+    bool take_wakeup() {
+        if (wakeups == 0) return false;
+        wakeups--;
+        return true;
     }
 
+public:
+    Semaphore(const uint32_t count) : count(count) {}
+
     Semaphore(const Semaphore&) = delete;
 
     void down() {
-        lock->lock();
-
-        if (count > 0) {
-            count--;
-            lock->unlock();
-        }
+        if (__atomic_fetch_sub(&count, 1, __ATOMIC_ACQUIRE) > 0) return;
 
-        else {
-            block();
+        Waiter waiter;
+        waiters.lock();
+        if (take_wakeup()) {
+            waiters.unlock();
+            return;
         }
+        waiters.park(&waiter);
     }
 
-    // Up operation (release semaphore and unblock a thread)
-    void up() {
-        lock->lock();
-        if (!waiting_queue->is_empty()) {
-            // Unblock the next thread from the per-semaphore queue
-            Process* next = waiting_queue->dequeue();
-            if (next == nullptr)  {
-                count++;
+    // co_await form of down() for coroutines
+    struct DownAwaiter {
+        Semaphore* sem;
+        Waiter waiter;
+
+        bool await_ready() { return false; }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            Semaphore* semaphore = sem;
+            if (__atomic_fetch_sub(&semaphore->count, 1, __ATOMIC_ACQUIRE) > 0) {
+                return false;
             }
-            lock->unlock();
-            if (next != nullptr) {
-                unblock(next);
+
+            // up() cannot resume the frame holding this awaiter before the
+            // lock is released, and nothing in the frame is touched after
+            semaphore->waiters.lock();
+            if (semaphore->take_wakeup()) {
+                semaphore->waiters.unlock();
+                return false;
             }
-        } 
-        else {
-            lock->unlock();
+            waiter.continuation = resume_event(handle);
+            semaphore->waiters.append(&waiter);
+            semaphore->waiters.unlock();
+            return true;
         }
-    }
 
-    // Puts current process on a per-sync-prim waiting queue, runs the next free process
-    void block() {
-        waiting_queue->enqueue(activeProcess[SMP::whichCore()]);
-        activeProcess[SMP::whichCore()] = nullptr;
-        lock->unlock();
-        event_loop();
-    }
+        void await_resume() {}
+    };
 
-    // Schedules the passed in process for running
-    void unblock(Process* next) {
-        schedule_event([next](){
-            next->run();
-        });
+    DownAwaiter down_async() {
+        return DownAwaiter{this, {}};
     }
 
+    // Up operation (release semaphore and unblock a thread)
+    void up() {
+        if (__atomic_fetch_add(&count, 1, __ATOMIC_RELEASE) >= 0) return;
+
+        // Hand the unit straight to the next waiter
+        waiters.lock();
+        Waiter* next = waiters.pop();
+        if (next == nullptr) wakeups++;
+        waiters.unlock();
+        if (next != nullptr) {
+            WaitQueue::wake(next);
+        }
+    }
 };
 
 #endif
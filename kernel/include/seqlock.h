@@ -0,0 +1,93 @@
+// Citations
+// https://www.kernel.org/doc/html/latest/locking/seqlock.html
+// https://www.hpl.hp.com/techreports/2012/HPL-2012-68.pdf (seqlock memory ordering)
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include "atomics.h"
+#include "stdint.h"
+
+/**
+ * @brief Sequence lock around a value that is read far more often than it is
+ * written
+ *
+ * Readers take no lock and write nothing: they copy the value between two
+ * reads of the sequence number, and copy it again if a write was in progress
+ * or happened in between. Writers serialize on a spin lock and make the
+ * sequence number odd for the duration of the write.
+ *
+ * Readers may see a torn value before they retry, so T must be trivially
+ * copyable with no pointers that the reader follows, and a read function must
+ * only copy out of the value. A reader never blocks a writer, but a steady
+ * stream of writes can keep a reader retrying.
+ *
+ * A writer that can run in an interrupt handler must be the only writer on
+ * its core, or the other writers must mask interrupts, since an interrupted
+ * writer would deadlock against it.
+ *
+ * @tparam T  type of the protected value
+ */
+template <typename T>
+class SeqLock {
+  uint32_t sequence = 0;  // Odd while a write is in progress
+  SpinLock write_lock;
+  T value;
+
+  uint32_t read_begin() const {
+    return Spin::wait_until(const_cast<uint32_t*>(&sequence),
+                            [](uint32_t s) { return (s & 1) == 0; });
+  }
+
+  bool read_retry(uint32_t begin) const {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&sequence, __ATOMIC_RELAXED) != begin;
+  }
+
+ public:
+  SeqLock() : value() {}
+  explicit SeqLock(const T& value) : value(value) {}
+
+  /**
+   * @brief Returns a consistent copy of the value
+   */
+  T read() const {
+    return read([](const T& current) { return current; });
+  }
+
+  /**
+   * @brief Calls fn on the value until it ran without a write in between, and
+   * returns its result. Cheaper than read() for a few fields of a large
+   * value.
+   */
+  template <typename Fn>
+  auto read(Fn fn) const {
+    while (true) {
+      uint32_t begin = read_begin();
+      auto result = fn(value);
+      if (!read_retry(begin)) return result;
+    }
+  }
+
+  /**
+   * @brief Replaces the value
+   */
+  void write(const T& new_value) {
+    update([&new_value](T& current) { current = new_value; });
+  }
+
+  /**
+   * @brief Calls fn on the value with writers excluded and readers told to
+   * retry
+   */
+  template <typename Fn>
+  void update(Fn fn) {
+    LockGuard<SpinLock> guard(write_lock);
+    __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    fn(value);
+    __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELEASE);
+  }
+};
+
+#endif  // SEQLOCK_H
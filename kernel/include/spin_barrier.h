@@ -0,0 +1,47 @@
+// Citations
+// https://www.cs.rochester.edu/u/scott/papers/1991_TOCS_synch.pdf (sense-reversing centralized barrier)
+// https://developer.arm.com/documentation/ddi0487/latest (WFE and the exclusive monitor)
+
+#ifndef SPIN_BARRIER_H
+#define SPIN_BARRIER_H
+
+#include "atomics.h"
+#include "definitions.h"
+#include "stdint.h"
+
+/**
+ * @brief Reusable barrier for a fixed number of cores that waits in wfe
+ *
+ * The last core to arrive resets the count and flips the barrier to the next
+ * generation, which every waiting core sees as a store to the word its
+ * monitor is armed on. Comparing generations stands in for the per-core
+ * sense flag of a sense-reversing barrier, so callers need no state of their
+ * own and the barrier can be used again right away.
+ *
+ * Waiters spin, so every party must be running on a core of its own (or be
+ * able to preempt the others). Blocking waits belong to Barrier.
+ */
+class SpinBarrier {
+  uint32_t remaining;
+  char pad[CACHE_LINE_SIZE - sizeof(uint32_t)];  // Keeps arrivals off the line the waiters watch
+  uint32_t generation = 0;
+  const uint32_t parties;
+
+ public:
+  explicit SpinBarrier(uint32_t parties) : remaining(parties), pad(), parties(parties) {}
+
+  SpinBarrier(const SpinBarrier&) = delete;
+
+  // Returns once all parties have called sync() for this generation
+  void sync() {
+    uint32_t arrived_in = __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+    if (__atomic_sub_fetch(&remaining, 1, __ATOMIC_ACQ_REL) == 0) {
+      __atomic_store_n(&remaining, parties, __ATOMIC_RELAXED);
+      __atomic_store_n(&generation, arrived_in + 1, __ATOMIC_RELEASE);
+      return;
+    }
+    Spin::wait_until(&generation, [arrived_in](uint32_t g) { return g != arrived_in; });
+  }
+};
+
+#endif  // SPIN_BARRIER_H
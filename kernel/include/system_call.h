@@ -13,6 +13,16 @@
  * 0x08: long write(const char* buffer, long size, int fd);
  * 0x09: long seek(long loc, SeekType seek_type, int fd);
  * 0x0A: int exec(const char* filename, int argc, const char** argv);
+ * 0x0B: int sched_setaffinity(unsigned long core_mask);
+ * 0x0C: long sched_migrations();
+ * 0x0D: long sched_stats(SchedStats::Snapshot* buffer, long size);
+ * 0x0E: int nice(int value);
+ * 0x0F: int sched_setdeadline(unsigned long runtime_ns,
+ *                             unsigned long deadline_ns,
+ *                             unsigned long period_ns);
+ * 0x10: int futex_wait(uint32_t* addr, uint32_t expected,
+ *                      unsigned long timeout_ns);
+ * 0x11: long futex_wake(uint32_t* addr, unsigned long count);
  *
  * CALLING CONVENTION
  *
@@ -105,6 +115,51 @@
  *
  * 0x0A: Executes a given ELF file, currently to be implemented.
  *
+ * 0x0B: Restricts the process to the cores set in core_mask (bit n allows
+ *       core n). If the current core is not in the mask, the process moves
+ *       to an allowed core before the call returns. If successful, it
+ *       returns 0. Possible error is INVALID_ARGUMENT, when the mask allows
+ *       no core.
+ *
+ * 0x0C: Returns the number of times the process has resumed on a different
+ *       core than the one it last ran on. Cannot fail.
+ *
+ * 0x0D: Copies the scheduler statistics of every core (see sched_stats.h for
+ *       the layout) into a buffer of the given size. If successful, it
+ *       returns the number of bytes written. Possible errors are
+ *       INVALID_POINTER, INVALID_IO_SIZE (buffer too small), and
+ *       NOT_IMPLEMENTED when the kernel was built without SCHED_STATS_ENABLED.
+ *
+ * 0x0E: Sets the nice value of the process, from -20 (largest CPU share) to
+ *       19 (smallest), 0 being the default. Each step changes the process's
+ *       share of a busy core by about 25% (see fair_sched.h). If successful,
+ *       it returns 0. Possible error is INVALID_ARGUMENT, when the value is
+ *       out of range.
+ *
+ * 0x0F: Moves the process into the deadline class: every period_ns, it gets
+ *       up to runtime_ns of CPU time within deadline_ns of the start of the
+ *       period, ahead of all other work on the core it is admitted on (see
+ *       deadline_sched.h). Yielding ends the process's current period. A
+ *       runtime_ns of 0 moves the process back to the fair class. If
+ *       successful, it returns 0. Possible errors are INVALID_ARGUMENT,
+ *       unless 0 < runtime_ns <= deadline_ns <= period_ns and period_ns is
+ *       at least 2 ms, and OVERCOMMITTED, when no core the process may run on
+ *       has the bandwidth left.
+ *
+ * 0x10: Blocks the process while the 32-bit word at addr holds expected,
+ *       until a futex_wake on the same word, or until timeout_ns pass if it
+ *       is not 0. The check and the blocking are atomic with respect to
+ *       futex_wake, so a wake after the word changes is never missed. Words
+ *       are matched by physical address (see futex.h). If woken, it returns
+ *       0. Possible errors are INVALID_POINTER, when addr is unaligned or not
+ *       mapped, WOULD_BLOCK, when the word did not hold expected, and
+ *       TIMED_OUT.
+ *
+ * 0x11: Wakes up to count processes blocked in futex_wait on the word at
+ *       addr, oldest first. If successful, it returns the number woken.
+ *       Possible error is INVALID_POINTER, when addr is unaligned or not
+ *       mapped.
+ *
  * TODO finish these descriptions
  *
  * TECHNICALITIES
@@ -150,7 +205,11 @@ namespace Syscall {
     INVALID_POINTER     = 8,
     FILE_NOT_FOUND      = 9,
     FD_OVERFLOW         = 10,
-    DATA_OVERFLOW       = 11
+    DATA_OVERFLOW       = 11,
+    INVALID_ARGUMENT    = 12,
+    OVERCOMMITTED       = 13,
+    WOULD_BLOCK         = 14,
+    TIMED_OUT           = 15
   };
 
   /* Seek types (for the seek system call) */
@@ -1,6 +1,9 @@
 // Citations
 // https://cs140e.sergio.bz/docs/BCM2837-ARM-Peripherals.pdf
 
+#ifndef SYSTEM_TIMER_H
+#define SYSTEM_TIMER_H
+
 #include "stdint.h"
 
 class SystemTimer {
@@ -25,4 +28,7 @@ class SystemTimer {
   static void setup_timer(uint8_t n);
 };
 
-extern volatile uint64_t current_time;
\ No newline at end of file
+// Seconds counted by compare register 0 since setup_timer
+extern volatile uint64_t current_time;
+
+#endif  // SYSTEM_TIMER_H
\ No newline at end of file
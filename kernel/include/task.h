@@ -0,0 +1,204 @@
+// Citations
+// https://lewissbaker.github.io/2020/05/11/understanding_symmetric_transfer
+// https://en.cppreference.com/w/cpp/language/coroutines
+
+#ifndef TASK_H
+#define TASK_H
+
+#include "coroutine.h"
+#include "event_loop.h"
+#include "generic_timer.h"
+#include "printf.h"
+#include "timer_wheel.h"
+
+/**
+ * @brief Event that resumes a suspended coroutine when run
+ */
+inline Event* resume_event(std::coroutine_handle<> handle) {
+  auto resume = [handle] { handle.resume(); };
+  return new EventWithWork<decltype(resume)>(resume);
+}
+
+namespace TaskDetail {
+template <typename T>
+struct PromiseValue {
+  T value{};
+
+  void return_value(T result) { value = result; }
+  T result() { return value; }
+};
+
+template <>
+struct PromiseValue<void> {
+  void return_void() {}
+  void result() {}
+};
+
+template <typename T>
+struct Promise : PromiseValue<T> {
+  std::coroutine_handle<> continuation;  // Coroutine awaiting this task
+  bool detached = false;                 // Frees itself when it finishes
+
+  // Tasks are lazy: nothing runs until the task is awaited or scheduled
+  std::suspend_always initial_suspend() noexcept { return {}; }
+
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+
+    template <typename P>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<P> handle) noexcept {
+      Promise& promise = handle.promise();
+      if (promise.continuation) return promise.continuation;
+      if (promise.detached) handle.destroy();
+      return std::noop_coroutine();
+    }
+
+    void await_resume() noexcept {}
+  };
+
+  FinalAwaiter final_suspend() noexcept { return {}; }
+
+  void unhandled_exception() { Debug::panic("Unhandled exception in task\n"); }
+};
+}  // namespace TaskDetail
+
+/**
+ * @brief Coroutine returning T
+ *
+ * A task only holds its coroutine frame, so any number of them can be
+ * suspended at once without a stack each. Awaiting a task runs it and
+ * continues the awaiting coroutine directly when it finishes. Suspended
+ * tasks are continued from the event loop by whatever they await.
+ *
+ * @tparam T result of the task
+ */
+template <typename T = void>
+class Task {
+ public:
+  struct promise_type : TaskDetail::Promise<T> {
+    Task get_return_object() {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+  };
+
+  using Handle = std::coroutine_handle<promise_type>;
+
+  explicit Task(Handle handle) : handle(handle) {}
+
+  Task(Task&& other) : handle(other.handle) { other.handle = nullptr; }
+
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  ~Task() {
+    if (handle) handle.destroy();
+  }
+
+  struct Awaiter {
+    Handle handle;
+
+    bool await_ready() { return !handle || handle.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) {
+      handle.promise().continuation = caller;
+      return handle;
+    }
+
+    T await_resume() { return handle.promise().result(); }
+  };
+
+  Awaiter operator co_await() { return Awaiter{handle}; }
+
+  /**
+   * @brief Gives up ownership of the coroutine frame
+   */
+  Handle release() {
+    Handle released = handle;
+    handle = nullptr;
+    return released;
+  }
+
+ private:
+  Handle handle;
+};
+
+/**
+ * @brief Starts task from the event loop. The task frees itself when it
+ * finishes.
+ */
+template <typename T>
+void schedule_task(Task<T> task, Priority priority = Priority::Normal) {
+  auto handle = task.release();
+  handle.promise().detached = true;
+  enqueue_event(resume_event(handle), priority);
+}
+
+/**
+ * @brief Suspends until the event loop gets back to this coroutine, letting
+ * other events run in between
+ */
+struct NextEvent {
+  Priority priority;
+
+  bool await_ready() { return false; }
+  void await_suspend(std::coroutine_handle<> handle) {
+    enqueue_event(resume_event(handle), priority);
+  }
+  void await_resume() {}
+};
+
+inline NextEvent next_event(Priority priority = Priority::Normal) {
+  return NextEvent{priority};
+}
+
+/**
+ * @brief Suspends for at least ns nanoseconds
+ */
+struct SleepFor {
+  uint64_t ns;
+
+  bool await_ready() { return false; }
+  void await_suspend(std::coroutine_handle<> handle) {
+    schedule_event_after(ns, [handle] { handle.resume(); });
+  }
+  void await_resume() {}
+};
+
+inline SleepFor sleep_for(uint64_t ns) { return SleepFor{ns}; }
+
+/**
+ * @brief Suspends until done() returns true, checking it every interval_ns.
+ * For I/O that completes by setting a status bit rather than raising an
+ * interrupt.
+ */
+template <typename Done>
+struct PollUntil {
+  Done done;
+  uint64_t interval_ns;
+
+  bool await_ready() { return done(); }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    schedule_event_after(interval_ns, [this, handle] { check(this, handle); });
+  }
+
+  static void check(PollUntil* self, std::coroutine_handle<> handle) {
+    if (self->done()) {
+      handle.resume();
+    } else {
+      schedule_event_after(self->interval_ns,
+                           [self, handle] { check(self, handle); });
+    }
+  }
+
+  void await_resume() {}
+};
+
+template <typename Done>
+PollUntil<Done> poll_until(Done done,
+                           uint64_t interval_ns = GenericTimer::NS_PER_TICK) {
+  return PollUntil<Done>{done, interval_ns};
+}
+
+#endif  // TASK_H
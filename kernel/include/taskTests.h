@@ -0,0 +1,151 @@
+#ifndef TASK_TESTS_H
+#define TASK_TESTS_H
+
+#include "atomics.h"
+#include "future.h"
+#include "generic_timer.h"
+#include "printf.h"
+#include "semaphore.h"
+#include "task.h"
+#include "testFramework.h"
+
+Task<int> taskSquare(int x) {
+  co_await next_event();
+  co_return x * x;
+}
+
+Task<> taskSumSquares(int n, Atomic<int>* result) {
+  int sum = 0;
+  for (int i = 1; i <= n; i++) {
+    sum += co_await taskSquare(i);
+  }
+  result->store(sum);
+}
+
+Task<> taskSleep(uint64_t ns, Atomic<uint64_t>* woke_at) {
+  co_await sleep_for(ns);
+  woke_at->store(GenericTimer::now());
+}
+
+Task<> taskDown(Semaphore* sem, Atomic<int>* passed) {
+  co_await sem->down_async();
+  passed->add_fetch(1);
+}
+
+Task<> taskGetFuture(Future<int>* future, Atomic<int>* total) {
+  int value = co_await future->get_async();
+  total->add_fetch(value);
+}
+
+Task<> taskPoll(Atomic<bool>* flag, Atomic<int>* polls, Atomic<bool>* seen) {
+  co_await poll_until([flag, polls] {
+    polls->add_fetch(1);
+    return flag->load();
+  });
+  seen->store(true);
+}
+
+void taskTests() {
+  initTests("Task Tests");
+
+  constexpr uint64_t MS = 1000000;
+
+  // Spins until done() holds or timeout_ns passes, returning done()
+  auto wait_for = [](auto done, uint64_t timeout_ns) {
+    uint64_t until = GenericTimer::now() + GenericTimer::ns_to_counter(timeout_ns);
+    while (!done() && GenericTimer::now() < until) {
+    }
+    return done();
+  };
+
+  // Test 1: Tasks awaiting tasks return their results
+  Atomic<int> sum(0);
+  schedule_task(taskSumSquares(10, &sum));
+  while (sum.load() == 0) {
+  }
+
+  testsResult("Awaited tasks return values", sum.load() == 385);
+
+  // Test 2: Sleeping suspends for at least the delay
+  Atomic<uint64_t> woke_at(0);
+  uint64_t slept_at = GenericTimer::now();
+  schedule_task(taskSleep(5 * MS, &woke_at));
+  while (woke_at.load() == 0) {
+  }
+
+  testsResult("Sleep waits for its delay",
+              woke_at.load() - slept_at >= GenericTimer::ns_to_counter(5 * MS));
+
+  // Test 3: Coroutines waiting on a semaphore are released one by one
+  constexpr int WAITERS = 20;
+  Semaphore* sem = new Semaphore(0);
+  Atomic<int> passed(0);
+  for (int i = 0; i < WAITERS; i++) {
+    schedule_task(taskDown(sem, &passed));
+  }
+
+  bool none_early = passed.load() == 0;
+  for (int i = 0; i < WAITERS; i++) {
+    sem->up();
+  }
+  while (passed.load() < WAITERS) {
+  }
+
+  testsResult("Semaphore releases waiting coroutines", none_early);
+
+  // Test 4: Awaiting a future
+  Future<int>* future = new Future<int>();
+  Atomic<int> total(0);
+  for (int i = 0; i < 10; i++) {
+    schedule_task(taskGetFuture(future, &total));
+  }
+  future->set(2);
+  while (total.load() < 20) {
+  }
+
+  testsResult("Coroutines await a future", total.load() == 20);
+
+  // Test 5: Polled completion. The flag is only set once the coroutine has
+  // polled it again after suspending.
+  Atomic<bool> flag(false);
+  Atomic<int> polls(0);
+  Atomic<bool> seen(false);
+  schedule_task(taskPoll(&flag, &polls, &seen));
+  bool suspended = wait_for([&] { return polls.load() >= 2; }, 1000 * MS);
+  bool early = seen.load();
+  flag.store(true);
+  bool resumed = wait_for([&] { return seen.load(); }, 1000 * MS);
+
+  testsResult("Polled completion resumes coroutine",
+              suspended && !early && resumed && polls.load() >= 3);
+
+  // Test 6: Many operations in flight without a stack each
+  constexpr int IN_FLIGHT = 200;
+  Atomic<uint64_t>* wakes = new Atomic<uint64_t>[IN_FLIGHT];
+  uint64_t sleeps_at = GenericTimer::now();
+  for (int i = 0; i < IN_FLIGHT; i++) {
+    wakes[i].store(0);
+    schedule_task(taskSleep(10 * MS, &wakes[i]));
+  }
+  bool all_woke = wait_for([&] {
+    for (int i = 0; i < IN_FLIGHT; i++) {
+      if (wakes[i].load() == 0) return false;
+    }
+    return true;
+  }, 1000 * MS);
+  bool slept = true;
+  for (int i = 0; i < IN_FLIGHT; i++) {
+    if (wakes[i].load() - sleeps_at < GenericTimer::ns_to_counter(10 * MS)) {
+      slept = false;
+    }
+  }
+
+  testsResult("Hundreds of sleeping coroutines complete", all_woke && slept);
+
+  // Sleepers that missed the timeout would still write into wakes
+  if (all_woke) delete[] wakes;
+  delete future;
+  delete sem;
+}
+
+#endif
@@ -1,6 +1,12 @@
 #ifndef TESTFRAMEWORK_H
 #define TESTFRAMEWORK_H
 
+#include "atomics.h"
+#include "cores.h"
+#include "event_loop.h"
+#include "generic_timer.h"
+#include "machine.h"
+#include "preempt.h"
 #include "printf.h"
 
 const char* testsName;
@@ -22,4 +28,68 @@ void testsResult(const char* testName, bool success) {
   count++;
 }
 
+// Prints a benchmark measurement of ops operations taking ticks generic timer
+// ticks in total
+void benchResult(const char* benchName, uint64_t ops, uint64_t ticks) {
+  uint64_t ns = ticks * 1000000000 / get_CNTFRQ_EL0();
+  printf(" %s Bench: %s: %lu ops in %lu us (%lu ns/op)\n", testsName,
+         benchName, ops, ns / 1000, ops == 0 ? 0 : ns / ops);
+}
+
+// How long a test waits on work running elsewhere before it gives up
+constexpr uint64_t LOCK_BENCHMARK_TIMEOUT_NS = 10'000'000'000;
+
+// Shared by the cores taking part in one benchmark run
+struct BenchmarkRun {
+  int cores;
+  uint64_t start = 0;  // Set by the last core to arrive
+  Atomic<int> arrived;
+  Atomic<int> finished;
+
+  explicit BenchmarkRun(int cores) : cores(cores) {}
+};
+
+// Waits for every core to arrive, then runs work(index)
+template <typename Work>
+void benchmark_worker(BenchmarkRun* run, int index, const Work& work) {
+  if (run->arrived.add_fetch(1) == run->cores) {
+    __atomic_store_n(&run->start, GenericTimer::now(), __ATOMIC_RELEASE);
+  }
+  while (run->arrived.load() < run->cores);
+
+  work(index);
+  run->finished.add_fetch(1);
+}
+
+// Runs work(index) for every index below cores at once, index 0 on the
+// current core and the others pinned to other cores. Returns the counter
+// ticks from when all had arrived until all had finished, or 0 if some never
+// finished, in which case whatever work refers to must be left allocated.
+template <typename Work>
+uint64_t run_on_cores(int cores, Work work) {
+  BenchmarkRun* run = new BenchmarkRun(cores);
+
+  // Keeps the current core to itself while the others are pinned elsewhere
+  PreemptGuard guard;
+  uint8_t self = SMP::whichCore();
+  int index = 1;
+  for (uint8_t core = 0; core < NUM_CORES && index < cores; core++) {
+    if (core == self) continue;
+    auto pinned = [run, index, work] { benchmark_worker(run, index, work); };
+    Event* event = new EventWithWork<decltype(pinned)>(pinned);
+    event->core_mask = 1 << core;
+    enqueue_event_on(core, event, Priority::Normal);
+    index++;
+  }
+
+  benchmark_worker(run, 0, work);
+  uint64_t until = GenericTimer::now() + GenericTimer::ns_to_counter(LOCK_BENCHMARK_TIMEOUT_NS);
+  while (run->finished.load() < cores && GenericTimer::now() < until);
+  if (run->finished.load() < cores) return 0;
+
+  uint64_t elapsed = GenericTimer::now() - __atomic_load_n(&run->start, __ATOMIC_ACQUIRE);
+  delete run;
+  return elapsed == 0 ? 1 : elapsed;
+}
+
 #endif
@@ -1,17 +1,33 @@
 #ifndef TESTER_H
 #define TESTER_H
 
+#include "channelTests.h"
 #include "cores.h"
 #include "elfTests.h"
 #include "eventTests.h"
+#include "futexTests.h"
 #include "hashmapTests.h"
 #include "heapTests.h"
+#include "lockTests.h"
+#include "parallelTests.h"
 #include "primitives_tests.h"
+#include "queueTests.h"
+#include "schedulerTests.h"
 #include "sdTests.h"
+#include "taskTests.h"
+#include "threadTests.h"
 
 void runTests() {
   elfTests();
+  schedulerTests();
+  futexTests();
+  lockTests();
+  channelTests();
   eventLoopTests();
+  queueTests();
+  threadTests();
+  taskTests();
+  parallelTests();
   // hashmapTests();
 
   // When running the bfs tests, you have to remake test.dd so that it isn't
@@ -26,7 +42,7 @@ void runTests() {
 
 void setupTests() {
   schedule_event([] {
-    while (SMP::startedCores.load() < 4);
+    while (SMP::startedCores.load<__ATOMIC_ACQUIRE>() < 4);
     runTests();
   });
 }
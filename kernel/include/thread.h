@@ -0,0 +1,125 @@
+// Citations
+// https://developer.arm.com/documentation/102374/0102/Procedure-Call-Standard
+
+#ifndef THREAD_H
+#define THREAD_H
+
+#include "event_loop.h"
+#include "stdint.h"
+
+class Process;
+class Thread;
+
+/**
+ * @brief Thread control block: what context_switch saves and restores
+ *
+ * The callee-saved registers (x19-x30, d8-d15) are pushed onto the thread's
+ * own stack, so only the stack pointer needs to live here.
+ */
+struct TCB {
+  uint64_t saved_sp;
+  Process* active_process;  // Process whose address space the thread runs in
+  uint64_t ttbr0;
+};
+
+extern "C" void context_switch(TCB* from, TCB* to);
+
+// First thing a new thread runs, entered from context_switch
+extern "C" [[noreturn]] void thread_start(Thread* thread);
+
+/**
+ * @brief Kernel thread with its own stack
+ *
+ * A thread is run by an event: the event switches from the event loop's stack
+ * to the thread's stack and gets control back once the thread blocks or
+ * finishes. A blocked thread keeps its whole call stack, and waking it up
+ * queues that event again, so it continues on whichever core picks it up.
+ *
+ * Threads are detached and free their stack and themselves when their work
+ * returns, once the event that ran them is done with them.
+ */
+class Thread {
+  TCB tcb;
+  TCB* return_tcb;  // Event that switched the thread in
+  uint8_t* stack;
+  Event* work;
+  Event* resume_event;
+  Priority priority;
+  bool finished;
+
+  // Run on the event loop's stack once the thread has been switched out
+  void (*after_switch)(void*);
+  void* after_switch_arg;
+
+  Thread(Event* work, uint8_t* stack, Priority priority);
+  ~Thread();
+
+  void switch_in();
+  void switch_out();
+
+  static Thread* spawn_event(Event* work, Priority priority);
+  static void block_with(void (*after_switch)(void*), void* arg);
+
+  friend void thread_start(Thread* thread);
+
+ public:
+  Thread(const Thread&) = delete;
+  Thread& operator=(const Thread&) = delete;
+
+  /**
+   * @brief Starts a new thread running work
+   *
+   * @return the thread, or nullptr if there was no memory for its stack, in
+   *         which case work is dropped without running
+   */
+  template <typename Work>
+  static Thread* spawn(Work work, Priority priority = Priority::Normal) {
+    return spawn_event(new EventWithWork<Work>(work), priority);
+  }
+
+  /**
+   * @brief Thread running on the current core, or nullptr if the core is
+   * running a plain event
+   */
+  static Thread* current();
+
+  /**
+   * @brief Parks the current thread. Once its stack is no longer in use,
+   * after_switch() runs on the event loop's stack; it is the place to publish
+   * the thread (e.g. to a wait queue) and drop locks, since another core may
+   * wake the thread as soon as it is published.
+   *
+   * Must be called from a thread.
+   */
+  template <typename AfterSwitch>
+  static void block(AfterSwitch after_switch) {
+    block_with([](void* arg) { (*static_cast<AfterSwitch*>(arg))(); },
+               &after_switch);
+  }
+
+  /**
+   * @brief Lets other ready events run before continuing
+   */
+  static void yield();
+
+  /**
+   * @brief Queues the thread to continue after block()
+   */
+  void wake();
+
+  /**
+   * @brief The event that continues this thread, for wait queues that hold
+   * continuations
+   */
+  Event* continuation() { return resume_event; }
+
+  Priority get_priority() const { return priority; }
+
+  /**
+   * @brief Records the current thread for this core. Used when a preempted
+   * thread is resumed elsewhere.
+   */
+  static void set_current(Thread* thread);
+};
+
+#endif  // THREAD_H
@@ -0,0 +1,134 @@
+#ifndef THREAD_TESTS_H
+#define THREAD_TESTS_H
+
+#include "atomics.h"
+#include "definitions.h"
+#include "event_loop.h"
+#include "printf.h"
+#include "semaphore.h"
+#include "testFramework.h"
+#include "thread.h"
+
+// Recurses depth frames deep, blocks on sem in the deepest frame and then
+// unwinds, so the result is only right if every frame survived the block
+int blockingSum(Semaphore* sem, int depth) {
+  if (depth == 0) {
+    sem->down();
+    return 0;
+  }
+  volatile int local = depth;
+  return local + blockingSum(sem, depth - 1);
+}
+
+void threadTests() {
+  initTests("Thread Tests");
+
+  // Test 1: A spawned thread runs its work on its own stack
+  Atomic<bool> ran(false);
+  Atomic<bool> had_thread(false);
+  Thread::spawn([&] {
+    had_thread.store(Thread::current() != nullptr);
+    ran.store(true);
+  });
+
+  while (!ran.load()) {
+  }
+
+  testsResult("Spawned thread runs", had_thread.load());
+
+  // Test 2: Blocking keeps the whole call stack
+  constexpr int DEPTH = 50;
+  Semaphore* sem = new Semaphore(0);
+  Atomic<int> sum(-1);
+  Thread::spawn([&] { sum.store(blockingSum(sem, DEPTH)); });
+
+  // The thread is parked, so plain events must still get to run
+  Atomic<bool> event_ran(false);
+  schedule_event([&] { event_ran.store(true); });
+  while (!event_ran.load()) {
+  }
+
+  sem->up();
+  while (sum.load() == -1) {
+  }
+
+  testsResult("Blocked thread keeps its stack",
+              sum.load() == DEPTH * (DEPTH + 1) / 2);
+
+  // Test 3: Two threads ping-pong through a pair of semaphores
+  constexpr int ROUNDS = 100;
+  Semaphore* ping = new Semaphore(0);
+  Semaphore* pong = new Semaphore(0);
+  Atomic<int> rounds(0);
+  Atomic<int> done(0);
+
+  Thread::spawn([&] {
+    for (int i = 0; i < ROUNDS; i++) {
+      ping->up();
+      pong->down();
+    }
+    done.add_fetch(1);
+  });
+  Thread::spawn([&] {
+    for (int i = 0; i < ROUNDS; i++) {
+      ping->down();
+      rounds.add_fetch(1);
+      pong->up();
+    }
+    done.add_fetch(1);
+  });
+
+  while (done.load() < 2) {
+  }
+
+  testsResult("Threads ping-pong through semaphores", rounds.load() == ROUNDS);
+
+  // Test 4: More blocked threads than cores do not use up the cores
+  constexpr int WAITERS = 4 * NUM_CORES;
+  Semaphore* gate = new Semaphore(0);
+  Atomic<int> woken(0);
+  for (int i = 0; i < WAITERS; i++) {
+    Thread::spawn([&] {
+      gate->down();
+      woken.add_fetch(1);
+    });
+  }
+
+  event_ran.store(false);
+  schedule_event([&] { event_ran.store(true); });
+  while (!event_ran.load()) {
+  }
+
+  for (int i = 0; i < WAITERS; i++) {
+    gate->up();
+  }
+  while (woken.load() < WAITERS) {
+  }
+
+  testsResult("Blocked threads leave cores free", woken.load() == WAITERS);
+
+  // Test 5: Yielding threads interleave
+  Atomic<int> yields(0);
+  done.store(0);
+  for (int t = 0; t < 2; t++) {
+    Thread::spawn([&] {
+      for (int i = 0; i < 10; i++) {
+        yields.add_fetch(1);
+        Thread::yield();
+      }
+      done.add_fetch(1);
+    });
+  }
+
+  while (done.load() < 2) {
+  }
+
+  testsResult("Threads yield and continue", yields.load() == 20);
+
+  delete sem;
+  delete ping;
+  delete pong;
+  delete gate;
+}
+
+#endif
@@ -0,0 +1,105 @@
+// Citations
+// https://www.cs.columbia.edu/~nahum/w6998/papers/sosp87-timing-wheels.pdf
+// https://lwn.net/Articles/152436/
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include "event_loop.h"
+#include "generic_timer.h"
+#include "stdint.h"
+
+/**
+ * @brief A pending timer. Timers are recycled by the wheel that owns them, so
+ * a Timer is never freed while a TimerHandle to it may exist.
+ */
+struct Timer {
+  Event* event;
+  uint64_t expires;     // Wheel tick the timer fires on
+  uint64_t period;      // Wheel ticks between firings, 0 for one-shot
+  uint64_t generation;  // Bumped every time the timer is recycled
+  Priority priority;
+  uint8_t core;         // Wheel that owns this timer
+  bool pending;
+  Timer* next;
+  Timer* prev;
+  Timer** list;         // Slot list the timer is linked into
+};
+
+/**
+ * @brief Identifies one arming of a timer. Stale handles are detected through
+ * the generation, so cancelling a timer that already fired is harmless.
+ */
+struct TimerHandle {
+  Timer* timer;
+  uint64_t generation;
+};
+
+/**
+ * @brief Per-core hierarchical timer wheel
+ *
+ * Each core owns LEVELS wheels of SLOTS slots. Level n covers delays of up to
+ * SLOTS^(n + 1) ticks, and a timer is moved one level down whenever the level
+ * below it wraps around. Longer delays go round the top level again until they
+ * are in reach. Insertion and cancellation are O(1).
+ */
+namespace TimerWheel {
+constexpr int SLOT_BITS = 6;
+constexpr int SLOTS = 1 << SLOT_BITS;
+constexpr int LEVELS = 4;
+
+/**
+ * @brief Arms event on the current core's wheel, restarting its tick if the
+ * core had stopped it to go idle
+ *
+ * @param event      event queued at priority when the timer fires
+ * @param delay_ns   time until the first firing
+ * @param period_ns  time between later firings, or 0 for a one-shot timer.
+ *                   A firing is skipped while the last one is still queued or
+ *                   running, so event never runs concurrently with itself.
+ */
+TimerHandle add(Event* event, uint64_t delay_ns, uint64_t period_ns,
+                Priority priority);
+
+/**
+ * @brief Cancels a timer if it has not fired (or, when periodic, at all).
+ * The event is deleted, or for a periodic timer whose event is still queued
+ * or running, deleted once that run finishes.
+ *
+ * @return true   the timer was pending and will not fire again
+ * @return false  the handle is stale
+ */
+bool cancel(TimerHandle handle);
+
+/**
+ * @brief Checks if the current core's wheel has no pending timers
+ */
+bool is_empty();
+
+/**
+ * @brief Advances the current core's wheel by one tick and queues every
+ * expired timer's event. Called from the timer interrupt.
+ */
+void tick();
+}  // namespace TimerWheel
+
+/**
+ * @brief Runs work once, delay_ns from now
+ */
+template <typename Work>
+TimerHandle schedule_event_after(uint64_t delay_ns, Work work,
+                                 Priority priority = Priority::Normal) {
+  return TimerWheel::add(new EventWithWork<Work>(work), delay_ns, 0, priority);
+}
+
+/**
+ * @brief Runs work every period_ns, starting period_ns from now
+ */
+template <typename Work>
+TimerHandle schedule_event_every(uint64_t period_ns, Work work,
+                                 Priority priority = Priority::Normal) {
+  return TimerWheel::add(new EventWithWork<Work>(work), period_ns, period_ns,
+                         priority);
+}
+
+#endif  // TIMER_WHEEL_H
@@ -3,4 +3,7 @@
 
 extern "C" void uart_putc(char c);
 
+// Returns the next received character, or -1 if none is waiting
+extern "C" int uart_try_getc();
+
 #endif
\ No newline at end of file
@@ -0,0 +1,58 @@
+// Citations
+// https://en.cppreference.com/w/cpp/header/utility
+// https://en.cppreference.com/w/cpp/memory/new/operator_new (placement new)
+
+#ifndef UTILITY_H
+#define UTILITY_H
+
+#include "stdint.h"
+
+/**
+ * Freestanding replacement for std::move, std::forward and std::declval,
+ * which live in namespace std so that GCC still treats them as the casts they
+ * are, for the std::align_val_t that new of an over-aligned type passes to
+ * the operator new in heap.cpp, and for placement new, which heap.cpp does
+ * not cover.
+ */
+namespace std {
+enum class align_val_t : size_t {};
+
+template <typename T>
+struct remove_reference {
+  using type = T;
+};
+
+template <typename T>
+struct remove_reference<T&> {
+  using type = T;
+};
+
+template <typename T>
+struct remove_reference<T&&> {
+  using type = T;
+};
+
+template <typename T>
+constexpr typename remove_reference<T>::type&& move(T&& value) noexcept {
+  return static_cast<typename remove_reference<T>::type&&>(value);
+}
+
+template <typename T>
+constexpr T&& forward(typename remove_reference<T>::type& value) noexcept {
+  return static_cast<T&&>(value);
+}
+
+template <typename T>
+constexpr T&& forward(typename remove_reference<T>::type&& value) noexcept {
+  return static_cast<T&&>(value);
+}
+
+// Only for unevaluated operands such as decltype, so it has no definition
+template <typename T>
+T&& declval() noexcept;
+}  // namespace std
+
+inline void* operator new(size_t, void* place) noexcept { return place; }
+inline void* operator new[](size_t, void* place) noexcept { return place; }
+
+#endif  // UTILITY_H
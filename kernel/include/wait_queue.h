@@ -0,0 +1,129 @@
+#ifndef _WAIT_QUEUE_H_
+#define _WAIT_QUEUE_H_
+
+#include "atomics.h"
+#include "event_loop.h"
+#include "stdint.h"
+#include "thread.h"
+
+/**
+ * @brief A blocked thread, coroutine or plain event in a WaitQueue
+ *
+ * Lives on the waiter's stack or in its coroutine frame, so queueing
+ * allocates nothing. It may be gone as soon as WaitQueue::wake returns.
+ */
+struct Waiter {
+    Waiter* next = nullptr;
+    Event* continuation = nullptr;  // nullptr for a polling event
+    uint32_t woken = 0;             // Set for a polling event
+};
+
+/**
+ * @brief FIFO of waiters behind a spin lock, shared by the blocking
+ * primitives
+ *
+ * The lock also guards whatever state the primitive decides to wait on, so a
+ * wakeup cannot slip in between checking that state and queueing. Every
+ * function except lock() and wake() expects the lock to be held.
+ */
+class WaitQueue {
+    SpinLock own_guard;
+    SpinLock* const guard;
+    Waiter* head = nullptr;
+    Waiter* tail = nullptr;
+
+public:
+    WaitQueue() : guard(&own_guard) {}
+
+    // Shares guard with other queues and state of the owner, which then only
+    // need one lock between them
+    explicit WaitQueue(SpinLock& shared) : guard(&shared) {}
+
+    WaitQueue(const WaitQueue&) = delete;
+
+    void lock() { guard->lock(); }
+    void unlock() { guard->unlock(); }
+
+    bool empty() const { return head == nullptr; }
+
+    void append(Waiter* waiter) {
+        waiter->next = nullptr;
+        if (tail != nullptr) {
+            tail->next = waiter;
+        } else {
+            head = waiter;
+        }
+        tail = waiter;
+    }
+
+    Waiter* pop() {
+        Waiter* waiter = head;
+        if (waiter != nullptr) {
+            head = waiter->next;
+            if (head == nullptr) tail = nullptr;
+        }
+        return waiter;
+    }
+
+    // Empties the queue, returning its waiters linked through next
+    Waiter* take_all() {
+        Waiter* waiters = head;
+        head = nullptr;
+        tail = nullptr;
+        return waiters;
+    }
+
+    /**
+     * @brief Queues waiter, runs release, unlocks the queue and returns once
+     * the waiter was woken
+     *
+     * A thread is parked, and only queued once it is off its stack so that a
+     * wake cannot resume it early. A plain event has no stack of its own to
+     * park, so it waits in wfe for its waiter to be marked (and can still be
+     * preempted while it does).
+     */
+    template <typename Release>
+    void park(Waiter* waiter, Release release) {
+        Thread* self = Thread::current();
+        if (self != nullptr) {
+            Thread::block([this, self, waiter, &release] {
+                waiter->continuation = self->continuation();
+                append(waiter);
+                release();
+                unlock();
+            });
+        }
+        else {
+            append(waiter);
+            release();
+            unlock();
+            Spin::wait_until(&waiter->woken, [](uint32_t woken) { return woken != 0; });
+        }
+    }
+
+    void park(Waiter* waiter) {
+        park(waiter, [] {});
+    }
+
+    // Schedules the waiter's continuation for running, or tells a polling
+    // event to go on. Called without the lock, after popping the waiter.
+    static void wake(Waiter* waiter) {
+        Event* next = waiter->continuation;
+        if (next != nullptr) {
+            enqueue_event(next, Priority::Normal);
+        } else {
+            __atomic_store_n(&waiter->woken, 1, __ATOMIC_RELEASE);
+        }
+    }
+
+    // Wakes every waiter of a list returned by take_all()
+    static void wake_all(Waiter* waiters) {
+        while (waiters != nullptr) {
+            Waiter* next = waiters->next;
+            wake(waiters);
+            waiters = next;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,137 @@
+#include "atomics.h"
+
+#include "cores.h"
+#include "definitions.h"
+#include "printf.h"
+
+// Most McsLocks a core may hold or wait on at once
+constexpr int MCS_NODES_PER_CORE = 8;
+constexpr uint32_t ALL_MCS_NODES = (1u << MCS_NODES_PER_CORE) - 1;
+
+// Every node on its own cache line, since waiters spin on them
+struct alignas(CACHE_LINE_SIZE) McsSlot {
+  McsNode node;
+};
+
+static McsSlot mcs_slots[NUM_CORES][MCS_NODES_PER_CORE];
+
+// Bit i is set while mcs_slots[core][i] is in use. Only the owning core
+// changes it, but an interrupt may take a node in between.
+static uint32_t mcs_nodes_in_use[NUM_CORES];
+
+static McsNode* claim_node() {
+  uint8_t core = SMP::whichCore();
+  uint32_t* in_use = &mcs_nodes_in_use[core];
+  while (true) {
+    uint32_t used = __atomic_load_n(in_use, __ATOMIC_RELAXED);
+    ASSERT(used != ALL_MCS_NODES);
+    uint32_t bit = 1u << __builtin_ctz(~used);
+    if (!(__atomic_fetch_or(in_use, bit, __ATOMIC_RELAXED) & bit)) {
+      return &mcs_slots[core][__builtin_ctz(bit)].node;
+    }
+  }
+}
+
+static void release_node(McsNode* node) {
+  size_t index = (McsSlot*) node - &mcs_slots[0][0];
+  uint32_t bit = 1u << (index % MCS_NODES_PER_CORE);
+  __atomic_fetch_and(&mcs_nodes_in_use[index / MCS_NODES_PER_CORE], ~bit,
+                     __ATOMIC_RELAXED);
+}
+
+void McsLock::lock() {
+  Preempt::disable();
+  McsNode* node = claim_node();
+  node->next = nullptr;
+  node->locked = 1;
+
+  McsNode* previous = __atomic_exchange_n(&tail, node, __ATOMIC_ACQ_REL);
+  if (previous != nullptr) {
+    __atomic_store_n(&previous->next, node, __ATOMIC_RELEASE);
+    Spin::wait_until(&node->locked, [](uint32_t locked) { return locked == 0; });
+  }
+  holder = node;
+}
+
+void McsLock::unlock() {
+  McsNode* node = holder;
+  McsNode* next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+  if (next == nullptr) {
+    McsNode* expected = node;
+    if (__atomic_compare_exchange_n(&tail, &expected, nullptr, false,
+                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+      release_node(node);
+      Preempt::enable();
+      return;
+    }
+
+    // A waiter has queued itself behind this node but not linked it yet
+    next = Spin::wait_until(&node->next, [](McsNode* next) { return next != nullptr; });
+  }
+
+  __atomic_store_n(&next->locked, 0, __ATOMIC_RELEASE);
+  release_node(node);
+  Preempt::enable();
+}
+
+void BigReaderLock::read_lock() {
+  Preempt::disable();
+  uint32_t* count = &readers[SMP::whichCore()].count;
+
+  // Already reading on this core, so a writer is waiting on this count anyway
+  if (__atomic_load_n(count, __ATOMIC_RELAXED) != 0) {
+    __atomic_fetch_add(count, 1, __ATOMIC_RELAXED);
+    probe.shared_acquired(0, false);
+    return;
+  }
+
+  uint64_t waiting_since = probe.now();
+  bool contended = false;
+  while (true) {
+    // Published before checking for a writer, which sets its flag before
+    // checking the counts, so at least one of the two sees the other
+    __atomic_fetch_add(count, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&writer, __ATOMIC_SEQ_CST) == 0) break;
+
+    __atomic_fetch_sub(count, 1, __ATOMIC_RELEASE);
+    contended = true;
+    Spin::wait_until(&writer, [](uint32_t w) { return w == 0; });
+  }
+  probe.shared_acquired(waiting_since, contended);
+}
+
+void BigReaderLock::read_unlock() {
+  __atomic_fetch_sub(&readers[SMP::whichCore()].count, 1, __ATOMIC_RELEASE);
+  Preempt::enable();
+}
+
+void BigReaderLock::write_lock() {
+  Preempt::disable();
+  uint64_t waiting_since = probe.now();
+  bool contended = false;
+  while (true) {
+    uint32_t expected = 0;
+    if (__atomic_compare_exchange_n(&writer, &expected, 1, false,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+      break;
+    }
+    contended = true;
+    Spin::wait_until(&writer, [](uint32_t w) { return w == 0; });
+  }
+
+  // Pairs with the readers publishing their count before checking writer
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  for (int core = 0; core < NUM_CORES; core++) {
+    if (LockStats::ENABLED && __atomic_load_n(&readers[core].count, __ATOMIC_RELAXED) != 0) {
+      contended = true;
+    }
+    Spin::wait_until(&readers[core].count, [](uint32_t count) { return count == 0; });
+  }
+  probe.acquired(waiting_since, contended);
+}
+
+void BigReaderLock::write_unlock() {
+  probe.released();
+  __atomic_store_n(&writer, 0, __ATOMIC_RELEASE);
+  Preempt::enable();
+}
@@ -1,33 +1,44 @@
 .section .text
-.global save_context
-.global restore_context
+.global context_switch
+.global thread_trampoline
 
-// void save_context(TCB* tcb)
-save_context:
-    mov x9, sp     // Load TCB pointer into x9
-    str x9, [x0, #16]  // Save SP to tcb->savedSP (offset 8 bytes from tcb base)
-
-    // Save General-Purpose Registers (Callee-Saved)
-    stp x19, x20, [sp, #-16]!
-    stp x21, x22, [sp, #-16]!
-    stp x23, x24, [sp, #-16]!
-    stp x25, x26, [sp, #-16]!
-    stp x27, x28, [sp, #-16]!
+// void context_switch(TCB* from, TCB* to)
+// Pushes the callee-saved registers onto the current stack, saves the stack
+// pointer to from->saved_sp and pops the registers saved on to's stack
+context_switch:
     stp x29, x30, [sp, #-16]!
+    stp x27, x28, [sp, #-16]!
+    stp x25, x26, [sp, #-16]!
+    stp x23, x24, [sp, #-16]!
+    stp x21, x22, [sp, #-16]!
+    stp x19, x20, [sp, #-16]!
+    stp d14, d15, [sp, #-16]!
+    stp d12, d13, [sp, #-16]!
+    stp d10, d11, [sp, #-16]!
+    stp d8, d9, [sp, #-16]!
 
-    ret
-
-// void restore_context(TCB* tcb)
-restore_context:
-    ldr x9, [x0, #16]  // Restore SP from tcb->savedSP
+    mov x9, sp
+    str x9, [x0]       // from->saved_sp (offset 0)
+    ldr x9, [x1]       // to->saved_sp
     mov sp, x9
 
-    // Restore General-Purpose Registers
-    ldp x29, x30, [sp], #16
-    ldp x27, x28, [sp], #16
-    ldp x25, x26, [sp], #16
-    ldp x23, x24, [sp], #16
-    ldp x21, x22, [sp], #16
+    ldp d8, d9, [sp], #16
+    ldp d10, d11, [sp], #16
+    ldp d12, d13, [sp], #16
+    ldp d14, d15, [sp], #16
     ldp x19, x20, [sp], #16
+    ldp x21, x22, [sp], #16
+    ldp x23, x24, [sp], #16
+    ldp x25, x26, [sp], #16
+    ldp x27, x28, [sp], #16
+    ldp x29, x30, [sp], #16
 
     ret
+
+// Where a new thread's first context_switch returns to, with the Thread* in
+// x19
+thread_trampoline:
+    mov x0, x19
+    bl thread_start
+1:
+    b 1b
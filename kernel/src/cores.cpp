@@ -3,6 +3,7 @@
 #include "definitions.h"
 #include "devices.h"
 #include "event_loop.h"
+#include "generic_timer.h"
 #include "machine.h"
 #include "printf.h"
 #include "stdint.h"
@@ -14,6 +15,7 @@
  */
 namespace SMP {
 Atomic<int> startedCores = Atomic<int>(0);
+SpinBarrier bootBarrier(NUM_CORES);
 
 uint8_t stack0[STACK_SIZE] __attribute__((aligned(16)));
 extern "C" uint8_t* stack0_top;
@@ -37,33 +39,42 @@ extern "C" void _start_core3();
 
 extern "C" void initCore1() {
   debug_printf("Core %d! %s\n", whichCore(), STRING_EL(get_CurrentEL()));
-  startedCores.add_fetch(1);
+  startedCores.add_fetch<__ATOMIC_RELEASE>(1);
 
   VMM::init_core();
+  bootBarrier.sync();
+
+  GenericTimer::init_core();
 
   event_loop();
 }
 
 extern "C" void initCore2() {
   debug_printf("Core %d! %s\n", whichCore(), STRING_EL(get_CurrentEL()));
-  startedCores.add_fetch(1);
+  startedCores.add_fetch<__ATOMIC_RELEASE>(1);
 
   VMM::init_core();
+  bootBarrier.sync();
+
+  GenericTimer::init_core();
 
   event_loop();
 }
 
 extern "C" void initCore3() {
   debug_printf("Core %d! %s\n", whichCore(), STRING_EL(get_CurrentEL()));
-  startedCores.add_fetch(1);
+  startedCores.add_fetch<__ATOMIC_RELEASE>(1);
 
   VMM::init_core();
+  bootBarrier.sync();
+
+  GenericTimer::init_core();
 
   event_loop();
 }
 
 void bootCores() {
-  startedCores.add_fetch(1);
+  startedCores.add_fetch<__ATOMIC_RELEASE>(1);
   // Boot other cores
   void* core_1_device = Devices::get_device("/cpus/cpu@1");
   Devices::DTB_Property cpu_1_release_addr = Devices::get_device_property(core_1_device, "cpu-release-addr");
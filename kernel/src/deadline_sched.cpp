@@ -0,0 +1,257 @@
+#include "deadline_sched.h"
+
+#include "atomics.h"
+#include "event_loop.h"
+#include "generic_timer.h"
+#include "interrupts.h"
+#include "printf.h"
+
+namespace DeadlineSched {
+struct Entry {
+  DeadlineEntity* entity;
+  Event* event;
+};
+
+struct RunQueue {
+  SpinLock lock;
+  size_t size;             // Entries in heap
+  size_t throttled_count;  // Entries in throttled
+  Entry heap[QUEUE_CAPACITY];       // Min-heap on absolute_deadline
+  Entry throttled[QUEUE_CAPACITY];  // Waiting for eligible_at
+};
+
+RunQueue run_queues[NUM_CORES];
+
+// Bandwidth and entities admitted on every core, only changed under
+// admission_lock. An admitted entity is queued at most once, so keeping the
+// count within QUEUE_CAPACITY keeps both queues of the core from filling up.
+static SpinLock admission_lock;
+static uint64_t admitted_bandwidth[NUM_CORES];
+static size_t admitted_count[NUM_CORES];
+
+static bool earlier(const Entry& a, const Entry& b) {
+  return a.entity->absolute_deadline < b.entity->absolute_deadline;
+}
+
+static void push(RunQueue& queue, Entry entry) {
+  ASSERT(queue.size < QUEUE_CAPACITY);
+  size_t i = queue.size++;
+  while (i > 0) {
+    size_t parent = (i - 1) / 2;
+    if (!earlier(entry, queue.heap[parent])) break;
+    queue.heap[i] = queue.heap[parent];
+    i = parent;
+  }
+  queue.heap[i] = entry;
+}
+
+static Entry pop(RunQueue& queue) {
+  Entry top = queue.heap[0];
+  Entry last = queue.heap[--queue.size];
+  size_t i = 0;
+  while (true) {
+    size_t child = 2 * i + 1;
+    if (child >= queue.size) break;
+    if (child + 1 < queue.size && earlier(queue.heap[child + 1], queue.heap[child])) {
+      child++;
+    }
+    if (!earlier(queue.heap[child], last)) break;
+    queue.heap[i] = queue.heap[child];
+    i = child;
+  }
+  if (queue.size > 0) queue.heap[i] = last;
+  return top;
+}
+
+// Moves the throttled entries whose period has started into the heap
+static void replenish(RunQueue& queue, uint64_t now) {
+  size_t i = 0;
+  while (i < queue.throttled_count) {
+    if (queue.throttled[i].entity->eligible_at > now) {
+      i++;
+      continue;
+    }
+    push(queue, queue.throttled[i]);
+    queue.throttled[i] = queue.throttled[--queue.throttled_count];
+  }
+}
+
+bool valid(const DeadlineParams& params) {
+  // Keeps runtime_ns << BANDWIDTH_SHIFT from overflowing
+  constexpr uint64_t MAX_NS = 1ull << (63 - BANDWIDTH_SHIFT);
+
+  return params.runtime_ns > 0 && params.runtime_ns <= params.deadline_ns &&
+         params.deadline_ns <= params.period_ns &&
+         params.period_ns >= MIN_PERIOD_NS && params.period_ns <= MAX_NS;
+}
+
+bool admit(DeadlineEntity* entity, const DeadlineParams& params,
+           uint8_t core_mask) {
+  if (!valid(params)) return false;
+  uint64_t bandwidth = (params.runtime_ns << BANDWIDTH_SHIFT) / params.deadline_ns;
+
+  InterruptGuard guard;
+  LockGuard<SpinLock> l(admission_lock);
+
+  // First fit, counting the entity's own old bandwidth and slot as free
+  uint8_t chosen = DeadlineEntity::NO_CORE;
+  for (uint8_t core = 0; core < NUM_CORES; core++) {
+    if (!(core_mask & (1 << core))) continue;
+    uint64_t used = admitted_bandwidth[core];
+    size_t count = admitted_count[core];
+    if (core == entity->core) {
+      used -= entity->bandwidth;
+      count--;
+    }
+    if (used + bandwidth <= MAX_BANDWIDTH && count < QUEUE_CAPACITY) {
+      chosen = core;
+      break;
+    }
+  }
+  if (chosen == DeadlineEntity::NO_CORE) return false;
+
+  if (entity->admitted()) {
+    admitted_bandwidth[entity->core] -= entity->bandwidth;
+    admitted_count[entity->core]--;
+  }
+  admitted_bandwidth[chosen] += bandwidth;
+  admitted_count[chosen]++;
+
+  entity->runtime = GenericTimer::ns_to_counter(params.runtime_ns);
+  entity->deadline = GenericTimer::ns_to_counter(params.deadline_ns);
+  entity->period = GenericTimer::ns_to_counter(params.period_ns);
+  entity->bandwidth = bandwidth;
+  entity->absolute_deadline = 0;
+  entity->remaining = 0;
+  entity->eligible_at = 0;
+  entity->run_start = 0;
+  entity->core = chosen;
+  return true;
+}
+
+void release(DeadlineEntity* entity) {
+  if (!entity->admitted()) return;
+
+  InterruptGuard guard;
+  LockGuard<SpinLock> l(admission_lock);
+  admitted_bandwidth[entity->core] -= entity->bandwidth;
+  admitted_count[entity->core]--;
+  entity->bandwidth = 0;
+  entity->core = DeadlineEntity::NO_CORE;
+}
+
+void enqueue(DeadlineEntity* entity, Event* event) {
+  RunQueue& queue = run_queues[entity->core];
+  {
+    InterruptGuard guard;
+    LockGuard<SpinLock> l(queue.lock);
+    uint64_t now = GenericTimer::now();
+
+    // A budgeted entity that comes back after its deadline could not use the
+    // rest of its old budget without overrunning, so it starts over
+    if (entity->budget_enforced && now >= entity->absolute_deadline &&
+        now >= entity->eligible_at) {
+      entity->absolute_deadline = now + entity->deadline;
+      entity->remaining = entity->runtime;
+      entity->eligible_at = 0;
+    }
+
+#if SCHED_STATS
+    event->enqueued_at = SchedStats::now();
+#endif
+    if (entity->eligible_at > now) {
+      ASSERT(queue.throttled_count < QUEUE_CAPACITY);
+      queue.throttled[queue.throttled_count++] = {entity, event};
+    } else {
+      push(queue, {entity, event});
+    }
+  }
+
+  // Wakes the core if it is sleeping in the event loop
+  __asm__ volatile("sev" ::: "memory");
+}
+
+Event* dequeue(uint8_t core) {
+  if (load(core) == 0) return nullptr;
+
+  RunQueue& queue = run_queues[core];
+  InterruptGuard guard;
+  LockGuard<SpinLock> l(queue.lock);
+  replenish(queue, GenericTimer::now());
+  if (queue.size == 0) return nullptr;
+  return pop(queue).event;
+}
+
+size_t load(uint8_t core) {
+  RunQueue& queue = run_queues[core];
+  return __atomic_load_n(&queue.size, __ATOMIC_RELAXED) +
+         __atomic_load_n(&queue.throttled_count, __ATOMIC_RELAXED);
+}
+
+bool has_throttled(uint8_t core) {
+  return __atomic_load_n(&run_queues[core].throttled_count, __ATOMIC_RELAXED) > 0;
+}
+
+void start_run(DeadlineEntity* entity) {
+  entity->run_start = GenericTimer::now();
+}
+
+void stop_run(DeadlineEntity* entity, bool finished) {
+  if (entity->run_start == 0) return;
+
+  uint64_t now = GenericTimer::now();
+  entity->remaining -= (int64_t) (now - entity->run_start);
+  entity->run_start = 0;
+  if (finished && now > entity->absolute_deadline) entity->misses++;
+
+  uint64_t period_start = entity->absolute_deadline - entity->deadline;
+  if (!entity->budget_enforced) {
+    if (!finished) return;
+
+    // The next job of a kernel task is released at the start of the next
+    // period whose deadline is still ahead, and every period passed over is
+    // a miss
+    period_start += entity->period;
+    entity->absolute_deadline += entity->period;
+    while (entity->absolute_deadline <= now) {
+      period_start += entity->period;
+      entity->absolute_deadline += entity->period;
+      entity->misses++;
+    }
+    entity->remaining = entity->runtime;
+    entity->eligible_at = period_start;
+    return;
+  }
+
+  // Out of budget: the deadline moves on a period for every runtime used,
+  // and the entity waits for the period that deadline belongs to
+  if (finished && entity->remaining > 0) entity->remaining = 0;
+  if (entity->remaining > 0) return;
+
+  while (entity->remaining <= 0) {
+    period_start += entity->period;
+    entity->absolute_deadline += entity->period;
+    entity->remaining += entity->runtime;
+  }
+  entity->eligible_at = period_start;
+}
+
+bool should_preempt(uint8_t core, DeadlineEntity* current) {
+  uint64_t now = GenericTimer::now();
+  if (current != nullptr && current->budget_enforced && current->run_start != 0 &&
+      (int64_t) (now - current->run_start) >= current->remaining) {
+    return true;
+  }
+  if (load(core) == 0) return false;
+
+  RunQueue& queue = run_queues[core];
+  LockGuard<SpinLock> l(queue.lock);
+  replenish(queue, now);
+  if (queue.size == 0) return false;
+  if (current == nullptr) return true;
+
+  // Kernel deadline tasks run to completion
+  if (!current->budget_enforced) return false;
+  return queue.heap[0].entity->absolute_deadline < current->absolute_deadline;
+}
+}  // namespace DeadlineSched
@@ -0,0 +1,33 @@
+#include "deadline_task.h"
+
+#include "generic_timer.h"
+#include "preempt.h"
+
+bool DeadlineTask::start(const DeadlineParams& params, uint8_t core_mask) {
+  if (!DeadlineSched::admit(&entity, params, core_mask)) return false;
+
+  entity.absolute_deadline = GenericTimer::now() + entity.deadline;
+  entity.remaining = entity.runtime;
+  DeadlineSched::enqueue(&entity, this);
+  return true;
+}
+
+void DeadlineTask::run() {
+  if (stopped.load()) {
+    // Nothing refers to the task once it is off the queue
+    DeadlineSched::release(&entity);
+    delete this;
+    return;
+  }
+
+  {
+    PreemptGuard guard;
+    DeadlineSched::start_run(&entity);
+    work();
+    DeadlineSched::stop_run(&entity, true);
+  }
+  completed.add_fetch(1);
+
+  // Waits throttled for the next period
+  DeadlineSched::enqueue(&entity, this);
+}
@@ -1,44 +1,237 @@
 #include "event_loop.h"
 
 #include "cores.h"
+#include "definitions.h"
+#include "generic_timer.h"
 #include "machine.h"
+#include "preempt.h"
 #include "printf.h"
-#include "queue.h"
+#include "reclaim.h"
+#include "ring_queue.h"
+#include "sched_stats.h"
+#include "timer_wheel.h"
 
-LocklessQueue<Event*>* ready_queue;
+EventQueue* ready_queues[NUM_PRIORITIES];
+EventQueue* local_queues[NUM_CORES][NUM_PRIORITIES];
 
-extern "C" uint8_t* stack0_top;
-extern "C" uint8_t* stack1_top;
-extern "C" uint8_t* stack2_top;
-extern "C" uint8_t* stack3_top;
+// How many events in a row each level has been passed over for, per core
+struct AgingState {
+  uint32_t passed_over[NUM_PRIORITIES];
+  char pad[CACHE_LINE_SIZE];
+};
 
-void init_event_loop() { ready_queue = new LocklessQueue<Event*>(); }
+AgingState aging[NUM_CORES];
+
+void init_event_loop() {
+  for (int level = 0; level < NUM_PRIORITIES; level++) {
+    ready_queues[level] = new EventQueue(READY_QUEUE_CAPACITY);
+    for (int core = 0; core < NUM_CORES; core++) {
+      local_queues[core][level] = new EventQueue(LOCAL_QUEUE_CAPACITY);
+    }
+  }
+}
+
+// The overflow list is only ever taken whole, so pushes cannot be confused by
+// a node that was popped and pushed again
+void EventQueue::push_overflow(Event* newest, Event* oldest, size_t count) {
+  __atomic_fetch_add(&overflowed, count, __ATOMIC_RELAXED);
+  Event* head = __atomic_load_n(&overflow, __ATOMIC_RELAXED);
+  do {
+    oldest->overflow_next = head;
+  } while (!__atomic_compare_exchange_n(&overflow, &head, newest, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// Takes the whole overflow list, returning it oldest first
+Event* EventQueue::take_overflow() {
+  if (__atomic_load_n(&overflow, __ATOMIC_RELAXED) == nullptr) return nullptr;
+  Event* newest = __atomic_exchange_n(&overflow, nullptr, __ATOMIC_ACQUIRE);
+
+  Event* oldest = nullptr;
+  size_t count = 0;
+  while (newest != nullptr) {
+    Event* next = newest->overflow_next;
+    newest->overflow_next = oldest;
+    oldest = newest;
+    newest = next;
+    count++;
+  }
+  __atomic_fetch_sub(&overflowed, count, __ATOMIC_RELAXED);
+  return oldest;
+}
+
+// Moves a list, oldest first, into the ring as far as it fits and puts the
+// rest back on the overflow list
+void EventQueue::move_to_ring(Event* oldest) {
+  if (oldest == nullptr) return;
+  while (oldest != nullptr) {
+    // Once in the ring the event may run and be deleted on another core
+    Event* next = oldest->overflow_next;
+    if (!ring.try_enqueue({oldest, oldest->core_mask})) break;
+    oldest = next;
+  }
+
+  // Idle cores may have found the queue empty while the list was taken
+  __asm__ volatile("sev" ::: "memory");
+  if (oldest == nullptr) return;
+
+  Event* newest = nullptr;
+  Event* last = oldest;
+  size_t count = 0;
+  while (oldest != nullptr) {
+    Event* next = oldest->overflow_next;
+    oldest->overflow_next = newest;
+    newest = oldest;
+    oldest = next;
+    count++;
+  }
+  push_overflow(newest, last, count);
+}
+
+void EventQueue::enqueue(Event* event) {
+  if (!ring.try_enqueue({event, event->core_mask})) push_overflow(event, event, 1);
+}
+
+bool EventQueue::try_dequeue(Event*& event) {
+  Queued queued;
+  if (ring.try_dequeue(queued)) {
+    event = queued.event;
+    // Each event taken makes room for one that overflowed
+    move_to_ring(take_overflow());
+    return true;
+  }
+
+  Event* waiting = take_overflow();
+  if (waiting == nullptr) return false;
+  event = waiting;
+  move_to_ring(waiting->overflow_next);
+  return true;
+}
+
+bool EventQueue::try_steal(uint8_t core, Event*& event) {
+  Queued queued;
+  if (!ring.try_dequeue_if(queued, [core](const Queued& front) {
+        return (front.core_mask & (1 << core)) != 0;
+      })) {
+    return false;
+  }
+  event = queued.event;
+  move_to_ring(take_overflow());
+  return true;
+}
+
+constexpr int FAIR_LEVEL = static_cast<int>(Priority::Normal);
+
+// Takes an event of the given level, preferring this core's own queue. The
+// core's runnable processes come after its Normal kernel events.
+static bool try_dequeue_level(uint8_t core, int level, Event*& event) {
+  if (local_queues[core][level]->try_dequeue(event) ||
+      ready_queues[level]->try_dequeue(event)) {
+    return true;
+  }
+  if (level != FAIR_LEVEL) return false;
+  event = FairSched::dequeue(core);
+  return event != nullptr;
+}
+
+static bool level_is_empty(uint8_t core, int level) {
+  return local_queues[core][level]->is_empty() &&
+         ready_queues[level]->is_empty() &&
+         (level != FAIR_LEVEL || FairSched::load(core) == 0);
+}
+
+// Takes an event from the most loaded other core, if that core is over the
+// migration threshold and the event may run here
+static Event* steal_event(uint8_t core) {
+  uint8_t victim = NUM_CORES;
+  size_t victim_load = MIGRATION_THRESHOLD;
+  for (uint8_t other = 0; other < NUM_CORES; other++) {
+    if (other == core) continue;
+    size_t load = local_queue_load(other);
+    if (load > victim_load) {
+      victim = other;
+      victim_load = load;
+    }
+  }
+  if (victim == NUM_CORES) return nullptr;
+
+  // An event pinned away from this core stays where it is, ahead of the rest
+  // of its queue
+  Event* event;
+  for (int level = 0; level < NUM_PRIORITIES; level++) {
+    if (local_queues[victim][level]->try_steal(core, event)) return event;
+  }
+  return FairSched::steal(victim, core);
+}
+
+// Picks the next event for this core: the earliest deadline first, then a
+// starved level, otherwise the highest non-empty level, otherwise an event
+// stolen from another core
+static Event* pick_next_event(uint8_t core) {
+  uint32_t* passed_over = aging[core].passed_over;
+  Event* event = DeadlineSched::dequeue(core);
+  if (event != nullptr) return event;
+
+  for (int level = NUM_PRIORITIES - 1; level > 0; level--) {
+    if (passed_over[level] >= AGING_THRESHOLD) {
+      passed_over[level] = 0;
+      if (try_dequeue_level(core, level, event)) return event;
+    }
+  }
+
+  for (int level = 0; level < NUM_PRIORITIES; level++) {
+    if (try_dequeue_level(core, level, event)) {
+      passed_over[level] = 0;
+      for (int lower = level + 1; lower < NUM_PRIORITIES; lower++) {
+        if (!level_is_empty(core, lower)) passed_over[lower]++;
+      }
+      return event;
+    }
+  }
+
+  return steal_event(core);
+}
 
 [[noreturn]]
 void event_loop() {
-
-  switch (SMP::whichCore())
-  {
-    case 0:
-      set_stack_pointer(stack0_top);
-      break;
-    case 1:
-      set_stack_pointer(stack1_top);
-      break;
-    case 2:
-      set_stack_pointer(stack2_top);
-      break;
-    case 3:
-      set_stack_pointer(stack3_top);
-      break;
-  };
+  // Entered from the middle of events too, so nothing on the old stack is
+  // used after the switch
+  Preempt::reset();
+  set_stack_pointer(Preempt::stack_top(SMP::whichCore()));
+  Preempt::publish_parked();
 
   while (true) {
-    if (!ready_queue->is_empty()) {
-      Event* ready_work = ready_queue->dequeue();
-      if (ready_work != 0) {
-        ready_work->run();
+    // Nothing from the previous event is still referenced here
+    Reclaim::quiescent_state();
+
+    // A resumed event returns here on whichever core finished it
+    uint8_t core = SMP::whichCore();
+    Event* ready_work = pick_next_event(core);
+    if (ready_work != nullptr) {
+#if SCHED_STATS
+      SchedStats::event_started(core, ready_work->enqueued_at);
+#endif
+      GenericTimer::start_tick();
+      GenericTimer::start_quantum();
+      Preempt::enable();
+      ready_work->run();
+      Preempt::disable();
+#if SCHED_STATS
+      SchedStats::event_finished(SMP::whichCore());
+#endif
+    } else {
+      // Tickless idle: with no timer due on this core and no throttled
+      // deadline work waiting for its next period, the tick is stopped, and
+      // the core sleeps until an interrupt or until enqueue_event sends an
+      // event. An event sent after the queues were checked is latched, so
+      // wfe returns right away.
+      if (TimerWheel::is_empty() && !DeadlineSched::has_throttled(core)) {
+        GenericTimer::stop_tick();
       }
+      Reclaim::go_offline();
+      uint64_t idle_since = SchedStats::now();
+      __asm__ volatile("wfe");
+      SchedStats::idle_finished(core, idle_since);
     }
   }
-}
\ No newline at end of file
+}
@@ -1,4 +1,5 @@
 #include "ext2.h"
+#include "mutex.h"
 /*
  * EXT2 FILESYSTEM IMPLEMENTATION
  *
@@ -15,6 +16,23 @@ super_block* supa = nullptr;    // Superblock
 BGDT* bgdt = nullptr;           // Block Group Descriptor Table
 uint32_t SB_offset = 1024;      // Superblock offset (always 1024 bytes)
 uint32_t BGDT_index = 0;        // Block index of the BGDT
+SeqLock<Ext2Layout> ext2_layout;
+// Held across the read, modify and write back of a bitmap and the BGDT
+static Mutex ext2_alloc_mutex;
+
+void publish_ext2_layout() {
+    ext2_layout.update([](Ext2Layout& layout) {
+        layout.block_size = 1024 << supa->block_size;
+        layout.inode_size = supa->iNode_size;
+        layout.inodes_per_group = supa->num_iNode_pergroup;
+        layout.num_blocks = supa->num_Blocks;
+        layout.inode_table_block = bgdt->startingBlockAddress;
+        layout.block_bitmap_block = bgdt->bit_map_block_address;
+        layout.inode_bitmap_block = bgdt->bit_map_iNode_address;
+        layout.free_blocks = bgdt->num_unallocated_blocks;
+        layout.free_inodes = bgdt->num_unallocated_iNodes;
+    });
+}
 
 
 /*
@@ -123,11 +141,12 @@ void Node::write_block(uint32_t block_number, char* buffer, uint32_t offset, uin
 
 // Update inode on disk after changes
 void Node::update_inode_on_disk() {
+    const Ext2Layout layout = ext2_layout.read();
     debug_printf("DEBUG: Node::update_inode_on_disk: Saving inode %u (size=%u, type=0x%x)\n", 
            number, node->size_of_iNode, node->types_plus_perm);
     
-    uint32_t inode_offset = bgdt->startingBlockAddress * (1024 << supa->block_size) + 
-                           index * supa->iNode_size;
+    uint32_t inode_offset = layout.inode_table_block * layout.block_size + 
+                           index * layout.inode_size;
     
     debug_printf("DEBUG: Node::update_inode_on_disk: Writing to offset 0x%x, size=%u\n", 
            inode_offset, sizeof(iNode));
@@ -137,17 +156,19 @@ void Node::update_inode_on_disk() {
 
 // Find and allocate a free block
 uint32_t Node::allocate_block() {
+    LockGuard<Mutex> guard(ext2_alloc_mutex);
+    const Ext2Layout layout = ext2_layout.read();
     debug_printf("DEBUG: Node::allocate_block: Finding free block for inode %u\n", number);
     
     // Diagnostic logging of initial state
     debug_printf("DIAG: Initial BGDT Free Block Count: %u\n", bgdt->num_unallocated_blocks);
     
     // Read the block bitmap
-    uint8_t* bitmap = new uint8_t[1024 << supa->block_size];
-    sd_adapter->read_block(bgdt->bit_map_block_address, (char*)bitmap);
+    uint8_t* bitmap = new uint8_t[layout.block_size];
+    sd_adapter->read_block(layout.block_bitmap_block, (char*)bitmap);
     
     // Detailed bitmap tracking
-    uint32_t total_blocks = supa->num_Blocks;
+    uint32_t total_blocks = layout.num_blocks;
     uint32_t free_blocks_in_bitmap = 0;
     uint32_t first_free_block = 0;
     
@@ -189,18 +210,19 @@ uint32_t Node::allocate_block() {
                    i + 1, byte_idx, bit_idx);
             
             // Write bitmap back
-            sd_adapter->write_block(bgdt->bit_map_block_address, (char*)bitmap, 0, 1024 << supa->block_size);
+            sd_adapter->write_block(layout.block_bitmap_block, (char*)bitmap, 0, layout.block_size);
             
             // Update BGDT
             uint32_t prev_free_blocks = bgdt->num_unallocated_blocks;
             bgdt->num_unallocated_blocks--;
+            publish_ext2_layout();
             
             debug_printf("DIAG: Block Allocation Details:\n");
             debug_printf("DIAG: Previous Free Block Count: %u\n", prev_free_blocks);
             debug_printf("DIAG: New Free Block Count: %u\n", bgdt->num_unallocated_blocks);
             
             // Update BGDT on disk
-            uint32_t bgdt_offset = BGDT_index * (1024 << supa->block_size) + 
+            uint32_t bgdt_offset = BGDT_index * layout.block_size + 
                                    (block_group * sizeof(BGDT));
             int64_t bgdt_write_result = sd_adapter->write_all(bgdt_offset, sizeof(BGDT), (char*)bgdt);
             
@@ -222,6 +244,7 @@ uint32_t Node::allocate_block() {
 
 // List all entries in a directory
 void list_directory(Node* dir) {
+    const Ext2Layout layout = ext2_layout.read();
     if (!dir->is_dir()) {
         printf("Error: Not a directory\n");
         return;
@@ -231,7 +254,7 @@ void list_directory(Node* dir) {
     
     // Allocate a buffer for a directory block
     // Size is determined by the filesystem's block size
-    char* blockDir = new char[1024 << supa->block_size];
+    char* blockDir = new char[layout.block_size];
     if (!blockDir) {
         printf("Error: Failed to allocate memory for directory block\n");
         return;
@@ -248,10 +271,10 @@ void list_directory(Node* dir) {
         uint32_t offset = 0;  // Offset within this block
         
         // Process entries within this block
-        while (offset < (1024 << supa->block_size)) {
+        while (offset < layout.block_size) {
             // Cast the current position to a directory entry
             dir_entry* entry = (dir_entry*)(blockDir + offset);
-            if (entry->size_entry == 0 || entry->size_entry > (1024 << supa->block_size) - offset) {
+            if (entry->size_entry == 0 || entry->size_entry > layout.block_size - offset) {
                 printf("Corrupt directory entry at offset %u: size_entry=%u\n", offset, entry->size_entry);
                 break;
             }
@@ -274,7 +297,7 @@ void list_directory(Node* dir) {
             
             // Determine the type of file
             char type_char = '?';
-            Node* entry_node = new Node(1024 << supa->block_size, entry->iNodeNum, dir->sd_adapter);
+            Node* entry_node = new Node(layout.block_size, entry->iNodeNum, dir->sd_adapter);
             
             if (entry_node->is_dir()) {
                 type_char = 'D';  // Directory
@@ -298,7 +321,7 @@ void list_directory(Node* dir) {
             offset += entry->size_entry;
             
             // Check if we've reached the end of the block
-            if (offset >= (1024 << supa->block_size)) {
+            if (offset >= layout.block_size) {
                 break;
             }
         }
@@ -311,6 +334,7 @@ void list_directory(Node* dir) {
 
 // Find an entry in a directory by name
 Node* find_in_directory(Node* dir, const char* name) {
+    const Ext2Layout layout = ext2_layout.read();
     debug_printf("DEBUG: find_in_directory: Looking for '%s' in directory (inode %u)\n", 
            name, dir->number);
     
@@ -320,7 +344,7 @@ Node* find_in_directory(Node* dir, const char* name) {
     }
     
     // Allocate a buffer for a directory block
-    char* blockDir = new char[1024 << supa->block_size];
+    char* blockDir = new char[layout.block_size];
     if (!blockDir) {
         debug_printf("Error: Failed to allocate memory for directory block\n");
         return nullptr;
@@ -338,7 +362,7 @@ Node* find_in_directory(Node* dir, const char* name) {
         uint32_t offset = 0;  // Offset within this block
         
         // Process entries within this block
-        while (offset < (1024 << supa->block_size)) {
+        while (offset < layout.block_size) {
             // Cast the current position to a directory entry
             dir_entry* entry = (dir_entry*)(blockDir + offset);
             
@@ -365,7 +389,7 @@ Node* find_in_directory(Node* dir, const char* name) {
             if (streq_ext(name, entry_name)) {
                 // Found it! Create a node for this entry
                 debug_printf("DEBUG: find_in_directory: Match found!\n");
-                result = new Node(1024 << supa->block_size, entry->iNodeNum, dir->sd_adapter);
+                result = new Node(layout.block_size, entry->iNodeNum, dir->sd_adapter);
                 delete[] blockDir;
                 return result;
             }
@@ -375,7 +399,7 @@ Node* find_in_directory(Node* dir, const char* name) {
             offset += entry->size_entry;
             
             // Check if we've reached the end of the block
-            if (offset >= (1024 << supa->block_size)) {
+            if (offset >= layout.block_size) {
                 break;
             }
         }
@@ -492,17 +516,19 @@ int read_file(Node* file, char* buffer, uint32_t max_size) {
 
 // Allocate a new inode
 uint32_t allocate_inode(Node* dir) {
+    LockGuard<Mutex> guard(ext2_alloc_mutex);
+    const Ext2Layout layout = ext2_layout.read();
     debug_printf("DEBUG: allocate_inode: Allocating new inode in block group %u\n", dir->block_group);
     
     // Use the same block group as the parent directory for locality
     uint32_t block_group = dir->block_group;
     
     // Read the inode bitmap
-    uint8_t* bitmap = new uint8_t[1024 << supa->block_size];
-    dir->sd_adapter->read_block(bgdt->bit_map_iNode_address, (char*)bitmap);
+    uint8_t* bitmap = new uint8_t[layout.block_size];
+    dir->sd_adapter->read_block(layout.inode_bitmap_block, (char*)bitmap);
     
     // Find first free inode in this block group
-    for (uint32_t i = 0; i < supa->num_iNode_pergroup; i++) {
+    for (uint32_t i = 0; i < layout.inodes_per_group; i++) {
         uint32_t byte_idx = i / 8;
         uint32_t bit_idx = i % 8;
         
@@ -514,17 +540,18 @@ uint32_t allocate_inode(Node* dir) {
                    i, byte_idx, bit_idx);
             
             // Write bitmap back
-            dir->sd_adapter->write_block(bgdt->bit_map_iNode_address, (char*)bitmap, 0, 1024 << supa->block_size);
+            dir->sd_adapter->write_block(layout.inode_bitmap_block, (char*)bitmap, 0, layout.block_size);
             
             // Update BGDT
             bgdt->num_unallocated_iNodes--;
+            publish_ext2_layout();
             
             // Update BGDT on disk
-            uint32_t bgdt_offset = BGDT_index * (1024 << supa->block_size) + (block_group * sizeof(BGDT));
+            uint32_t bgdt_offset = BGDT_index * layout.block_size + (block_group * sizeof(BGDT));
             dir->sd_adapter->write_all(bgdt_offset, sizeof(BGDT), (char*)bgdt);
             
             delete[] bitmap;
-            uint32_t inode_num = (block_group * supa->num_iNode_pergroup) + i + 1; // inode numbers start at 1
+            uint32_t inode_num = (block_group * layout.inodes_per_group) + i + 1; // inode numbers start at 1
             debug_printf("DEBUG: allocate_inode: Allocated inode %u\n", inode_num);
             return inode_num;
         }
@@ -537,11 +564,12 @@ uint32_t allocate_inode(Node* dir) {
 
 // Initialize a new inode
 void create_inode(uint32_t inode_num, uint16_t type, SDAdapter* adapter) {
+    const Ext2Layout layout = ext2_layout.read();
     // Calculate inode location
-    uint32_t block_group = (inode_num - 1) / supa->num_iNode_pergroup;
-    uint32_t index = (inode_num - 1) % supa->num_iNode_pergroup;
-    uint32_t inode_offset = bgdt->startingBlockAddress * (1024 << supa->block_size) + 
-                           index * supa->iNode_size;
+    uint32_t block_group = (inode_num - 1) / layout.inodes_per_group;
+    uint32_t index = (inode_num - 1) % layout.inodes_per_group;
+    uint32_t inode_offset = layout.inode_table_block * layout.block_size + 
+                           index * layout.inode_size;
     
     debug_printf("DEBUG: create_inode: inode %u, group %u, index %u, offset 0x%x\n", 
            inode_num, block_group, index, inode_offset);
@@ -565,6 +593,7 @@ void create_inode(uint32_t inode_num, uint16_t type, SDAdapter* adapter) {
 
 // Add a directory entry
 void add_dir_entry(Node* dir, const char* name, uint32_t inode_num) {
+    const Ext2Layout layout = ext2_layout.read();
     debug_printf("DEBUG: add_dir_entry: Adding entry '%s' (inode %u) to directory (inode %u)\n", 
            name, inode_num, dir->number);
     
@@ -580,7 +609,7 @@ void add_dir_entry(Node* dir, const char* name, uint32_t inode_num) {
            entry_size, name_len);
     
     // Find space in the directory
-    char* block_buf = new char[1024 << supa->block_size];
+    char* block_buf = new char[layout.block_size];
     bool found_space = false;
     uint32_t block_num = 0;
     uint32_t offset = 0;
@@ -604,13 +633,13 @@ void add_dir_entry(Node* dir, const char* name, uint32_t inode_num) {
             dir->update_inode_on_disk();
             
             // Clear the new block
-            zero_memory(block_buf, 1024 << supa->block_size);
+            zero_memory(block_buf, layout.block_size);
             
             // New entry goes at the start
             offset = 0;
             found_space = true;
             debug_printf("DEBUG: add_dir_entry: Writing newly allocated block %u to disk\n", new_block);
-            dir->sd_adapter->write_block(new_block, block_buf, 0, 1024 << supa->block_size);
+            dir->sd_adapter->write_block(new_block, block_buf, 0, layout.block_size);
         } else {
             // Read existing block
             debug_printf("DEBUG: add_dir_entry: Reading existing block %u\n", 
@@ -619,7 +648,7 @@ void add_dir_entry(Node* dir, const char* name, uint32_t inode_num) {
             
             // Scan through entries to find space
             uint32_t pos = 0;
-            while (pos < (1024 << supa->block_size)) {
+            while (pos < layout.block_size) {
                 dir_entry* entry = (dir_entry*)(block_buf + pos);
                 
                 debug_printf("DEBUG: add_dir_entry: Checking entry at offset %u: inode=%u, size=%u\n", 
@@ -635,7 +664,7 @@ void add_dir_entry(Node* dir, const char* name, uint32_t inode_num) {
                 
                 // Move to next entry
                 pos += entry->size_entry;
-                if (pos >= (1024 << supa->block_size)) {
+                if (pos >= layout.block_size) {
                     debug_printf("DEBUG: add_dir_entry: Reached end of block\n");
                     break;
                 }
@@ -668,10 +697,10 @@ void add_dir_entry(Node* dir, const char* name, uint32_t inode_num) {
     
     // Write the updated block back to disk
     debug_printf("DEBUG: add_dir_entry: Writing block back to disk\n");
-    dir->sd_adapter->write_block(dir->node->directLinked[block_num], block_buf, 0, 1024 << supa->block_size);
+    dir->sd_adapter->write_block(dir->node->directLinked[block_num], block_buf, 0, layout.block_size);
     
     // Update directory size if needed
-    uint32_t end_pos = (block_num * (1024 << supa->block_size)) + offset + entry_size;
+    uint32_t end_pos = (block_num * layout.block_size) + offset + entry_size;
     if (end_pos > dir->node->size_of_iNode) {
         debug_printf("DEBUG: add_dir_entry: Updating directory size from %u to %u\n", 
                dir->node->size_of_iNode, end_pos);
@@ -684,6 +713,7 @@ void add_dir_entry(Node* dir, const char* name, uint32_t inode_num) {
 
 // Create a new file
 Node* create_file(Node* dir, const char* name) {
+    const Ext2Layout layout = ext2_layout.read();
     debug_printf("DEBUG: create_file: Creating file '%s' in directory (inode %u)\n", name, dir->number);
     
     if (!dir->is_dir()) {
@@ -718,7 +748,7 @@ Node* create_file(Node* dir, const char* name) {
     
     // Return the new node
     debug_printf("DEBUG: create_file: Creating Node object for new file\n");
-    return new Node(1024 << supa->block_size, inode_num, dir->sd_adapter);
+    return new Node(layout.block_size, inode_num, dir->sd_adapter);
 }
 
 /*
@@ -0,0 +1,220 @@
+#include "fair_sched.h"
+
+#include "atomics.h"
+#include "event_loop.h"
+#include "generic_timer.h"
+#include "interrupts.h"
+#include "printf.h"
+#include "process.h"
+
+namespace FairSched {
+static const uint64_t nice_to_weight[MAX_NICE - MIN_NICE + 1] = {
+  /* -20 */ 88761, 71755, 56483, 46273, 36291,
+  /* -15 */ 29154, 23254, 18705, 14949, 11916,
+  /* -10 */ 9548,  7620,  6100,  4904,  3906,
+  /*  -5 */ 3121,  2501,  1991,  1586,  1277,
+  /*   0 */ 1024,  820,   655,   526,   423,
+  /*   5 */ 335,   272,   215,   172,   137,
+  /*  10 */ 110,   87,    70,    56,    45,
+  /*  15 */ 36,    29,    23,    18,    15,
+};
+
+struct RunQueue {
+  SpinLock lock;
+  size_t size;
+  uint64_t total_weight;   // Of the queued processes
+  uint64_t min_vruntime;   // Only moves forward
+  size_t capacity;         // Never below the number of processes
+  Process** heap;
+};
+
+RunQueue run_queues[NUM_CORES];
+
+// A process is queued at most once, so a queue with room for every process
+// never fills, whatever the affinities. Queues only grow under grow_lock.
+static Atomic<size_t> processes(0);
+static SpinLock grow_lock;
+
+// Virtual runtimes are compared through their difference, so they may wrap
+static bool before(uint64_t a, uint64_t b) { return (int64_t)(a - b) < 0; }
+
+static uint64_t vruntime_of(Process* process) {
+  return process->fair().vruntime;
+}
+
+static void push(RunQueue& queue, Process* process) {
+  ASSERT(queue.size < queue.capacity);
+  size_t i = queue.size++;
+  while (i > 0) {
+    size_t parent = (i - 1) / 2;
+    if (!before(vruntime_of(process), vruntime_of(queue.heap[parent]))) break;
+    queue.heap[i] = queue.heap[parent];
+    i = parent;
+  }
+  queue.heap[i] = process;
+  queue.total_weight += process->fair().weight;
+}
+
+static Process* pop(RunQueue& queue) {
+  Process* top = queue.heap[0];
+  Process* last = queue.heap[--queue.size];
+  size_t i = 0;
+  while (true) {
+    size_t child = 2 * i + 1;
+    if (child >= queue.size) break;
+    if (child + 1 < queue.size &&
+        before(vruntime_of(queue.heap[child + 1]), vruntime_of(queue.heap[child]))) {
+      child++;
+    }
+    if (!before(vruntime_of(queue.heap[child]), vruntime_of(last))) break;
+    queue.heap[i] = queue.heap[child];
+    i = child;
+  }
+  if (queue.size > 0) queue.heap[i] = last;
+
+  queue.total_weight -= top->fair().weight;
+  if (before(queue.min_vruntime, top->fair().vruntime)) {
+    queue.min_vruntime = top->fair().vruntime;
+  }
+  return top;
+}
+
+// Carries the process's lag relative to its old core's min_vruntime over to
+// the new core
+static void rehome(FairEntity& entity, uint8_t core) {
+  if (entity.home_core == core) return;
+  uint64_t new_min = __atomic_load_n(&run_queues[core].min_vruntime, __ATOMIC_RELAXED);
+  if (entity.home_core != FairEntity::NO_CORE) {
+    uint64_t old_min = __atomic_load_n(&run_queues[entity.home_core].min_vruntime,
+                                       __ATOMIC_RELAXED);
+    entity.vruntime = entity.vruntime - old_min + new_min;
+  } else {
+    entity.vruntime = new_min;
+  }
+  entity.home_core = core;
+}
+
+uint64_t weight_for_nice(int nice) {
+  if (nice < MIN_NICE) nice = MIN_NICE;
+  if (nice > MAX_NICE) nice = MAX_NICE;
+  return nice_to_weight[nice - MIN_NICE];
+}
+
+void add_process() {
+  size_t needed = processes.add_fetch(1);
+
+  LockGuard<SpinLock> g(grow_lock);
+  for (uint8_t core = 0; core < NUM_CORES; core++) {
+    RunQueue& queue = run_queues[core];
+    if (queue.capacity >= needed) continue;
+
+    size_t capacity = queue.capacity < MIN_QUEUE_CAPACITY ? MIN_QUEUE_CAPACITY
+                                                          : queue.capacity;
+    while (capacity < needed) capacity *= 2;
+    Process** heap = new Process*[capacity];
+
+    Process** old;
+    {
+      InterruptGuard guard;
+      LockGuard<SpinLock> l(queue.lock);
+      for (size_t i = 0; i < queue.size; i++) heap[i] = queue.heap[i];
+      old = queue.heap;
+      queue.heap = heap;
+      queue.capacity = capacity;
+    }
+    if (old != nullptr) delete[] old;
+  }
+}
+
+void remove_process() { processes.add_fetch(-1); }
+
+void enqueue(uint8_t core, Process* process) {
+  FairEntity& entity = process->fair();
+  RunQueue& queue = run_queues[core];
+  {
+    InterruptGuard guard;
+    LockGuard<SpinLock> l(queue.lock);
+    rehome(entity, core);
+
+    uint64_t floor = queue.min_vruntime - GenericTimer::ns_to_counter(WAKEUP_CREDIT_NS);
+    if (before(entity.vruntime, floor)) entity.vruntime = floor;
+
+#if SCHED_STATS
+    process->get_dispatch_event()->enqueued_at = SchedStats::now();
+#endif
+    push(queue, process);
+  }
+
+  // Wakes idle cores sleeping in the event loop
+  __asm__ volatile("sev" ::: "memory");
+}
+
+Event* dequeue(uint8_t core) {
+  RunQueue& queue = run_queues[core];
+  if (load(core) == 0) return nullptr;
+
+  InterruptGuard guard;
+  LockGuard<SpinLock> l(queue.lock);
+  if (queue.size == 0) return nullptr;
+  return pop(queue)->get_dispatch_event();
+}
+
+Event* steal(uint8_t victim, uint8_t thief) {
+  RunQueue& queue = run_queues[victim];
+  InterruptGuard guard;
+  LockGuard<SpinLock> l(queue.lock);
+  if (queue.size == 0 || !queue.heap[0]->may_run_on(thief)) return nullptr;
+  return pop(queue)->get_dispatch_event();
+}
+
+size_t load(uint8_t core) {
+  return __atomic_load_n(&run_queues[core].size, __ATOMIC_RELAXED);
+}
+
+void start_slice(Process* process, uint8_t core) {
+  FairEntity& entity = process->fair();
+  rehome(entity, core);
+  entity.slice_start = GenericTimer::now();
+}
+
+void stop_slice(Process* process) {
+  FairEntity& entity = process->fair();
+  if (entity.slice_start == 0) return;
+
+  uint64_t ran = GenericTimer::now() - entity.slice_start;
+  entity.vruntime += ran * NICE_0_WEIGHT / entity.weight;
+  entity.slice_start = 0;
+
+  // The core's minimum follows the least virtual runtime among the process
+  // that just ran and the ones still waiting
+  RunQueue& queue = run_queues[entity.home_core];
+  InterruptGuard guard;
+  LockGuard<SpinLock> l(queue.lock);
+  uint64_t least = entity.vruntime;
+  if (queue.size > 0 && before(vruntime_of(queue.heap[0]), least)) {
+    least = vruntime_of(queue.heap[0]);
+  }
+  if (before(queue.min_vruntime, least)) queue.min_vruntime = least;
+}
+
+bool should_preempt(uint8_t core, Process* current) {
+  FairEntity& entity = current->fair();
+  if (entity.slice_start == 0) return false;
+
+  uint64_t ran = GenericTimer::now() - entity.slice_start;
+  if (ran < GenericTimer::ns_to_counter(MIN_GRANULARITY_NS)) return false;
+
+  RunQueue& queue = run_queues[core];
+  LockGuard<SpinLock> l(queue.lock);
+  if (queue.size == 0) return false;
+
+  // Share of the latency period, and how far ahead of the leftmost process
+  // the current one may get
+  uint64_t ideal = GenericTimer::ns_to_counter(SCHED_LATENCY_NS) * entity.weight /
+                   (queue.total_weight + entity.weight);
+  if (ran >= ideal) return true;
+
+  uint64_t vruntime = entity.vruntime + ran * NICE_0_WEIGHT / entity.weight;
+  return before(vruntime_of(queue.heap[0]) + ideal, vruntime);
+}
+}  // namespace FairSched
@@ -0,0 +1,87 @@
+#include "fpu.h"
+
+#include "cores.h"
+#include "definitions.h"
+
+// CPACR_EL1.FPEN values
+constexpr uint64_t FP_TRAP_ALL = 0b00ull << 20;  // Registers hold the owner's
+constexpr uint64_t FP_TRAP_EL0 = 0b01ull << 20;  // Registers are kernel scratch
+constexpr uint64_t FP_TRAP_NONE = 0b11ull << 20; // Owner is running at EL0
+
+namespace FPU {
+struct CoreState {
+  FPContext* owner;  // Whose state the registers hold, nullptr for the kernel
+  FPContext* user;   // Process most recently entered at EL0
+  bool dirty;        // Registers are newer than owner->state
+  char pad[CACHE_LINE_SIZE];
+};
+
+CoreState core_state[NUM_CORES];
+
+void enter_user(FPContext* context) {
+  uint8_t core = SMP::whichCore();
+  CoreState& state = core_state[core];
+  state.user = context;
+
+  if (state.owner == context && context->core == core) {
+    // Nothing touched the registers since context last used them here
+    state.dirty = true;
+    set_CPACR_EL1(FP_TRAP_NONE);
+  } else if (state.owner == nullptr) {
+    set_CPACR_EL1(FP_TRAP_EL0);
+  } else {
+    set_CPACR_EL1(FP_TRAP_ALL);
+  }
+}
+
+void release(FPContext* context) {
+  CoreState& state = core_state[SMP::whichCore()];
+  if (state.owner != context || !state.dirty) return;
+
+  set_CPACR_EL1(FP_TRAP_NONE);
+  save_fp_state(&context->state);
+  set_CPACR_EL1(FP_TRAP_ALL);
+  state.dirty = false;
+}
+
+void forget(FPContext* context) {
+  CoreState& state = core_state[SMP::whichCore()];
+  if (state.user == context) state.user = nullptr;
+  if (state.owner != context) return;
+
+  state.owner = nullptr;
+  state.dirty = false;
+  set_CPACR_EL1(FP_TRAP_EL0);
+}
+
+// This and handle_trap run with the registers possibly still holding the
+// owner's state, so the compiler must not use them here
+__attribute__((target("general-regs-only"))) void take_for_kernel() {
+  CoreState& state = core_state[SMP::whichCore()];
+
+  set_CPACR_EL1(FP_TRAP_NONE);
+  if (state.owner != nullptr && state.dirty) {
+    save_fp_state(&state.owner->state);
+  }
+  state.owner = nullptr;
+  state.dirty = false;
+
+  // Kernel code is free to use the registers until the next process owns
+  // them
+  set_CPACR_EL1(FP_TRAP_EL0);
+}
+
+__attribute__((target("general-regs-only"))) void handle_trap(bool from_user) {
+  take_for_kernel();
+  if (!from_user) return;
+
+  uint8_t core = SMP::whichCore();
+  CoreState& state = core_state[core];
+  set_CPACR_EL1(FP_TRAP_NONE);
+  FPContext* context = state.user;
+  restore_fp_state(&context->state);
+  context->core = core;
+  state.owner = context;
+  state.dirty = true;
+}
+}  // namespace FPU
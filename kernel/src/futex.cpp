@@ -0,0 +1,171 @@
+#include "futex.h"
+
+#include "atomics.h"
+#include "cores.h"
+#include "event_loop.h"
+#include "hashmap.h"
+#include "interrupts.h"
+#include "machine.h"
+#include "process.h"
+
+struct FutexQueue {
+  SpinLock lock;
+  FutexWaiter* head = nullptr;
+  FutexWaiter* tail = nullptr;
+};
+
+namespace Futex {
+constexpr uint64_t USER_ADDRESS_END = 0x0001'0000'0000'0000;
+constexpr uint64_t PAR_FAULT = 1 << 0;
+constexpr uint64_t PAR_ADDRESS_MASK = 0x0000'FFFF'FFFF'F000;
+constexpr uint64_t PAGE_OFFSET_MASK = 0xFFF;
+
+static HashMap<uint64_t, FutexQueue*>* queues;
+
+// Serializes creating queues, so that two waiters on a new futex end up in
+// the same one
+static SpinLock creation_lock;
+
+void init() { queues = new HashMap<uint64_t, FutexQueue*>(INITIAL_BUCKETS); }
+
+// Finds the physical address of a user word through the running process's
+// translation table
+static bool physical_address(uint32_t* addr, uint64_t* physical) {
+  uint64_t virtual_address = (uint64_t) addr;
+  if (virtual_address % sizeof(uint32_t) != 0) return false;
+  if (virtual_address >= USER_ADDRESS_END) return false;
+
+  uint64_t par = translate_user_read(virtual_address);
+  if (par & PAR_FAULT) return false;
+  *physical = (par & PAR_ADDRESS_MASK) | (virtual_address & PAGE_OFFSET_MASK);
+  return true;
+}
+
+static FutexQueue* find_queue(uint64_t key, bool create) {
+  FutexQueue* queue;
+  if (queues->find(key, queue)) return queue;
+  if (!create) return nullptr;
+
+  InterruptGuard guard;
+  LockGuard<SpinLock> l(creation_lock);
+  if (queues->find(key, queue)) return queue;
+  queue = new FutexQueue();
+  queues->insert_or_assign(key, queue);
+  return queue;
+}
+
+static void unlink(FutexQueue* queue, FutexWaiter* waiter) {
+  if (waiter->prev != nullptr) {
+    waiter->prev->next = waiter->next;
+  } else {
+    queue->head = waiter->next;
+  }
+  if (waiter->next != nullptr) {
+    waiter->next->prev = waiter->prev;
+  } else {
+    queue->tail = waiter->prev;
+  }
+  waiter->next = nullptr;
+  waiter->prev = nullptr;
+  waiter->queue = nullptr;
+}
+
+static void time_out(FutexWaiter* waiter) {
+  Process* process = waiter->process;
+  {
+    InterruptGuard guard;
+    FutexQueue* queue = __atomic_load_n(&waiter->queue, __ATOMIC_ACQUIRE);
+    if (queue != nullptr) {
+      LockGuard<SpinLock> l(queue->lock);
+      if (waiter->queue == queue) {
+        unlink(queue, waiter);
+        process->set_result(Syscall::Result<int>(Syscall::TIMED_OUT));
+      }
+    }
+  }
+
+  // Either this took the waiter off its queue, or a wake did and left the
+  // process to this event
+  process->schedule();
+}
+
+Syscall::ErrorCode wait(uint32_t* addr, uint32_t expected, uint64_t timeout_ns,
+                        uint64_t* saved_state) {
+  uint64_t key;
+  if (!physical_address(addr, &key)) return Syscall::INVALID_POINTER;
+  FutexQueue* queue = find_queue(key, true);
+
+  Process* process = activeProcess[SMP::whichCore()];
+  FutexWaiter* waiter = process->get_futex_waiter();
+  {
+    InterruptGuard guard;
+    LockGuard<SpinLock> l(queue->lock);
+    if (__atomic_load_n(addr, __ATOMIC_SEQ_CST) != expected) {
+      return Syscall::WOULD_BLOCK;
+    }
+
+    waiter->prev = queue->tail;
+    waiter->next = nullptr;
+    if (queue->tail != nullptr) {
+      queue->tail->next = waiter;
+    } else {
+      queue->head = waiter;
+    }
+    queue->tail = waiter;
+    __atomic_store_n(&waiter->queue, queue, __ATOMIC_RELEASE);
+
+    waiter->timeout = TimerHandle{};
+    if (timeout_ns != 0) {
+      auto expire = [waiter] { time_out(waiter); };
+      waiter->timeout = TimerWheel::add(new EventWithWork<decltype(expire)>(expire),
+                                        timeout_ns, 0, Priority::Urgent);
+    }
+
+    Syscall::Result<int>(0).set_state(saved_state);
+    process->block(saved_state);
+  }
+
+  event_loop();
+}
+
+long wake(uint32_t* addr, uint64_t count) {
+  uint64_t key;
+  if (!physical_address(addr, &key)) return -1;
+  FutexQueue* queue = find_queue(key, false);
+  if (queue == nullptr) return 0;
+
+  // Scheduled after the lock is dropped, oldest first
+  FutexWaiter* first = nullptr;
+  FutexWaiter* last = nullptr;
+  long woken = 0;
+  {
+    InterruptGuard guard;
+    LockGuard<SpinLock> l(queue->lock);
+    while ((uint64_t) woken < count && queue->head != nullptr) {
+      FutexWaiter* waiter = queue->head;
+      unlink(queue, waiter);
+      woken++;
+
+      // A timeout that already fired owns the waiter now
+      if (waiter->timeout.timer != nullptr && !TimerWheel::cancel(waiter->timeout)) {
+        continue;
+      }
+
+      if (last != nullptr) {
+        last->next = waiter;
+      } else {
+        first = waiter;
+      }
+      last = waiter;
+    }
+  }
+
+  while (first != nullptr) {
+    FutexWaiter* next = first->next;
+    first->next = nullptr;
+    first->process->schedule();
+    first = next;
+  }
+  return woken;
+}
+}  // namespace Futex
@@ -0,0 +1,114 @@
+#include "generic_timer.h"
+
+#include "cores.h"
+#include "definitions.h"
+#include "machine.h"
+
+namespace GenericTimer {
+constexpr uint64_t local_peripherals_base_address = 0xffff000040000000;
+constexpr uint64_t core_timer_int_control_offset = 0x40;
+
+constexpr uint64_t CNTP_CTL_ENABLE = 1 << 0;
+constexpr uint64_t CNTP_CTL_IMASK = 1 << 1;
+constexpr uint64_t CNTP_CTL_ISTATUS = 1 << 2;
+
+constexpr uint32_t nCNTPNSIRQ_IRQ_ENABLE = 1 << 1;
+
+constexpr uint64_t CNTKCTL_EL0PCTEN = 1 << 0;
+
+// Counter ticks per kernel tick, identical on every core
+static uint64_t counter_per_tick;
+
+static uint64_t quantum_ticks = DEFAULT_QUANTUM_NS / NS_PER_TICK;
+
+struct CoreState {
+  uint64_t quantum_used;
+  bool ticking;
+  char pad[CACHE_LINE_SIZE];
+};
+
+CoreState core_state[NUM_CORES];
+
+void init_core() {
+  uint8_t core = SMP::whichCore();
+
+  volatile uint32_t* timer_int_control_register =
+      (volatile uint32_t*)(local_peripherals_base_address +
+                           core_timer_int_control_offset + 4 * core);
+  uint32_t control = *timer_int_control_register;
+  *timer_int_control_register = control | nCNTPNSIRQ_IRQ_ENABLE;
+
+  counter_per_tick = get_CNTFRQ_EL0() / TICK_HZ;
+
+  // User programs may read CNTPCT_EL0 to time themselves
+  set_CNTKCTL_EL1(CNTKCTL_EL0PCTEN);
+
+  core_state[core].ticking = true;
+  set_CNTP_CVAL_EL0(now() + counter_per_tick);
+  set_CNTP_CTL_EL0(CNTP_CTL_ENABLE);
+}
+
+void set_quantum(uint64_t ns) {
+  uint64_t ticks = (ns + NS_PER_TICK - 1) / NS_PER_TICK;
+  __atomic_store_n(&quantum_ticks, ticks == 0 ? 1 : ticks, __ATOMIC_RELAXED);
+}
+
+// Only ever touched by the owning core, and by its own timer interrupt
+
+void start_quantum() { core_state[SMP::whichCore()].quantum_used = 0; }
+
+bool quantum_expired() {
+  CoreState& state = core_state[SMP::whichCore()];
+  return ++state.quantum_used >=
+         __atomic_load_n(&quantum_ticks, __ATOMIC_RELAXED);
+}
+
+void stop_tick() {
+  CoreState& state = core_state[SMP::whichCore()];
+  if (!state.ticking) return;
+  state.ticking = false;
+  set_CNTP_CTL_EL0(CNTP_CTL_ENABLE | CNTP_CTL_IMASK);
+}
+
+void start_tick() {
+  CoreState& state = core_state[SMP::whichCore()];
+  if (state.ticking) return;
+  state.ticking = true;
+  set_CNTP_CVAL_EL0(now() + counter_per_tick);
+  set_CNTP_CTL_EL0(CNTP_CTL_ENABLE);
+}
+
+bool check_interrupt() {
+  uint64_t control = get_CNTP_CTL_EL0();
+  if ((control & (CNTP_CTL_ENABLE | CNTP_CTL_IMASK | CNTP_CTL_ISTATUS)) !=
+      (CNTP_CTL_ENABLE | CNTP_CTL_ISTATUS)) {
+    return false;
+  }
+
+  // Advance from the previous deadline so ticks do not drift, unless this
+  // core fell more than a tick behind
+  uint64_t next = get_CNTP_CVAL_EL0() + counter_per_tick;
+  uint64_t current = now();
+  if (next <= current) next = current + counter_per_tick;
+  set_CNTP_CVAL_EL0(next);
+
+  return true;
+}
+
+uint64_t now() { return get_CNTPCT_EL0(); }
+
+// Both conversions split off whole seconds first so the multiplication cannot
+// overflow for any realistic uptime
+
+uint64_t ns_to_counter(uint64_t ns) {
+  uint64_t frequency = get_CNTFRQ_EL0();
+  return (ns / 1000000000) * frequency +
+         (ns % 1000000000) * frequency / 1000000000;
+}
+
+uint64_t counter_to_ns(uint64_t counter) {
+  uint64_t frequency = get_CNTFRQ_EL0();
+  return (counter / frequency) * 1000000000 +
+         (counter % frequency) * 1000000000 / frequency;
+}
+}  // namespace GenericTimer
@@ -14,13 +14,13 @@ void GPIO::set_clock(uint8_t clock_num, uint32_t device_mask) {
 void GPIO::maskAnd(uint64_t location, uint32_t mask) {
   volatile uint32_t* locationPTR = (volatile uint32_t*)location;
   uint32_t temp = *locationPTR;
-  *locationPTR &= mask;
+  *locationPTR = temp & mask;
 }
 
 void GPIO::maskOr(uint64_t location, uint32_t mask) {
   volatile uint32_t* locationPTR = (volatile uint32_t*)location;
   uint32_t temp = *locationPTR;
-  *locationPTR |= mask;
+  *locationPTR = temp | mask;
 }
 
 void GPIO::maskZero(uint64_t location) {
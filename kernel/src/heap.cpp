@@ -4,7 +4,7 @@
 #include "definitions.h"
 #include "printf.h"
 #include "stdint.h"
-#include "definitions.h"
+#include "utility.h"
 #include "vmm.h"
 
 // For any sort of reference, you can look up implict free list or use
@@ -31,7 +31,8 @@ static uint64_t heap_size;
 static long* head_of_list;
 
 // Lock to prevent heap race conditions
-SpinLock* heap_spinlock;
+TicketLock* heap_spinlock;
+static LockStats::Site heap_lock_site{"heap"};
 
 // Marks a region as allocated by setting the first 8 bytes to the
 // size of the region (negative to indicate allocated)
@@ -72,7 +73,7 @@ void heap_init() {
 
     mark_free((start), heap_size);
 
-    heap_spinlock = new SpinLock();
+    heap_spinlock = new TicketLock(heap_lock_site);
 }
 
 // Malloc, used to allocate blocks of variable size for external use
@@ -204,6 +205,35 @@ void operator delete(void* ptr, size_t sz) noexcept { free(ptr); }
 
 void operator delete[](void* ptr, size_t sz) noexcept { free(ptr); }
 
+// What new and delete of an alignas type wider than 8 bytes call. malloc
+// only aligns to 8, so the block is padded and the pointer malloc returned is
+// kept in the word just below the aligned one.
+static void* aligned_allocate(size_t count, std::align_val_t al) {
+  size_t alignment = (size_t)al;
+  char* block = (char*)malloc(count + alignment + sizeof(void*));
+  if (block == nullptr) return nullptr;
+  uintptr_t aligned =
+      ((uintptr_t)block + sizeof(void*) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+  ((void**)aligned)[-1] = block;
+  return (void*)aligned;
+}
+
+static void aligned_free(void* ptr) {
+  if (ptr != nullptr) free(((void**)ptr)[-1]);
+}
+
+void* operator new(size_t count, std::align_val_t al) { return aligned_allocate(count, al); }
+
+void* operator new[](size_t count, std::align_val_t al) { return aligned_allocate(count, al); }
+
+void operator delete(void* ptr, std::align_val_t) noexcept { aligned_free(ptr); }
+
+void operator delete[](void* ptr, std::align_val_t) noexcept { aligned_free(ptr); }
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { aligned_free(ptr); }
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { aligned_free(ptr); }
+
 // Undefined Delete Reference Fix
 
 extern "C" void __cxa_atexit() {}
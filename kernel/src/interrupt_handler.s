@@ -2,6 +2,23 @@
   AArch64 Exception Model
 */ 
 
+// Coming from EL0 with FP/SIMD enabled means the registers hold the running
+// process's state. Trap FP/SIMD again so that kernel code saves it before
+// using them (see fpu.h). Uses x1 and x2, which are already saved.
+.macro guard_user_fp
+  mrs x1, SPSR_EL1
+  tst x1, #0xF
+  b.ne 1f
+  mrs x1, CPACR_EL1
+  and x2, x1, #(3 << 20)
+  cmp x2, #(3 << 20)
+  b.ne 1f
+  bic x1, x1, #(3 << 20)
+  msr CPACR_EL1, x1
+  isb
+1:
+.endm
+
 .extern serror_handler
 .globl serror_handler_
 serror_handler_:
@@ -17,7 +34,7 @@ fiq_handler_:
 .extern irq_handler
 .globl irq_handler_
 irq_handler_:
-  sub sp, sp, #248                    // Save State
+  sub sp, sp, #272                    // Save State
   stp x0, x1, [sp, #0x0]
   stp x2, x3, [sp, #0x10]
   stp x4, x5, [sp, #0x20]
@@ -34,7 +51,12 @@ irq_handler_:
   stp x26, x27, [sp, #0xd0]
   stp x28, x29, [sp, #0xe0]
   str x30, [sp, #0xf0]
-  
+  mrs x1, ELR_EL1                     // A nested FP/SIMD trap overwrites these
+  mrs x2, SPSR_EL1
+  stp x1, x2, [sp, #0xf8]
+
+  guard_user_fp
+
   mov x0, sp
 
   mov x19, sp
@@ -45,6 +67,9 @@ irq_handler_:
 
   add sp, sp, x19
 
+  ldp x1, x2, [sp, #0xf8]
+  msr ELR_EL1, x1
+  msr SPSR_EL1, x2
   ldp x0, x1, [sp, #0x0]              // Return State
   ldp x2, x3, [sp, #0x10]
   ldp x4, x5, [sp, #0x20]
@@ -61,7 +86,40 @@ irq_handler_:
   ldp x26, x27, [sp, #0xd0]
   ldp x28, x29, [sp, #0xe0]
   ldr x30, [sp, #0xf0]
-  add sp, sp, #248
+  add sp, sp, #272
+
+  eret
+
+// void resume_kernel_context(uint64_t* frame, FPState* fp_state)
+// Returns into an EL1 context parked by irq_handler, whose frame is still on
+// its own stack. The caller gives the kernel the FP/SIMD registers first, so
+// restoring fp_state does not trap, and ELR/SPSR are only written after it.
+.globl resume_kernel_context
+resume_kernel_context:
+  mov sp, x0
+  mov x0, x1
+  bl restore_fp_state
+
+  ldp x1, x2, [sp, #0xf8]
+  msr ELR_EL1, x1
+  msr SPSR_EL1, x2
+  ldp x0, x1, [sp, #0x0]              // Return State
+  ldp x2, x3, [sp, #0x10]
+  ldp x4, x5, [sp, #0x20]
+  ldp x6, x7, [sp, #0x30]
+  ldp x8, x9, [sp, #0x40]
+  ldp x10, x11, [sp, #0x50]
+  ldp x12, x13, [sp, #0x60]
+  ldp x14, x15, [sp, #0x70]
+  ldp x16, x17, [sp, #0x80]
+  ldp x18, x19, [sp, #0x90]
+  ldp x20, x21, [sp, #0xa0]
+  ldp x22, x23, [sp, #0xb0]
+  ldp x24, x25, [sp, #0xc0]
+  ldp x26, x27, [sp, #0xd0]
+  ldp x28, x29, [sp, #0xe0]
+  ldr x30, [sp, #0xf0]
+  add sp, sp, #272
 
   eret
 
@@ -69,7 +127,7 @@ irq_handler_:
 .extern synchronous_handler
 .globl synchronous_handler_
 synchronous_handler_:
-  sub sp, sp, #248                    // Save State
+  sub sp, sp, #272                    // Save State
   stp x0, x1, [sp, #0x0]
   stp x2, x3, [sp, #0x10]
   stp x4, x5, [sp, #0x20]
@@ -86,6 +144,11 @@ synchronous_handler_:
   stp x26, x27, [sp, #0xd0]
   stp x28, x29, [sp, #0xe0]
   str x30, [sp, #0xf0]
+  mrs x1, ELR_EL1                     // A nested FP/SIMD trap overwrites these
+  mrs x2, SPSR_EL1
+  stp x1, x2, [sp, #0xf8]
+
+  guard_user_fp
 
   mov x0, sp
 
@@ -97,6 +160,9 @@ synchronous_handler_:
 
   add sp, sp, x19
 
+  ldp x1, x2, [sp, #0xf8]
+  msr ELR_EL1, x1
+  msr SPSR_EL1, x2
   ldp x0, x1, [sp, #0x0]              // Return State
   ldp x2, x3, [sp, #0x10]
   ldp x4, x5, [sp, #0x20]
@@ -113,6 +179,6 @@ synchronous_handler_:
   ldp x26, x27, [sp, #0xd0]
   ldp x28, x29, [sp, #0xe0]
   ldr x30, [sp, #0xf0]
-  add sp, sp, #248
+  add sp, sp, #272
 
   eret
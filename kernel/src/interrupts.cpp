@@ -5,13 +5,19 @@
 #include "interrupts.h"
 
 #include "cores.h"
-#include "local_timer.h"
+#include "deadline_sched.h"
 #include "event_loop.h"
+#include "fair_sched.h"
+#include "fpu.h"
+#include "generic_timer.h"
 #include "machine.h"
+#include "preempt.h"
 #include "printf.h"
 #include "process.h"
+#include "sched_stats.h"
 #include "system_call.h"
 #include "system_timer.h"
+#include "timer_wheel.h"
 #include "usb.h"
 
 using Debug::panic;
@@ -118,45 +124,22 @@ extern "C" void fiq_handler()
 
 extern "C" void irq_handler(uint64_t* saved_state)
 {
-  bool local_timer_trigger = LocalTimer::check_interrupt();
+  bool ticked = false;
+  bool quantum_expired = false;
+  if (GenericTimer::check_interrupt()) {
+    TimerWheel::tick();
+    ticked = true;
+    quantum_expired = GenericTimer::quantum_expired();
+  }
 
   uint8_t current_core = SMP::whichCore();
 
-  if (local_timer_trigger && activeProcess[current_core] != nullptr)
-  {
-    // Need to Preempt Process
-    if (!(get_SPSR_EL1() & 0xF))
-    {
-      // EL0
-      debug_printf("Preempt Process In EL0\n");
-
-      Process* current_process = activeProcess[current_core];
-
-      current_process->save_state(saved_state);
-
-      activeProcess[current_core] = nullptr;
-
-      __asm__ volatile("dmb sy" ::: "memory");
-
-      schedule_event([current_process](){
-        current_process->run();
-      });
-
-      set_DAIFClr_all();
-
-      event_loop();
-    } 
-    else
-    {
-      // EL1
-      // todo: Handle Preemption in Kernel
-    }
-  }
-
+  // Device interrupts are handled before anything is preempted, since a
+  // preempted context does not come back through here
   uint32_t irq_pending_1 = Interrupts::get_IRQ_pending_1_register();
 
   if (irq_pending_1 & (1 << 0)) {
-      current_time += 1;
+      current_time = current_time + 1;
       uint32_t current_lower = SystemTimer::get_lower_running_counter_value();
       SystemTimer::set_compare_register(0, current_lower + 1000000);
       SystemTimer::clear_compare(0);
@@ -165,9 +148,51 @@ extern "C" void irq_handler(uint64_t* saved_state)
   if (irq_pending_1 & (1 << USB_IRQ)) {
       g_usb.handle_interrupt();  
   }
+
+  if (!ticked) return;
+
+  Process* current_process = activeProcess[current_core];
+  if (current_process != nullptr)
+  {
+    // EL1 on behalf of a process: system calls run to completion
+    if (saved_state[ExceptionFrame::SPSR] & 0xF) return;
+
+    // EL0: a deadline process only makes way for an earlier deadline or once
+    // out of budget. Otherwise deadline work gets the core straight away,
+    // kernel events after a quantum, and other processes once the fair class
+    // says this one has had its share.
+    DeadlineEntity* deadline = current_process->deadline();
+    bool preempt;
+    if (deadline != nullptr) {
+      preempt = DeadlineSched::should_preempt(current_core, deadline);
+    } else {
+      preempt = DeadlineSched::should_preempt(current_core, nullptr) ||
+                (quantum_expired && has_ready_kernel_events(current_core)) ||
+                FairSched::should_preempt(current_core, current_process);
+    }
+    if (!preempt) return;
+
+    debug_printf("Preempt Process In EL0\n");
+
+    SchedStats::preempted(current_core);
+    current_process->requeue(saved_state);
+  }
+
+  // Preempting only makes sense if something else is waiting for the core.
+  // Deadline work does not wait for the quantum.
+  if (!DeadlineSched::should_preempt(current_core, nullptr) &&
+      (!quantum_expired || !has_ready_events(current_core))) {
+    return;
+  }
+
+  // EL1 kernel event, parked if it is preemptible
+  Preempt::preempt_kernel(saved_state);
 }
 
-extern "C" void synchronous_handler(uint64_t* saved_state)
+// FP/SIMD accesses trap into here before their owner's registers are saved,
+// so this must not use them itself
+extern "C" __attribute__((target("general-regs-only")))
+void synchronous_handler(uint64_t* saved_state)
 {
   uint64_t error_syndrome_register = get_ESR_EL1();
   uint64_t exception_class = (error_syndrome_register >> 26) & 0x3F;
@@ -207,7 +232,8 @@ extern "C" void synchronous_handler(uint64_t* saved_state)
       break;
     case 0b000111:
       {
-        panic("EL1 sync: Access to SME, SVE, Advanced SIMD, or floating-point   ESR=0x%lx", error_syndrome_register);
+        FPU::handle_trap(!(saved_state[ExceptionFrame::SPSR] & 0xF));
+        return;
       }
       break;
     case 0b001010:
@@ -1,11 +1,12 @@
 #include "kernel.h"
 
-#include "local_timer.h"
 #include "cores.h"
 #include "crti.h"
 #include "definitions.h"
 #include "devices.h"
 #include "event_loop.h"
+#include "futex.h"
+#include "generic_timer.h"
 #include "heap.h"
 // #include "interrupts.h"
 // #include "interrupts.h"
@@ -13,9 +14,11 @@
 #include "physmem.h"
 #include "printf.h"
 #include "process.h"
+#include "sched_stats.h"
 #include "sd.h"
 #include "stdint.h"
 #include "system_timer.h"
+#include "timer_wheel.h"
 #include "tester.h"
 #include "ext2.h"
 #include "vmm.h"
@@ -33,6 +36,7 @@ extern "C" void kernelMain() {
 
   heap_init();
   init_event_loop();
+  Futex::init();
 
   printf("DingOS is Booting!\n");
 
@@ -40,7 +44,9 @@ extern "C" void kernelMain() {
 
   SMP::bootCores();
 
-  LocalTimer::setup_timer();
+  SMP::bootBarrier.sync();  // Wait Until All Cores Have Booted
+
+  GenericTimer::init_core();
 
   run_page_tests();
 
@@ -91,24 +97,30 @@ extern "C" void kernelMain() {
   // Step 15: Test USB by requesting the device descriptor
   uint8_t setup_packet[] = {0x80, 0x06, 0x00, 0x01, 0x00, 0x00, 0x12, 0x00};
   g_usb.send_data(0, setup_packet, 8);
-  for (volatile int i = 0; i < 100000; i++);
-  uint8_t buffer[18];
-  uint32_t bytes = g_usb.receive_data(0, buffer, 18);
-  printf("USB TEST: USB Test: Received (%d bytes): ", bytes);
-  for (uint32_t i = 0; i < bytes; i++) {
-      printf("%02x ", buffer[i]);
-  }
-  printf("\n");
-  if (bytes >= 2 && buffer[0] == 0x12 && buffer[1] == 0x01) {
-      printf("USB TEST: USB Test: Valid device descriptor\n");
-  } else {
-      printf("USB TEST: USB Test: Invalid device descriptor\n");
-  }
+  // Give the device a millisecond to answer instead of spinning on the core
+  schedule_event_after(1000000, []() {
+    uint8_t buffer[18];
+    uint32_t bytes = g_usb.receive_data(0, buffer, 18);
+    printf("USB TEST: USB Test: Received (%d bytes): ", bytes);
+    for (uint32_t i = 0; i < bytes; i++) {
+        printf("%02x ", buffer[i]);
+    }
+    printf("\n");
+    if (bytes >= 2 && buffer[0] == 0x12 && buffer[1] == 0x01) {
+        printf("USB TEST: USB Test: Valid device descriptor\n");
+    } else {
+        printf("USB TEST: USB Test: Invalid device descriptor\n");
+    }
+  });
 
 
   
  
 
+  // Ctrl-T on the serial console prints the scheduler statistics when built
+  // with SCHED_STATS_DEBUG_KEY=1
+  SchedStats::start_debug_key();
+
   setupTests();
 
   event_loop();
@@ -0,0 +1,59 @@
+#include "lock_stats.h"
+
+#include "generic_timer.h"
+#include "printf.h"
+
+namespace LockStats {
+#if LOCK_STATS
+// Most sites dump() sorts, the rest are left out
+constexpr int MAX_DUMPED_SITES = 64;
+
+static Site* sites = nullptr;
+
+void register_site(Site* site) {
+  uint32_t unregistered = 0;
+  if (!__atomic_compare_exchange_n(&site->registered, &unregistered, 1, false,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    return;
+  }
+
+  Site* head = __atomic_load_n(&sites, __ATOMIC_RELAXED);
+  do {
+    site->next = head;
+  } while (!__atomic_compare_exchange_n(&sites, &head, site, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+void dump() {
+  Site* sorted[MAX_DUMPED_SITES];
+  int n = 0;
+  for (Site* site = __atomic_load_n(&sites, __ATOMIC_ACQUIRE);
+       site != nullptr && n < MAX_DUMPED_SITES; site = site->next) {
+    // Insertion sort, most contended acquisitions first
+    uint64_t contended = __atomic_load_n(&site->contended, __ATOMIC_RELAXED);
+    int i = n++;
+    while (i > 0 && __atomic_load_n(&sorted[i - 1]->contended, __ATOMIC_RELAXED) < contended) {
+      sorted[i] = sorted[i - 1];
+      i--;
+    }
+    sorted[i] = site;
+  }
+
+  printf("%-20s %10s %10s %9s %12s %12s\n", "lock", "acquired", "contended",
+         "contend%", "wait us", "max hold us");
+  for (int i = 0; i < n; i++) {
+    Site* site = sorted[i];
+    uint64_t acquisitions = __atomic_load_n(&site->acquisitions, __ATOMIC_RELAXED);
+    uint64_t contended = __atomic_load_n(&site->contended, __ATOMIC_RELAXED);
+    uint64_t wait_ticks = __atomic_load_n(&site->wait_ticks, __ATOMIC_RELAXED);
+    uint64_t max_hold_ticks = __atomic_load_n(&site->max_hold_ticks, __ATOMIC_RELAXED);
+    printf("%-20s %10lu %10lu %9lu %12lu %12lu\n", site->name, acquisitions,
+           contended, acquisitions == 0 ? 0 : contended * 100 / acquisitions,
+           GenericTimer::counter_to_ns(wait_ticks) / 1000,
+           GenericTimer::counter_to_ns(max_hold_ticks) / 1000);
+  }
+}
+#else
+void dump() { printf("Lock statistics are not compiled in\n"); }
+#endif
+}  // namespace LockStats
@@ -28,11 +28,29 @@ get_CNTP_TVAL_EL0:
   mrs x0, CNTP_TVAL_EL0
   ret
 
+.globl get_CNTPCT_EL0
+get_CNTPCT_EL0:
+  isb
+  mrs x0, CNTPCT_EL0
+  ret
+
+.globl get_CNTFRQ_EL0
+get_CNTFRQ_EL0:
+  mrs x0, CNTFRQ_EL0
+  ret
+
 .globl set_VBAR_EL1
 set_VBAR_EL1:
   msr VBAR_EL1, x0
   ret
 
+// Takes effect for the next instruction, which may be an FP/SIMD access
+.globl set_CPACR_EL1
+set_CPACR_EL1:
+  msr CPACR_EL1, x0
+  isb
+  ret
+
 .globl set_CNTKCTL_EL1
 set_CNTKCTL_EL1:
   msr CNTKCTL_EL1, x0
@@ -63,6 +81,64 @@ set_DAIFSet_all:
     msr DAIFSet, #7
     ret
 
+.globl get_DAIF
+get_DAIF:
+  mrs x0, DAIF
+  ret
+
+.globl set_DAIF
+set_DAIF:
+  msr DAIF, x0
+  ret
+
+// void save_fp_state(FPState* state)
+.globl save_fp_state
+save_fp_state:
+  mrs x1, FPCR
+  mrs x2, FPSR
+  stp x1, x2, [x0]
+  stp q0, q1, [x0, #0x10]
+  stp q2, q3, [x0, #0x30]
+  stp q4, q5, [x0, #0x50]
+  stp q6, q7, [x0, #0x70]
+  stp q8, q9, [x0, #0x90]
+  stp q10, q11, [x0, #0xb0]
+  stp q12, q13, [x0, #0xd0]
+  stp q14, q15, [x0, #0xf0]
+  stp q16, q17, [x0, #0x110]
+  stp q18, q19, [x0, #0x130]
+  stp q20, q21, [x0, #0x150]
+  stp q22, q23, [x0, #0x170]
+  stp q24, q25, [x0, #0x190]
+  stp q26, q27, [x0, #0x1b0]
+  stp q28, q29, [x0, #0x1d0]
+  stp q30, q31, [x0, #0x1f0]
+  ret
+
+// void restore_fp_state(FPState* state)
+.globl restore_fp_state
+restore_fp_state:
+  ldp x1, x2, [x0]
+  msr FPCR, x1
+  msr FPSR, x2
+  ldp q0, q1, [x0, #0x10]
+  ldp q2, q3, [x0, #0x30]
+  ldp q4, q5, [x0, #0x50]
+  ldp q6, q7, [x0, #0x70]
+  ldp q8, q9, [x0, #0x90]
+  ldp q10, q11, [x0, #0xb0]
+  ldp q12, q13, [x0, #0xd0]
+  ldp q14, q15, [x0, #0xf0]
+  ldp q16, q17, [x0, #0x110]
+  ldp q18, q19, [x0, #0x130]
+  ldp q20, q21, [x0, #0x150]
+  ldp q22, q23, [x0, #0x170]
+  ldp q24, q25, [x0, #0x190]
+  ldp q26, q27, [x0, #0x1b0]
+  ldp q28, q29, [x0, #0x1d0]
+  ldp q30, q31, [x0, #0x1f0]
+  ret
+
 .extern 
 .globl set_stack_pointer
 set_stack_pointer:
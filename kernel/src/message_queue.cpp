@@ -1,28 +1,31 @@
 #include "message_queue.h"
 #include "printf.h"
 
-LocklessQueue<Message>* messageQueue = nullptr;
-SpinLock lock;
+RingQueue<Message>* messageQueue = nullptr;
+static LockStats::Site lock_site{"message queue"};
+SpinLock lock{lock_site};
 
 void init_message_queue() {
     if (messageQueue == nullptr) {
-        messageQueue = new LocklessQueue<Message>();
+        messageQueue = new RingQueue<Message>(MESSAGE_QUEUE_CAPACITY);
         printf("Message queue explicitly initialized\n");
     }
 }
 
-void sendMessage(int sender, int receiver, MessageType type, void* payload) {
+bool sendMessage(int sender, int receiver, MessageType type, void* payload) {
     // printf("SendMessage: Acquiring lock\n");
     LockGuard<SpinLock> l(lock);
     // printf("SendMessage: Lock acquired\n");
     // printf("Trying to send message from %d to %d\n", sender, receiver);
     if (messageQueue == nullptr) {
         printf("Error: messageQueue not initialized\n");
-        return;
+        return false;
     }
     Message msg = {sender, receiver, type, payload};
-    messageQueue->enqueue(msg);
+    // A full queue is left to the sender to retry or give up on
+    if (!messageQueue->try_enqueue(msg)) return false;
     // printf("Enqueued message from %d to %d\n", sender, receiver);
+    return true;
 }
 
 bool receiveMessage(int receiver, Message& msg) {
@@ -32,25 +35,26 @@ bool receiveMessage(int receiver, Message& msg) {
     // printf("Trying to receive message for %d\n", receiver);
     if (messageQueue->is_empty()) return false;
 
-    LocklessQueue<Message> tempQueue;
+    // Rotate through the queue once, taking the first matching message and
+    // putting the rest back in their original order
     bool found = false;
+    size_t pending = messageQueue->size();
 
-    while (!messageQueue->is_empty()) {
+    for (size_t i = 0; i < pending; i++) {
         // printf("Trying to receive message for %d\n", receiver);
-        Message m = messageQueue->dequeue();
+        Message m;
+        if (!messageQueue->try_dequeue(m)) break;
         // printf("Finished dequeuing message\n");
         if (m.receiver == receiver && !found) {
             
             msg = m;
             found = true;
-        } else {
-            tempQueue.enqueue(m);
+        } else if (!messageQueue->try_enqueue(m)) {
+            // Cannot happen: the lock keeps senders out and m just left its
+            // slot, but a lost message must not go unnoticed
+            printf("Error: messageQueue full, dropping message\n");
         }
     }
 
-    // Restore remaining messages
-    while (!tempQueue.is_empty()) {
-        messageQueue->enqueue(tempQueue.dequeue());
-    }
     return found;
 }
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include "physmem.h"
 #include "atomics.h"
 #include "vmm.h"
 #include "stdint.h"
@@ -19,7 +20,8 @@ extern "C" char* _frame_end;
 // auto reject.
 namespace PhysMem {
 
-    static SpinLock lock{};
+    static LockStats::Site lock_site{"physmem"};
+    static TicketLock lock{lock_site};
 
     // Start and end addresses of the page region
     static char* frame_start;
@@ -34,66 +36,77 @@ namespace PhysMem {
     }
 
     void* allocate_frame() {
+        return allocate_frames(1);
+    }
+
+    void* allocate_frames(size_t count) {
 
         // To prevent race conditions within the allocation space
-        LockGuard<SpinLock> l(lock);
-
-        // Searching the bitmap for the first free page
-        for (int i = 0; i < BITMAP_SIZE / 8; i++) {
-            // A page is marked 1 in the bitmap if it is allocated, therefore,
-            // if the value of the 64 bits gotten from this index is not all 1's,
-            // there is a free page.
-            if (bitmap[i] != 0xFFFFFFFFFFFFFFFF) {
-                // Using 64 bits at a time to make search quicker
-                uint64_t word = bitmap[i];
-
-                // Check each bit in the 64 bit chunk to find the first zero
-                // (may be a more optimal way to do this)
-                for (int offset = 0; offset < 64; offset++) {
-                    // Found the free page
-                    if ((word & 0b1) == 0) {
-                        // Mark as allocated
-                        bitmap[i] |= (1ULL << offset);
-                        // Get the actual address of the page with some simple math
-                        // Start of frame region, plus 64 times the chunk we're on (to represent
-                        // the chunks without a free frame) and plus the offset to get the exact index
-                        // of the page, now multiply by 4096 to get to the page itself.
-                        void* new_page = frame_start + ((i * 64 + offset) * PAGE_SIZE);
-
-                        // Zeroes out the page
-                        zero_out((char*) new_page, PAGE_SIZE);
-                        new_page = VMM::kernel_to_phys_ptr(new_page);
-                        debug_printf("Frame found at 0x%lx\n", new_page);
-                        return new_page;
-                    }
-                    // Look at the next bit
-                    word >> 1;
-                }
+        LockGuard<TicketLock> l(lock);
+
+        size_t run_start = 0;
+        size_t run_length = 0;
+
+        for (size_t page = 0; page < TOTAL_PAGES; page++) {
+            // Don't hand out pages past the end of the frame region
+            if (frame_start + (page + 1) * PAGE_SIZE > frame_range_end) break;
+
+            // Using 64 bits at a time to skip fully allocated chunks quickly
+            if (page % 64 == 0 && bitmap[page / 64] == 0xFFFFFFFFFFFFFFFF) {
+                run_length = 0;
+                page += 63;
+                continue;
+            }
+
+            // A page is marked 1 in the bitmap if it is allocated
+            if (bitmap[page / 64] & (1ULL << (page % 64))) {
+                run_length = 0;
+                continue;
+            }
+
+            if (run_length == 0) run_start = page;
+            if (++run_length < count) continue;
+
+            // Found count free pages in a row, mark them all as allocated
+            for (size_t i = run_start; i < run_start + count; i++) {
+                bitmap[i / 64] |= (1ULL << (i % 64));
             }
+
+            char* new_pages = frame_start + run_start * PAGE_SIZE;
+
+            // Zeroes out the pages
+            zero_out(new_pages, count * PAGE_SIZE);
+            void* phys = VMM::kernel_to_phys_ptr((void*) new_pages);
+            debug_printf("%lu frame(s) found at 0x%lx\n", count, phys);
+            return phys;
         }
         debug_printf("No available frames\n");
         return nullptr;
     }
 
     void free_frame(void* page) {
+        free_frames(page, 1);
+    }
+
+    void free_frames(void* first_page, size_t count) {
 
-        uint64_t page_addr = (uint64_t) page;
+        uint64_t page_addr = (uint64_t) first_page;
         debug_printf("Deallocating Addr: 0x%X\n", page_addr);
         if (page_addr % PAGE_SIZE != 0) {
           debug_printf("Attempting to deallocate an address not 4096 Byte Aligned\n");
         }
 
-        // Get the exact number of the page (essentially its index in the bitmap)
-        uint64_t page_num = (page_addr - (uint64_t) frame_start) / PAGE_SIZE;
+        LockGuard<TicketLock> l(lock);
 
-        // Divide the page by 64 to get the chunk it is in
-        uint64_t word_idx = page_num / 64;
+        // Get the exact number of the page (essentially its index in the
+        // bitmap), frames are handed out as physical addresses
+        uint64_t page_num =
+            (VMM::phys_to_kernel_ptr(page_addr) - (uint64_t) frame_start) / PAGE_SIZE;
 
-        // Get the exact bit we are trying to free.
-        uint64_t bit_idx = page_num % 64;
-
-        // Marks the page as free in the bitmap
-        bitmap[word_idx] &= ~(1ULL << bit_idx);
+        for (uint64_t i = page_num; i < page_num + count; i++) {
+            // Marks the page as free in the bitmap
+            bitmap[i / 64] &= ~(1ULL << (i % 64));
+        }
     }
 
     void page_init() {
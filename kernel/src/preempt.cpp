@@ -0,0 +1,154 @@
+#include "preempt.h"
+
+#include "cores.h"
+#include "definitions.h"
+#include "event_loop.h"
+#include "fpu.h"
+#include "interrupts.h"
+#include "machine.h"
+#include "reclaim.h"
+#include "sched_stats.h"
+#include "thread.h"
+
+extern "C" uint8_t* stack0_top;
+extern "C" uint8_t* stack1_top;
+extern "C" uint8_t* stack2_top;
+extern "C" uint8_t* stack3_top;
+
+// Restores a parked event's registers from its frame and returns into it
+extern "C" [[noreturn]] void resume_kernel_context(uint64_t* frame,
+                                                   FPState* fp_state);
+
+namespace Preempt {
+// Everything needed to continue an event interrupted at EL1. The general
+// purpose registers, ELR and SPSR are already in the IRQ frame, which is on the event
+// loop's stack or, for a thread, on the thread's stack. Either way the event
+// loop stack the core was using belongs to the parked context.
+struct ParkedContext {
+  uint64_t* frame;
+  uint8_t* stack;
+  Thread* thread;
+  uint64_t run_ticks;  // Run time before parking, for SchedStats
+  FPState fp_state;
+};
+
+struct CoreState {
+  uint32_t count;
+  uint8_t* stack;          // Base of the stack this core runs on
+  uint8_t* spare_stacks;   // Free stacks, linked through their first word
+  ParkedContext* parked;   // Parked on this core, not yet queued for resume
+  char pad[CACHE_LINE_SIZE];
+};
+
+CoreState core_state[NUM_CORES] = {{1}, {1}, {1}, {1}};
+
+static uint8_t* boot_stack_top(uint8_t core) {
+  switch (core) {
+    case 0:
+      return stack0_top;
+    case 1:
+      return stack1_top;
+    case 2:
+      return stack2_top;
+    default:
+      return stack3_top;
+  }
+}
+
+static uint8_t* current_stack(uint8_t core) {
+  CoreState& state = core_state[core];
+  if (state.stack == nullptr) state.stack = boot_stack_top(core) - STACK_SIZE;
+  return state.stack;
+}
+
+static uint8_t* take_spare_stack(CoreState& state) {
+  uint8_t* stack = state.spare_stacks;
+  if (stack == nullptr) return new uint8_t[STACK_SIZE];
+  state.spare_stacks = *(uint8_t**)stack;
+  return stack;
+}
+
+static void give_spare_stack(CoreState& state, uint8_t* stack) {
+  *(uint8_t**)stack = state.spare_stacks;
+  state.spare_stacks = stack;
+}
+
+// The core index must be read with interrupts masked, otherwise the caller
+// could be parked and resumed elsewhere in between
+
+void disable() {
+  InterruptGuard guard;
+  core_state[SMP::whichCore()].count++;
+}
+
+void enable() {
+  InterruptGuard guard;
+  core_state[SMP::whichCore()].count--;
+}
+
+void reset() {
+  InterruptGuard guard;
+  core_state[SMP::whichCore()].count = 1;
+}
+
+uint8_t* stack_top(uint8_t core) { return current_stack(core) + STACK_SIZE; }
+
+static void resume(ParkedContext* context) {
+  set_DAIFSet_all();
+
+  // This stack is abandoned, but only this core hands out its spare stacks
+  // and it is switched away from before interrupts are unmasked again
+  uint8_t core = SMP::whichCore();
+  CoreState& state = core_state[core];
+  give_spare_stack(state, current_stack(core));
+  state.stack = context->stack;
+  Thread::set_current(context->thread);
+  SchedStats::event_resumed(core, context->run_ticks);
+
+  // Freed only after this core passes through the event loop again
+  Reclaim::retire(context);
+
+  // Restoring the registers must not trap once ELR and SPSR are set up
+  FPU::take_for_kernel();
+  resume_kernel_context(context->frame, &context->fp_state);
+}
+
+void preempt_kernel(uint64_t* saved_state) {
+  uint8_t core = SMP::whichCore();
+  CoreState& state = core_state[core];
+  if (state.count != 0) return;
+
+  // A count of 0 means no lock is held on this core, so allocating is safe
+  ParkedContext* context = new ParkedContext();
+  context->frame = saved_state;
+  context->stack = current_stack(core);
+  context->thread = Thread::current();
+  context->run_ticks = SchedStats::event_parked(core);
+  FPU::take_for_kernel();
+  save_fp_state(&context->fp_state);
+  Thread::set_current(nullptr);
+
+  state.parked = context;
+  state.stack = take_spare_stack(state);
+  state.count = 1;
+  SchedStats::preempted(core);
+
+  set_DAIFClr_all();
+
+  event_loop();
+}
+
+void publish_parked() {
+  ParkedContext* context;
+  {
+    InterruptGuard guard;
+    CoreState& state = core_state[SMP::whichCore()];
+    context = state.parked;
+    state.parked = nullptr;
+  }
+
+  if (context != nullptr) {
+    schedule_event([context] { resume(context); });
+  }
+}
+}  // namespace Preempt
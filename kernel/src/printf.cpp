@@ -592,12 +592,13 @@ static size_t _etoa(out_fct_type out, char* buffer, size_t idx, size_t maxlen,
   #endif  // PRINTF_SUPPORT_EXPONENTIAL
 #endif    // PRINTF_SUPPORT_FLOAT
 
-SpinLock vsnprintf_spinlock;
+static LockStats::Site vsnprintf_lock_site{"printf"};
+TicketLock vsnprintf_spinlock{vsnprintf_lock_site};
 
 // internal vsnprintf
 static int _vsnprintf(out_fct_type out, char* buffer, const size_t maxlen,
                       const char* format, va_list va) {
-  LockGuard<SpinLock> lg{vsnprintf_spinlock};
+  LockGuard<TicketLock> lg{vsnprintf_spinlock};
 
   unsigned int flags, width, precision, n;
   size_t idx = 0U;
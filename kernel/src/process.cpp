@@ -1,9 +1,12 @@
 #include "machine.h"
+#include "interrupts.h"
 #include "printf.h"
 #include "process.h"
 #include "cores.h"
 #include "system_call.h"
+#include "parallel.h"
 #include "physmem.h"
+#include "sched_stats.h"
 
 Process* activeProcess[4] = {nullptr, nullptr, nullptr, nullptr};
 
@@ -18,13 +21,24 @@ void user_mode()
   }
 }
 
-Process::Process() : translation_table(VMM::TranslationTable::Granule::KB_4), context(VMM::kernel_to_phys_ptr((uint64_t) user_mode), STACK_HIGH_EXCLUSIVE)
+Process::Process() : translation_table(VMM::TranslationTable::Granule::KB_4), context(VMM::kernel_to_phys_ptr((uint64_t) user_mode), STACK_HIGH_EXCLUSIVE),
+  last_core(NO_CORE), affinity(ALL_CORES), migrations(0), dispatch_event(this),
+  futex_waiter(this)
 {
   // Basic Sanity Mapping
-  for (uint64_t virtual_address = 0; virtual_address < 0x40000000; virtual_address += 0x1000)
+  // The first page creates the tables shared by the whole range, after which
+  // every 2MB chunk only touches its own L2 entry and L3 table, so the chunks
+  // can be mapped in parallel
+  constexpr uint64_t SANITY_MAPPING_END = 0x40000000;
+  constexpr uint64_t L3_TABLE_SPAN = 0x200000;
+  translation_table.map_address(0, VMM::kernel_to_phys_ptr((uint64_t) 0), VMM::TranslationTable::UnprivilegedAccess, VMM::TranslationTable::PageSize::KB_4);
+  parallel_for(0, SANITY_MAPPING_END, L3_TABLE_SPAN, [this](uint64_t chunk_start, uint64_t chunk_end)
   {
-    translation_table.map_address(virtual_address, VMM::kernel_to_phys_ptr(virtual_address), VMM::TranslationTable::UnprivilegedAccess, VMM::TranslationTable::PageSize::KB_4);
-  }
+    for (uint64_t virtual_address = chunk_start; virtual_address < chunk_end; virtual_address += 0x1000)
+    {
+      translation_table.map_address(virtual_address, VMM::kernel_to_phys_ptr(virtual_address), VMM::TranslationTable::UnprivilegedAccess, VMM::TranslationTable::PageSize::KB_4);
+    }
+  });
 
   // User Space Stack Mapping
   constexpr uint64_t flags = VMM::TranslationTable::UnprivilegedAccess;
@@ -39,12 +53,22 @@ Process::Process() : translation_table(VMM::TranslationTable::Granule::KB_4), co
   for (int i = 3; i < NUM_IO_RESOURCES; i++) {
     resources[i] = nullptr;
   }
+
+  deadline_entity.budget_enforced = true;
+  FairSched::add_process();
 }
 
 Process::~Process()
 {
   // TODO free memory mappings
   // TODO free filesystem attributes
+  {
+    InterruptGuard guard;
+    FPU::forget(&fp_context);
+  }
+  DeadlineSched::release(&deadline_entity);
+  FairSched::remove_process();
+
   // Deletes IO Resources
   for (int i = 0; i < NUM_IO_RESOURCES; i++) {
     if (resources[i] != nullptr) delete resources[i];
@@ -55,24 +79,38 @@ extern "C" void enter_process(struct ProcessContext*);
 
 void Process::run()
 {
+  // An interrupt from here on would overwrite ELR_EL1 and SPSR_EL1, eret
+  // unmasks again from the saved status register
+  set_DAIFSet_all();
+
   set_ELR_EL1(context.pc);
   set_SP_EL0(context.sp);
   set_SPSR_EL1(context.status_register);
   
   translation_table.set_ttbr0_el1();
 
-  activeProcess[SMP::whichCore()] = this;
+  uint8_t core = SMP::whichCore();
+  if (last_core != NO_CORE && last_core != core) migrations++;
+  last_core = core;
+  SchedStats::process_entered(core, this);
+
+  activeProcess[core] = this;
 
   debug_printf("Entering Process\n");
 
+  FPU::enter_user(&fp_context);
   enter_process(&context);
 }
 
+// Saves where the process was interrupted and its registers. Runs on
+// exception entry before the process's FP/SIMD registers are saved, so it
+// must not use them itself.
+__attribute__((target("general-regs-only")))
 void Process::save_state(uint64_t* register_frame)
 {
-  context.pc = get_ELR_EL1();
+  context.pc = register_frame[ExceptionFrame::ELR];
   context.sp = get_SP_EL0();
-  context.status_register = get_SPSR_EL1();
+  context.status_register = register_frame[ExceptionFrame::SPSR];
   context.x0 = register_frame[0];
   context.x1 = register_frame[1];
   context.x2 = register_frame[2];
@@ -107,6 +145,141 @@ void Process::save_state(uint64_t* register_frame)
   context.x31 = register_frame[31];
 }
 
+// Charges the slice that just ended, if any, and makes the process runnable
+// again. A deadline process goes back to the core it was admitted on, and is
+// done with its period if it yielded. Any other process goes to the core it
+// last ran on unless that core is more than MIGRATION_THRESHOLD events busier
+// than the least loaded core it may run on.
+void Process::schedule(bool yielded)
+{
+  if (deadline_entity.admitted()) {
+    DeadlineSched::stop_run(&deadline_entity, yielded);
+    DeadlineSched::enqueue(&deadline_entity, &dispatch_event);
+    return;
+  }
+
+  FairSched::stop_slice(this);
+  FairSched::enqueue(pick_core(), this);
+}
+
+// Saves the running process's registers, including any result already set in
+// saved_state, and takes it off its core. Called with interrupts masked.
+void Process::leave_core(uint64_t* saved_state)
+{
+  save_state(saved_state);
+  release_fp_state();
+  activeProcess[SMP::whichCore()] = nullptr;
+  __asm__ volatile("dmb sy" ::: "memory");
+}
+
+// Takes the running process off its core without making it runnable, for a
+// system call that waits. Its registers are kept for when whoever wakes it
+// calls schedule().
+void Process::block(uint64_t* saved_state)
+{
+  leave_core(saved_state);
+  if (deadline_entity.admitted()) {
+    DeadlineSched::stop_run(&deadline_entity, false);
+  } else {
+    FairSched::stop_slice(this);
+  }
+}
+
+// Takes the running process off its core, queues it to run again through its
+// scheduling class and carries on with the event loop. Used when it yields,
+// is preempted, or has to continue on another core.
+void Process::requeue(uint64_t* saved_state, bool yielded)
+{
+  leave_core(saved_state);
+  schedule(yielded);
+  set_DAIFClr_all();
+  event_loop();
+}
+
+// Starts a slice picked by the scheduling class
+void Process::dispatch()
+{
+  set_DAIFSet_all();
+  if (deadline_entity.admitted()) {
+    DeadlineSched::start_run(&deadline_entity);
+  } else {
+    FairSched::start_slice(this, SMP::whichCore());
+  }
+  run();
+}
+
+void DispatchEvent::run()
+{
+  process->dispatch();
+}
+
+uint8_t Process::pick_core() const
+{
+  uint8_t least_loaded = NO_CORE;
+  size_t least_load = 0;
+  for (uint8_t core = 0; core < NUM_CORES; core++) {
+    if (!may_run_on(core)) continue;
+    size_t load = local_queue_load(core);
+    if (least_loaded == NO_CORE || load < least_load) {
+      least_loaded = core;
+      least_load = load;
+    }
+  }
+
+  if (last_core != NO_CORE && may_run_on(last_core) &&
+      local_queue_load(last_core) <= least_load + MIGRATION_THRESHOLD) {
+    return last_core;
+  }
+  return least_loaded;
+}
+
+// Restricts the process to the cores in core_mask, returning false if that
+// leaves no core to run on. Takes effect the next time it is scheduled.
+bool Process::set_affinity(uint64_t core_mask)
+{
+  if ((core_mask & ALL_CORES) == 0) return false;
+  if (deadline_entity.admitted() && !(core_mask & (1 << deadline_entity.core))) return false;
+  affinity = core_mask & ALL_CORES;
+  return true;
+}
+
+// Sets the nice value, from MIN_NICE (largest share) to MAX_NICE (smallest),
+// returning false if it is out of range. The slice in progress is charged at
+// the new weight.
+bool Process::set_nice(int nice)
+{
+  if (nice < FairSched::MIN_NICE || nice > FairSched::MAX_NICE) return false;
+  fair_entity.nice = nice;
+  fair_entity.weight = FairSched::weight_for_nice(nice);
+  return true;
+}
+
+// Moves the process into the deadline class with the given parameters, on a
+// core it may run on, or back to the fair class if params is nullptr. Returns
+// false if admission control rejects the parameters, leaving the process as
+// it was. Called while the process is running.
+bool Process::set_deadline(const DeadlineParams* params)
+{
+  if (params == nullptr) {
+    DeadlineSched::release(&deadline_entity);
+    return true;
+  }
+
+  if (!DeadlineSched::admit(&deadline_entity, *params, affinity)) return false;
+
+  // The rest of this slice is charged to neither class
+  fair_entity.slice_start = 0;
+  return true;
+}
+
+// Saves the FP/SIMD registers if this process modified them on the current
+// core, so that it can resume on any core. Called with interrupts masked when
+// the process stops running on this core.
+void Process::release_fp_state()
+{
+  FPU::release(&fp_context);
+}
+
 // Maps the memory addresses in the range from start (inclusive) to end
 // (exclusive), where it pads with extra bytes if needed to page align
 void Process::map_range(uint64_t start, uint64_t end) {
@@ -0,0 +1,91 @@
+#include "reclaim.h"
+
+#include "atomics.h"
+#include "cores.h"
+#include "definitions.h"
+#include "interrupts.h"
+
+namespace Reclaim {
+// Retired memory waiting for its epoch to become safe
+struct Retired {
+  void* ptr;
+  void (*deleter)(void*);
+  Retired* next;
+};
+
+// One limbo list per epoch modulo 3: the epoch being retired into, the one
+// before it (possibly still referenced) and the one being freed
+constexpr int NUM_LIMBO_LISTS = 3;
+
+struct CoreState {
+  uint64_t local_epoch;
+  bool online;
+  Retired* limbo[NUM_LIMBO_LISTS];
+  char pad[CACHE_LINE_SIZE];
+};
+
+Atomic<uint64_t> global_epoch(0);
+CoreState core_state[NUM_CORES];
+
+static void free_list(Retired* list) {
+  while (list != nullptr) {
+    Retired* next = list->next;
+    list->deleter(list->ptr);
+    delete list;
+    list = next;
+  }
+}
+
+void retire(void* ptr, void (*deleter)(void*)) {
+  Retired* node = new Retired{ptr, deleter, nullptr};
+
+  // Interrupts are masked so the limbo list cannot be touched by an interrupt
+  // handler on this core while it is being pushed to
+  InterruptGuard guard;
+  CoreState& state = core_state[SMP::whichCore()];
+  int list = global_epoch.load() % NUM_LIMBO_LISTS;
+  node->next = state.limbo[list];
+  state.limbo[list] = node;
+}
+
+void quiescent_state() {
+  Retired* reclaimable = nullptr;
+  {
+    InterruptGuard guard;
+    CoreState& state = core_state[SMP::whichCore()];
+    uint64_t epoch = global_epoch.load();
+
+    if (!state.online || state.local_epoch != epoch) {
+      // Memory retired two epochs ago can no longer be referenced by anyone
+      int list = (epoch + 1) % NUM_LIMBO_LISTS;
+      reclaimable = state.limbo[list];
+      state.limbo[list] = nullptr;
+      __atomic_store_n(&state.local_epoch, epoch, __ATOMIC_RELEASE);
+      __atomic_store_n(&state.online, true, __ATOMIC_RELEASE);
+    }
+
+    // The epoch may only advance once every online core has observed it
+    bool all_observed = true;
+    for (int core = 0; core < NUM_CORES; core++) {
+      if (__atomic_load_n(&core_state[core].online, __ATOMIC_ACQUIRE) &&
+          __atomic_load_n(&core_state[core].local_epoch, __ATOMIC_ACQUIRE) !=
+              epoch) {
+        all_observed = false;
+        break;
+      }
+    }
+    if (all_observed) {
+      global_epoch.compare_exchange_strong(&epoch, epoch + 1);
+    }
+  }
+
+  // Deleters run with interrupts restored
+  free_list(reclaimable);
+}
+
+void go_offline() {
+  InterruptGuard guard;
+  __atomic_store_n(&core_state[SMP::whichCore()].online, false,
+                   __ATOMIC_RELEASE);
+}
+}  // namespace Reclaim
@@ -0,0 +1,78 @@
+#include "sched_stats.h"
+
+#include "machine.h"
+#include "printf.h"
+#include "timer_wheel.h"
+#include "uart.h"
+
+namespace SchedStats {
+#if SCHED_STATS
+CoreState core_state[NUM_CORES];
+
+bool snapshot(Snapshot* snapshot) {
+  snapshot->counter_frequency = get_CNTFRQ_EL0();
+  for (int core = 0; core < NUM_CORES; core++) {
+    snapshot->cores[core] = core_state[core].stats;
+  }
+  return true;
+}
+
+// Upper bound in microseconds of the first bucket by which percent of the
+// samples have been counted
+static uint64_t percentile_us(const uint64_t* histogram, uint64_t total,
+                              uint64_t percent) {
+  uint64_t seen = 0;
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    seen += histogram[i];
+    if (seen * 100 >= total * percent) {
+      return GenericTimer::counter_to_ns(2ull << i) / 1000;
+    }
+  }
+  return GenericTimer::counter_to_ns(2ull << (HISTOGRAM_BUCKETS - 1)) / 1000;
+}
+
+void dump() {
+  printf("core  events  busy%%  idle%%  preempt  yield  switch"
+         "  wait p50/p99 us  run p50/p99 us\n");
+  for (int core = 0; core < NUM_CORES; core++) {
+    CoreStats stats = core_state[core].stats;
+    uint64_t accounted = stats.busy_ticks + stats.idle_ticks;
+    if (accounted == 0) accounted = 1;
+    uint64_t waits = 0;
+    uint64_t finished = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+      waits += stats.latency[i];
+      finished += stats.run_time[i];
+    }
+
+    printf("%4d %7lu %6lu %6lu %8lu %6lu %7lu %8lu/%-8lu %7lu/%-8lu\n", core,
+           stats.events_run, stats.busy_ticks * 100 / accounted,
+           stats.idle_ticks * 100 / accounted, stats.preemptions, stats.yields,
+           stats.context_switches,
+           percentile_us(stats.latency, waits, 50),
+           percentile_us(stats.latency, waits, 99),
+           percentile_us(stats.run_time, finished, 50),
+           percentile_us(stats.run_time, finished, 99));
+  }
+}
+
+#if SCHED_STATS_KEY
+void start_debug_key() {
+  schedule_event_every(DEBUG_KEY_POLL_NS, [] {
+    int c;
+    while ((c = uart_try_getc()) >= 0) {
+      if (c == DEBUG_KEY) dump();
+    }
+  }, Priority::Background);
+}
+#else
+void start_debug_key() {}
+#endif
+#else
+bool snapshot(Snapshot*) { return false; }
+
+void dump() { printf("Scheduler statistics are not compiled in\n"); }
+
+void start_debug_key() {}
+#endif
+}  // namespace SchedStats
@@ -1,7 +1,12 @@
 
 #include "sd.h"
+#include "mutex.h"
 #include "vmm.h"
 
+// Serializes init, read and write, which all drive the same EMMC registers and
+// can take long enough that spinning for them would waste the other cores
+static Mutex sd_mutex;
+
 // SD emmc registers
 volatile uint32_t* const SD::EMMC_BASE =
     (volatile uint32_t*) VMM::phys_to_kernel_ptr((uint64_t)0x3F300000);  // 0x3F300000 + 0x00
@@ -225,7 +230,7 @@ SD::RESPONSE SD::setClock(uint32_t freq) {
   }
 
   // disable "SD clock enable"
-  *EMMC_CONTROL0 &= ~((uint32_t)0b100);
+  *EMMC_CONTROL0 = *EMMC_CONTROL0 & ~((uint32_t)0b100);
 
   // finding how much we have to slow down the clock by
   // finding the log2 of the frequency
@@ -255,7 +260,7 @@ SD::RESPONSE SD::setClock(uint32_t freq) {
   *EMMC_CONTROL1 = *EMMC_CONTROL1 & (~mask6_15) | divisor;
 
   // renable "SD clock enable"
-  *EMMC_CONTROL1 |= 0b100;
+  *EMMC_CONTROL1 = *EMMC_CONTROL1 | 0b100;
 
   // wait for the clock to be stable
   r = waitStatus(DATA_BUSY);
@@ -296,6 +301,7 @@ void SD::eMMCinit() {
 }
 
 uint32_t SD::init() {
+  LockGuard<Mutex> guard(sd_mutex);
   uint32_t timeout = 1000000;
   uint32_t response = SUCCESS;
   eMMCinit();
@@ -310,7 +316,7 @@ uint32_t SD::init() {
 
   // resetting the sd card
   *EMMC_CONTROL0 = 0x00000000;
-  *EMMC_CONTROL1 |= 0x01000000;  // "Reset the complete host circuit"
+  *EMMC_CONTROL1 = *EMMC_CONTROL1 | 0x01000000;  // "Reset the complete host circuit"
 
   timeout = 1000;
   // wait for the reset to finish
@@ -472,7 +478,7 @@ uint32_t SD::init() {
                 relativeCardAddress | 0x2);  // try to set the bus width to 4
                                              // using the relative card address
     // update contol 0 to enable 4 data lines
-    *EMMC_CONTROL0 |= 0x2;
+    *EMMC_CONTROL0 = *EMMC_CONTROL0 | 0x2;
   }
   if (errInfo) {
     error_printf("Error: Failed to set bus width\n");
@@ -534,6 +540,7 @@ uint32_t SD::setBlockSizeCount(uint32_t startBlock, uint32_t count,
 }
 
 uint32_t SD::read(uint32_t startBlock, uint32_t count, uint8_t* buffer) {
+  LockGuard<Mutex> guard(sd_mutex);
   debug_printf("SD::read current card status: 0x%08x\n", *EMMC_STATUS);
   uint32_t response = SUCCESS;
   if (count < 1) count = 1;  // min of 1 block
@@ -611,6 +618,7 @@ uint32_t SD::read(uint32_t startBlock, uint32_t count, uint8_t* buffer) {
 }
 
 uint32_t SD::write(uint32_t startBlock, uint32_t count, uint8_t* buffer) {
+  LockGuard<Mutex> guard(sd_mutex);
   debug_printf("SD::write current card status: 0x%08x\n", *EMMC_STATUS);
   uint32_t response = SUCCESS;
   if (count < 1) count = 1;  // min of 1 block
@@ -4,6 +4,8 @@
 #include "printf.h"
 #include "process.h"
 #include "ext2.h"
+#include "futex.h"
+#include "sched_stats.h"
 
 #define IN_USER(ptr) ((uint64_t) (ptr) < 0x0001'0000'0000'0000)
 
@@ -69,6 +71,53 @@ Syscall::Result<int> exec(const char* filename, int argc, const char** argv) {
   return Syscall::NOT_IMPLEMENTED;
 }
 
+Syscall::Result<int> sched_setaffinity(unsigned long core_mask) {
+  Process* current_process = activeProcess[SMP::whichCore()];
+  if (!current_process->set_affinity(core_mask)) {
+    return Syscall::INVALID_ARGUMENT;
+  }
+  return Syscall::SUCCESS;
+}
+
+Syscall::Result<long> sched_migrations() {
+  Process* current_process = activeProcess[SMP::whichCore()];
+  return (long) current_process->get_migrations();
+}
+
+Syscall::Result<long> sched_stats(SchedStats::Snapshot* buffer, long size) {
+  if (!IN_USER(buffer)) return Syscall::INVALID_POINTER;
+  if (size < (long) sizeof(SchedStats::Snapshot)) return Syscall::INVALID_IO_SIZE;
+  if (!SchedStats::snapshot(buffer)) return Syscall::NOT_IMPLEMENTED;
+  return (long) sizeof(SchedStats::Snapshot);
+}
+
+Syscall::Result<int> nice(int value) {
+  Process* current_process = activeProcess[SMP::whichCore()];
+  if (!current_process->set_nice(value)) return Syscall::INVALID_ARGUMENT;
+  return 0;
+}
+
+Syscall::Result<int> sched_setdeadline(unsigned long runtime_ns,
+                                       unsigned long deadline_ns,
+                                       unsigned long period_ns) {
+  Process* current_process = activeProcess[SMP::whichCore()];
+  if (runtime_ns == 0) {
+    current_process->set_deadline(nullptr);
+    return 0;
+  }
+
+  DeadlineParams params{runtime_ns, deadline_ns, period_ns};
+  if (!DeadlineSched::valid(params)) return Syscall::INVALID_ARGUMENT;
+  if (!current_process->set_deadline(&params)) return Syscall::OVERCOMMITTED;
+  return 0;
+}
+
+Syscall::Result<long> futex_wake(uint32_t* addr, unsigned long count) {
+  long woken = Futex::wake(addr, count);
+  if (woken < 0) return Syscall::INVALID_POINTER;
+  return woken;
+}
+
 template <typename T>
 void process_return(uint64_t* saved_state, Syscall::Result<T> result) {
   result.set_state(saved_state);
@@ -92,12 +141,8 @@ uint64_t system_call_handler(uint16_t syscall_type, uint64_t* saved_state) {
     // 0x01: void yield();
     case 0x01: {
       uint8_t current_core = SMP::whichCore();
-      Process* current_process = activeProcess[current_core];
-      current_process->save_state(saved_state);
-      activeProcess[current_core] = nullptr;
-      __asm__ volatile("dmb sy" ::: "memory");
-      schedule_event([current_process] () { current_process->run(); });
-      event_loop();
+      SchedStats::yielded(current_core);
+      activeProcess[current_core]->requeue(saved_state, true);
       break;
     }
 
@@ -179,6 +224,90 @@ uint64_t system_call_handler(uint16_t syscall_type, uint64_t* saved_state) {
       break;
     }
 
+    // 0x0B: int sched_setaffinity(unsigned long core_mask);
+    case 0x0B: {
+      unsigned long core_mask = (unsigned long) saved_state[0];
+      Syscall::Result<int> result = sched_setaffinity(core_mask);
+      uint8_t current_core = SMP::whichCore();
+      Process* current_process = activeProcess[current_core];
+      if (current_process->may_run_on(current_core)) {
+        process_return(saved_state, result);
+      }
+
+      // Continues on an allowed core instead
+      result.set_state(saved_state);
+      current_process->requeue(saved_state);
+      break;
+    }
+
+    // 0x0C: long sched_migrations();
+    case 0x0C: {
+      Syscall::Result<long> result = sched_migrations();
+      process_return(saved_state, result);
+      break;
+    }
+
+    // 0x0D: long sched_stats(SchedStats::Snapshot* buffer, long size);
+    case 0x0D: {
+      SchedStats::Snapshot* buffer = (SchedStats::Snapshot*) saved_state[0];
+      long size = (long) saved_state[1];
+      Syscall::Result<long> result = sched_stats(buffer, size);
+      process_return(saved_state, result);
+      break;
+    }
+
+    // 0x0E: int nice(int value);
+    case 0x0E: {
+      int value = (int) saved_state[0];
+      Syscall::Result<int> result = nice(value);
+      process_return(saved_state, result);
+      break;
+    }
+
+    // 0x0F: int sched_setdeadline(unsigned long runtime_ns,
+    //                             unsigned long deadline_ns,
+    //                             unsigned long period_ns);
+    case 0x0F: {
+      unsigned long runtime_ns = (unsigned long) saved_state[0];
+      unsigned long deadline_ns = (unsigned long) saved_state[1];
+      unsigned long period_ns = (unsigned long) saved_state[2];
+      Syscall::Result<int> result =
+          sched_setdeadline(runtime_ns, deadline_ns, period_ns);
+      uint8_t current_core = SMP::whichCore();
+      Process* current_process = activeProcess[current_core];
+      if (runtime_ns == 0 || current_process->deadline() == nullptr) {
+        process_return(saved_state, result);
+      }
+
+      // Starts its first period on the core it was admitted on
+      result.set_state(saved_state);
+      current_process->requeue(saved_state);
+      break;
+    }
+
+    // 0x10: int futex_wait(uint32_t* addr, uint32_t expected,
+    //                      unsigned long timeout_ns);
+    case 0x10: {
+      uint32_t* addr = (uint32_t*) saved_state[0];
+      uint32_t expected = (uint32_t) saved_state[1];
+      unsigned long timeout_ns = (unsigned long) saved_state[2];
+
+      // Only returns if the process does not block
+      Syscall::Result<int> result =
+          Futex::wait(addr, expected, timeout_ns, saved_state);
+      process_return(saved_state, result);
+      break;
+    }
+
+    // 0x11: long futex_wake(uint32_t* addr, unsigned long count);
+    case 0x11: {
+      uint32_t* addr = (uint32_t*) saved_state[0];
+      unsigned long count = (unsigned long) saved_state[1];
+      Syscall::Result<long> result = futex_wake(addr, count);
+      process_return(saved_state, result);
+      break;
+    }
+
     default: {
       printf("Unknown System Call\n");
       Syscall::Result<int> result = Syscall::INVALID_SYSTEM_CALL;
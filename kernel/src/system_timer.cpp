@@ -64,4 +64,5 @@ void SystemTimer::setup_timer(uint8_t IRQ_num) {
   current_time = 0;
   set_compare_register(0, 1000000);
   Interrupts::Enable_IRQ(IRQ_num);
-}
\ No newline at end of file
+}
+
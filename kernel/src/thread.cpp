@@ -0,0 +1,168 @@
+#include "thread.h"
+
+#include "cores.h"
+#include "definitions.h"
+#include "interrupts.h"
+#include "machine.h"
+#include "physmem.h"
+#include "preempt.h"
+#include "printf.h"
+#include "process.h"
+#include "reclaim.h"
+#include "vmm.h"
+
+extern "C" void thread_trampoline();
+
+constexpr size_t STACK_FRAMES = STACK_SIZE / PAGE_SIZE;
+
+// Layout of the registers context_switch pops, lowest address first
+struct InitialFrame {
+  uint64_t d8_to_d15[8];
+  uint64_t x19_to_x28[10];
+  uint64_t x29;
+  uint64_t x30;
+};
+
+struct CurrentThread {
+  Thread* thread;
+  char pad[CACHE_LINE_SIZE];
+};
+
+CurrentThread current_threads[NUM_CORES];
+
+Thread::Thread(Event* work, uint8_t* stack, Priority priority)
+    : return_tcb(nullptr),
+      stack(stack),
+      work(work),
+      priority(priority),
+      finished(false),
+      after_switch(nullptr),
+      after_switch_arg(nullptr) {
+  InitialFrame* frame =
+      (InitialFrame*)(stack + STACK_SIZE - sizeof(InitialFrame));
+  *frame = InitialFrame{};
+  frame->x19_to_x28[0] = (uint64_t)this;
+  frame->x30 = (uint64_t)thread_trampoline;
+
+  tcb.saved_sp = (uint64_t)frame;
+  tcb.active_process = nullptr;
+  tcb.ttbr0 = get_TTBR0_EL1();
+
+  Thread* self = this;
+  auto resume = [self] { self->switch_in(); };
+  resume_event = new EventWithWork<decltype(resume)>(resume);
+}
+
+Thread::~Thread() {
+  PhysMem::free_frames(VMM::kernel_to_phys_ptr(stack), STACK_FRAMES);
+  delete work;
+  delete resume_event;
+}
+
+Thread* Thread::spawn_event(Event* work, Priority priority) {
+  void* frames = PhysMem::allocate_frames(STACK_FRAMES);
+  if (frames == nullptr) {
+    debug_printf("Thread: no memory for a %lu byte stack\n", (uint64_t) STACK_SIZE);
+    delete work;
+    return nullptr;
+  }
+
+  Thread* thread =
+      new Thread(work, (uint8_t*)VMM::phys_to_kernel_ptr(frames), priority);
+  thread->wake();
+  return thread;
+}
+
+Thread* Thread::current() {
+  // Read with interrupts masked so the caller cannot be moved to another core
+  // between finding its core and reading the slot
+  InterruptGuard guard;
+  return current_threads[SMP::whichCore()].thread;
+}
+
+void Thread::set_current(Thread* thread) {
+  InterruptGuard guard;
+  current_threads[SMP::whichCore()].thread = thread;
+}
+
+// Saves the state the event loop side and the thread side do not share
+static void switch_address_space(TCB* from, TCB* to) {
+  uint8_t core = SMP::whichCore();
+  from->active_process = activeProcess[core];
+  from->ttbr0 = get_TTBR0_EL1();
+
+  activeProcess[core] = to->active_process;
+  if (to->ttbr0 != from->ttbr0) {
+    set_TTBR0_EL1(to->ttbr0);
+    tlb_invalidate_all();
+  }
+}
+
+// Runs in the thread's resume event, on the event loop's stack. Both sides of
+// the switch run with preemption disabled, so the count carries over.
+void Thread::switch_in() {
+  TCB caller;
+  return_tcb = &caller;
+
+  Preempt::disable();
+  set_current(this);
+  switch_address_space(&caller, &tcb);
+  context_switch(&caller, &tcb);
+
+  // Back on the event loop's stack, the thread blocked or finished
+  set_current(nullptr);
+  Preempt::enable();
+
+  // This runs inside resume_event, which the destructor deletes, so the
+  // thread is only freed after the event loop is done with the event
+  if (finished) {
+    Reclaim::retire(this, [](void* thread) { delete static_cast<Thread*>(thread); });
+    return;
+  }
+
+  void (*callback)(void*) = after_switch;
+  after_switch = nullptr;
+  if (callback != nullptr) callback(after_switch_arg);
+}
+
+void Thread::switch_out() {
+  Preempt::disable();
+  TCB* to = return_tcb;
+  switch_address_space(&tcb, to);
+  context_switch(&tcb, to);
+
+  // Switched in again, possibly on another core
+  Preempt::enable();
+}
+
+void Thread::block_with(void (*callback)(void*), void* arg) {
+  Thread* self = current();
+  if (self == nullptr) {
+    Debug::panic("Thread::block called outside of a thread\n");
+  }
+
+  self->after_switch = callback;
+  self->after_switch_arg = arg;
+  self->switch_out();
+}
+
+void Thread::yield() {
+  Thread* self = current();
+  if (self == nullptr) return;
+
+  block([self] { self->wake(); });
+}
+
+void Thread::wake() { enqueue_event(resume_event, priority); }
+
+extern "C" [[noreturn]] void thread_start(Thread* thread) {
+  // Entered from switch_in, which disabled preemption
+  Preempt::enable();
+
+  thread->work->run();
+
+  thread->finished = true;
+  thread->switch_out();
+
+  Debug::panic("Finished thread was resumed\n");
+}
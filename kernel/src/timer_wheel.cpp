@@ -0,0 +1,224 @@
+#include "timer_wheel.h"
+
+#include "atomics.h"
+#include "cores.h"
+#include "definitions.h"
+#include "interrupts.h"
+
+namespace TimerWheel {
+constexpr uint64_t SLOT_MASK = SLOTS - 1;
+constexpr uint64_t MAX_DELAY = (1ull << (SLOT_BITS * LEVELS)) - 1;
+
+// Runs a periodic timer's event, with at most one run queued or running at a
+// time. Owned by the timer until it is cancelled, then by whichever of
+// cancel() and the run in flight finishes last.
+struct PeriodicEvent : public Event {
+  static constexpr uint32_t IN_FLIGHT = 1;  // Queued or running
+  static constexpr uint32_t CANCELLED = 2;
+
+  Event* const event;
+  uint32_t state = 0;
+
+  explicit PeriodicEvent(Event* event) : Event(), event(event) {}
+  virtual ~PeriodicEvent() override { delete event; }
+
+  // Called under the wheel lock. Returns false if the last run is still in
+  // flight, in which case this period is skipped.
+  bool start() {
+    uint32_t idle = 0;
+    return __atomic_compare_exchange_n(&state, &idle, IN_FLIGHT, false,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+  }
+
+  // Called under the wheel lock. Returns true if nothing is in flight, so the
+  // caller deletes the event.
+  bool cancel() {
+    return !(__atomic_fetch_or(&state, CANCELLED, __ATOMIC_ACQ_REL) & IN_FLIGHT);
+  }
+
+  virtual void run() override {
+    event->run();
+    if (__atomic_fetch_and(&state, ~IN_FLIGHT, __ATOMIC_ACQ_REL) & CANCELLED) {
+      delete this;
+    }
+  }
+};
+
+struct Wheel {
+  SpinLock lock;
+  uint64_t current_tick;
+  uint64_t pending;
+  Timer* slots[LEVELS][SLOTS];
+  Timer* free_timers;
+};
+
+Wheel wheels[NUM_CORES];
+
+// Links timer into the slot for its expiry. Timers due on the current tick go
+// into the level 0 slot that is about to be fired. A timer further out than
+// the wheels reach waits in the farthest slot and is inserted again when that
+// slot cascades.
+static void insert(Wheel& wheel, Timer* timer) {
+  uint64_t delta = timer->expires - wheel.current_tick;
+  uint64_t position = timer->expires;
+  if (delta > MAX_DELAY) {
+    delta = MAX_DELAY;
+    position = wheel.current_tick + delta;
+  }
+
+  int level = 0;
+  while (level < LEVELS - 1 && delta >= (1ull << (SLOT_BITS * (level + 1)))) {
+    level++;
+  }
+
+  Timer** list =
+      &wheel.slots[level][(position >> (SLOT_BITS * level)) & SLOT_MASK];
+  timer->list = list;
+  timer->prev = nullptr;
+  timer->next = *list;
+  if (*list != nullptr) (*list)->prev = timer;
+  *list = timer;
+}
+
+static void unlink(Timer* timer) {
+  if (timer->prev != nullptr) {
+    timer->prev->next = timer->next;
+  } else {
+    *timer->list = timer->next;
+  }
+  if (timer->next != nullptr) timer->next->prev = timer->prev;
+  timer->next = timer->prev = nullptr;
+}
+
+// Invalidates every handle to timer and returns it to the wheel's free list
+static void recycle(Wheel& wheel, Timer* timer) {
+  timer->pending = false;
+  timer->generation++;
+  timer->event = nullptr;
+  timer->next = wheel.free_timers;
+  wheel.free_timers = timer;
+}
+
+// Moves every timer in a higher level slot down to where it now belongs
+static void cascade(Wheel& wheel, int level, uint64_t slot) {
+  Timer* timer = wheel.slots[level][slot];
+  wheel.slots[level][slot] = nullptr;
+  while (timer != nullptr) {
+    Timer* next = timer->next;
+    insert(wheel, timer);
+    timer = next;
+  }
+}
+
+TimerHandle add(Event* event, uint64_t delay_ns, uint64_t period_ns,
+                Priority priority) {
+  uint8_t core = SMP::whichCore();
+  Wheel& wheel = wheels[core];
+
+  uint64_t delay = (delay_ns + GenericTimer::NS_PER_TICK - 1) /
+                   GenericTimer::NS_PER_TICK;
+  uint64_t period = (period_ns + GenericTimer::NS_PER_TICK - 1) /
+                    GenericTimer::NS_PER_TICK;
+  if (delay == 0) delay = 1;
+  if (period != 0) event = new PeriodicEvent(event);
+
+  Timer* timer;
+  {
+    InterruptGuard guard;
+    LockGuard<SpinLock> l(wheel.lock);
+    timer = wheel.free_timers;
+    if (timer != nullptr) wheel.free_timers = timer->next;
+  }
+  if (timer == nullptr) {
+    timer = new Timer();
+    timer->generation = 0;
+    timer->core = core;
+  }
+
+  InterruptGuard guard;
+  LockGuard<SpinLock> l(wheel.lock);
+  timer->event = event;
+  timer->period = period;
+  timer->priority = priority;
+  timer->pending = true;
+  timer->expires = wheel.current_tick + delay;
+  insert(wheel, timer);
+  wheel.pending++;
+
+  // The core may have gone tickless, e.g. when armed from an interrupt on an
+  // idle core, and the delay only counts from the next tick
+  GenericTimer::start_tick();
+  return TimerHandle{timer, timer->generation};
+}
+
+bool cancel(TimerHandle handle) {
+  Timer* timer = handle.timer;
+  if (timer == nullptr) return false;
+
+  Wheel& wheel = wheels[timer->core];
+  Event* cancelled_event;
+  {
+    InterruptGuard guard;
+    LockGuard<SpinLock> l(wheel.lock);
+    if (timer->generation != handle.generation || !timer->pending) {
+      return false;
+    }
+    // A periodic timer's event that is in flight deletes itself once done
+    if (timer->period == 0 ||
+        static_cast<PeriodicEvent*>(timer->event)->cancel()) {
+      cancelled_event = timer->event;
+    } else {
+      cancelled_event = nullptr;
+    }
+    unlink(timer);
+    recycle(wheel, timer);
+    wheel.pending--;
+  }
+
+  delete cancelled_event;
+  return true;
+}
+
+bool is_empty() {
+  return __atomic_load_n(&wheels[SMP::whichCore()].pending, __ATOMIC_RELAXED) ==
+         0;
+}
+
+void tick() {
+  Wheel& wheel = wheels[SMP::whichCore()];
+  LockGuard<SpinLock> l(wheel.lock);
+
+  uint64_t now = ++wheel.current_tick;
+
+  // Cascade from the highest level that wrapped on this tick downwards
+  int wrapped = 0;
+  while (wrapped < LEVELS - 1 &&
+         (now & ((1ull << (SLOT_BITS * (wrapped + 1))) - 1)) == 0) {
+    wrapped++;
+  }
+  for (int level = wrapped; level > 0; level--) {
+    cascade(wheel, level, (now >> (SLOT_BITS * level)) & SLOT_MASK);
+  }
+
+  Timer* timer = wheel.slots[0][now & SLOT_MASK];
+  wheel.slots[0][now & SLOT_MASK] = nullptr;
+  while (timer != nullptr) {
+    Timer* next = timer->next;
+    if (timer->expires > now) {
+      // Was further out than the wheels reach, so it goes round again
+      insert(wheel, timer);
+    } else if (timer->period != 0) {
+      if (static_cast<PeriodicEvent*>(timer->event)->start()) {
+        enqueue_event(timer->event, timer->priority);
+      }
+      timer->expires = now + timer->period;
+      insert(wheel, timer);
+    } else {
+      enqueue_event(timer->event, timer->priority);
+      recycle(wheel, timer);
+      wheel.pending--;
+    }
+    timer = next;
+  }
+}
+}  // namespace TimerWheel
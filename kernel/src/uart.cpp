@@ -54,6 +54,18 @@ class UART {
     *interrupt_mask_set_clear_register = mask;
   }
 
+  inline char receive_data() {
+    volatile uint32_t* data_register =
+        (volatile uint32_t*)(base_address + data_register_offset);
+    return (char)(*data_register & 0xFF);
+  }
+
+  inline bool receive_fifo_empty() {
+    volatile uint32_t* flag_register =
+        (volatile uint32_t*)(base_address + flag_register_offset);
+    return (*flag_register) & 0b10000;
+  }
+
   inline bool transmit_fifo_full() {
     volatile uint32_t* flag_register =
         (volatile uint32_t*)(base_address + flag_register_offset);
@@ -101,4 +113,9 @@ extern "C" void uart_putc(char c) {
   while (uart0.transmit_fifo_full()) {
   }
   uart0.transmit_data(c);
+}
+
+extern "C" int uart_try_getc() {
+  if (uart0.receive_fifo_empty()) return -1;
+  return (unsigned char) uart0.receive_data();
 }
\ No newline at end of file
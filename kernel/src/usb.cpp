@@ -28,10 +28,10 @@ void UsbController::reset_controller() {
     printf("USB: Resetting controller\n");
     write_reg(USB_GRSTCTL, (1 << 0));
     while (read_reg(USB_GRSTCTL) & (1 << 0)) {
-        for (volatile int i = 0; i < 1000; i++);
+        for (volatile int i = 0; i < 1000;) i = i + 1;
     }
     while (!(read_reg(USB_GRSTCTL) & (1 << 31))) {
-        for (volatile int i = 0; i < 1000; i++);
+        for (volatile int i = 0; i < 1000;) i = i + 1;
     }
     printf("USB: Reset complete\n");
 }
@@ -63,7 +63,7 @@ void UsbController::configure_host_mode() {
         if (timeout % 250000 == 0) {
             printf("USB: Waiting for connection, HPRT = 0x%X, timeout = %d\n", hprt, timeout);
         }
-        for (volatile int i = 0; i < 100; i++);
+        for (volatile int i = 0; i < 100;) i = i + 1;
     }
 
     if (timeout == 0) {
@@ -176,7 +176,7 @@ uint32_t UsbController::receive_data(uint8_t channel, uint8_t* buffer, uint32_t
 
     uint32_t timeout = 1000000;
     while (!(read_reg(hc_base + HCINT) & (1 << 0)) && timeout--) {
-        for (volatile int i = 0; i < 100; i++);
+        for (volatile int i = 0; i < 100;) i = i + 1;
     }
     if (timeout == 0) {
         printf("USB: Timeout waiting for data on channel %d\n", channel);
@@ -242,7 +242,7 @@ bool UsbController::enumerate_device() {
     uint32_t hprt = read_reg(USB_HPRT);
     hprt |= (1 << 8);  // Port Reset
     write_reg(USB_HPRT, hprt);
-    for (volatile int i = 0; i < 500000; i++);
+    for (volatile int i = 0; i < 500000;) i = i + 1;
     hprt &= ~(1 << 8);
     write_reg(USB_HPRT, hprt);
 
@@ -258,7 +258,7 @@ bool UsbController::enumerate_device() {
     uint8_t setup_packet[] = {0x80, 0x06, 0x00, 0x01, 0x00, 0x00, 0x08, 0x00};
     send_data(0, setup_packet, 8);
 
-    for (volatile int i = 0; i < 100000; i++);
+    for (volatile int i = 0; i < 100000;) i = i + 1;
 
     uint8_t buffer[8];
     uint32_t bytes = receive_data(0, buffer, 8);
@@ -281,7 +281,7 @@ bool UsbController::enumerate_device() {
     uint8_t setup_packet_full[] = {0x80, 0x06, 0x00, 0x01, 0x00, 0x00, 0x12, 0x00};
     send_data(0, setup_packet_full, 8);
 
-    for (volatile int i = 0; i < 100000; i++);
+    for (volatile int i = 0; i < 100000;) i = i + 1;
 
     uint8_t buffer_full[18];
     bytes = receive_data(0, buffer_full, 18);
@@ -303,7 +303,7 @@ bool UsbController::enumerate_device() {
     uint8_t new_address = 1;
     uint8_t set_addr_packet[] = {0x00, 0x05, new_address, 0x00, 0x00, 0x00, 0x00, 0x00};
     send_data(0, set_addr_packet, 8);
-    for (volatile int i = 0; i < 100000; i++);
+    for (volatile int i = 0; i < 100000;) i = i + 1;
 
     setup_endpoint(0, 0, 0, buffer_full[7], new_address);
     printf("USB: Device enumerated successfully, address set to %d\n", new_address);
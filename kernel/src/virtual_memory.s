@@ -120,3 +120,13 @@ tlb_invalidate_all:
   tlbi vmalle1
   isb
   ret
+
+// uint64_t translate_user_read(uint64_t va)
+// Translates va as an EL0 read through the current TTBR0_EL1, returning
+// PAR_EL1 (bit 0 set if the translation faulted)
+.globl translate_user_read
+translate_user_read:
+  at s1e0r, x0
+  isb
+  mrs x0, PAR_EL1
+  ret